@@ -0,0 +1,98 @@
+#  ******************************************************************************
+#  @file           : bench.mk
+#  @author         : Steven Mu
+#  @summary		   : Host (x86-64 linux) builds of the kernel core for benchmarking
+#  ******************************************************************************
+
+HOST_COMPILER  := gcc
+HOST_BUILD_DIR := build/host
+BENCH_DIR      := bench
+
+HOST_DEFS     := -DSPRINTER_HOST
+HOST_INCLUDES := -Iinc -Iinc/core -Isrc -I../memmap -I../common
+HOST_CFLAGS   := $(HOST_DEFS) $(HOST_INCLUDES) -std=gnu11 -O2 -g -Wall -Wextra -Wpedantic -Wshadow
+HOST_LDFLAGS  := -no-pie
+
+# --- Benchmarks ---
+MEM_BENCH_SRCS := \
+$(SOURCE_DIR)/core/mem.c \
+$(SOURCE_DIR)/core/slab.c \
+$(BENCH_DIR)/host_memmap.c \
+$(BENCH_DIR)/mem_bench.c
+
+MEM_BENCH := $(HOST_BUILD_DIR)/mem_bench
+
+$(MEM_BENCH): $(MEM_BENCH_SRCS) $(wildcard inc/core/*.h)
+	@mkdir -p $(dir $@)
+	$(HOST_COMPILER) $(HOST_CFLAGS) $(MEM_BENCH_SRCS) $(HOST_LDFLAGS) -o $@
+
+# trace replayer, once per allocator. replays bench/traces/*.trace (uart logs recorded with
+# MEM_TRACE=1) plus a synthetic trace
+TRACE_BENCH_BUDDY := $(HOST_BUILD_DIR)/trace_bench_buddy
+TRACE_BENCH_TLSF  := $(HOST_BUILD_DIR)/trace_bench_tlsf
+SYNTH_TRACE       := $(HOST_BUILD_DIR)/synthetic.trace
+TRACES            := $(SYNTH_TRACE) $(wildcard $(BENCH_DIR)/traces/*.trace)
+
+$(TRACE_BENCH_BUDDY): $(SOURCE_DIR)/core/mem.c $(SOURCE_DIR)/core/slab.c $(BENCH_DIR)/host_memmap.c $(BENCH_DIR)/trace_bench.c $(wildcard inc/core/*.h)
+	@mkdir -p $(dir $@)
+	$(HOST_COMPILER) $(HOST_CFLAGS) $(filter %.c, $^) $(HOST_LDFLAGS) -o $@
+
+$(TRACE_BENCH_TLSF): $(SOURCE_DIR)/core/mem_tlsf.c $(BENCH_DIR)/host_memmap.c $(BENCH_DIR)/trace_bench.c $(wildcard inc/core/*.h)
+	@mkdir -p $(dir $@)
+	$(HOST_COMPILER) $(HOST_CFLAGS) -DMEM_USE_TLSF $(filter %.c, $^) $(HOST_LDFLAGS) -o $@
+
+$(SYNTH_TRACE): $(TRACE_BENCH_BUDDY)
+	./$< --synth 0x5EED > $@
+
+# kernel core (allocator, kernel heap, task buffer), once per allocator. results also go to
+# build/host/core_bench_<allocator>.csv for comparing runs
+CORE_BENCH_SRCS := \
+$(SOURCE_DIR)/core/event.c \
+$(SOURCE_DIR)/core/kmem.c \
+$(SOURCE_DIR)/core/kobj.c \
+$(SOURCE_DIR)/core/ktimer.c \
+$(SOURCE_DIR)/core/mpu.c \
+$(SOURCE_DIR)/core/msgq.c \
+$(SOURCE_DIR)/core/mutex.c \
+$(SOURCE_DIR)/drivers/iwdg.c \
+$(SOURCE_DIR)/core/sched.c \
+$(SOURCE_DIR)/core/sem.c \
+$(SOURCE_DIR)/core/stack.c \
+$(SOURCE_DIR)/core/syscall.c \
+$(SOURCE_DIR)/core/tcb.c \
+$(SOURCE_DIR)/core/tcb_buf.c \
+$(BENCH_DIR)/host_memmap.c \
+$(BENCH_DIR)/core_bench.c
+
+CORE_BENCH_BUDDY := $(HOST_BUILD_DIR)/core_bench_buddy
+CORE_BENCH_TLSF  := $(HOST_BUILD_DIR)/core_bench_tlsf
+
+$(CORE_BENCH_BUDDY): $(SOURCE_DIR)/core/mem.c $(SOURCE_DIR)/core/slab.c $(CORE_BENCH_SRCS) $(wildcard inc/core/*.h)
+	@mkdir -p $(dir $@)
+	$(HOST_COMPILER) $(HOST_CFLAGS) $(filter %.c, $^) $(HOST_LDFLAGS) -o $@
+
+$(CORE_BENCH_TLSF): $(SOURCE_DIR)/core/mem_tlsf.c $(CORE_BENCH_SRCS) $(wildcard inc/core/*.h)
+	@mkdir -p $(dir $@)
+	$(HOST_COMPILER) $(HOST_CFLAGS) -DMEM_USE_TLSF $(filter %.c, $^) $(HOST_LDFLAGS) -o $@
+
+# message queues, producer and consumer threads on one queue. links the buddy build of the
+# kernel core since blocking receives go through the scheduler
+MSGQ_BENCH := $(HOST_BUILD_DIR)/msgq_bench
+
+$(MSGQ_BENCH): $(SOURCE_DIR)/core/mem.c $(SOURCE_DIR)/core/slab.c $(filter-out $(BENCH_DIR)/core_bench.c, $(CORE_BENCH_SRCS)) $(BENCH_DIR)/msgq_bench.c $(wildcard inc/core/*.h)
+	@mkdir -p $(dir $@)
+	$(HOST_COMPILER) $(HOST_CFLAGS) -pthread $(filter %.c, $^) $(HOST_LDFLAGS) -o $@
+
+# "make host-bench"
+.PHONY: host-bench clean-host
+
+host-bench: $(MEM_BENCH) $(TRACE_BENCH_BUDDY) $(TRACE_BENCH_TLSF) $(SYNTH_TRACE) $(CORE_BENCH_BUDDY) $(CORE_BENCH_TLSF) $(MSGQ_BENCH)
+	./$(MEM_BENCH)
+	./$(TRACE_BENCH_BUDDY) $(TRACES)
+	./$(TRACE_BENCH_TLSF) $(TRACES)
+	./$(CORE_BENCH_BUDDY) --csv $(CORE_BENCH_BUDDY).csv
+	./$(CORE_BENCH_TLSF) --csv $(CORE_BENCH_TLSF).csv
+	./$(MSGQ_BENCH)
+
+clean-host:
+	@rm -vrf $(HOST_BUILD_DIR)
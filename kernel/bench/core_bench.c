@@ -0,0 +1,1194 @@
+/*
+ * host benchmark for the kernel core
+ * built once per allocator (MEM_ALLOCATOR) together with the task buffer and the kernel heap,
+ * against the simulated memory map in host_memmap.c. runs alloc/free mixes, fragmentation
+ * storms, task create/remove churn, scheduler wake/block, a simulated EDF task set, the timer
+ * wheel, copied vs handed over ipc frames, mutex priority inheritance, semaphore / event
+ * wakeups from ISRs and system call dispatch and prints one result per line:
+ *
+ *   <allocator> <bench> <metric> <value> <unit>
+ *
+ * core_bench --csv <file> also writes the same rows as "allocator,bench,metric,value,unit"
+ * for scripts to diff between builds
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sprinter_common.h"
+#include "event.h"
+#include "kmem.h"
+#include "kobj.h"
+#include "ktimer.h"
+#include "mem.h"
+#include "mpu.h"
+#include "msgq.h"
+#include "mutex.h"
+#include "sched.h"
+#include "sem.h"
+#include "stack.h"
+#include "syscall.h"
+#include "tcb.h"
+#include "tcb_buf.h"
+
+#if defined(MEM_USE_TLSF)
+#define ALLOCATOR_NAME "tlsf"
+#else
+#define ALLOCATOR_NAME "buddy"
+#endif
+
+#define BENCH_SLOTS         256
+#define BENCH_MIX_OPS       200000
+#define BENCH_STORM_ROUNDS  50
+#define BENCH_CHURN_OPS     100000
+#define BENCH_POOL_OPS      200000
+#define BENCH_SCHED_OPS     200000
+#define BENCH_EDF_TICKS     200000
+#define BENCH_EDF_OFFERS    256
+#define BENCH_TIMERS        4096
+#define BENCH_TIMER_TICKS   200000
+#define BENCH_IPC_FRAMES    100000
+#define BENCH_IPC_FRAME_B   4096
+#define BENCH_MUTEX_OPS     1000000
+#define BENCH_MUTEX_CHAINS  100000
+#define BENCH_SYNC_OPS      100000
+#define BENCH_SYNC_TIMEOUT  5
+#define BENCH_SYSCALL_OPS   1000000
+
+static heap_manager heap;
+static kmem_arena_t kernel_mem;
+static uint32_t lat_ns[BENCH_MIX_OPS];
+static FILE* csv;
+static int failed;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void result(const char* bench, const char* metric, double value, const char* unit) {
+    printf("%-6s %-8s %-16s %12.1f %s\n", ALLOCATOR_NAME, bench, metric, value, unit);
+    if (csv != NULL) {
+        fprintf(csv, "%s,%s,%s,%.1f,%s\n", ALLOCATOR_NAME, bench, metric, value, unit);
+    }
+}
+
+/* p50/p99/max of the first n samples in lat_ns, sorts them */
+static void latency(const char* bench, const char* op, uint32_t n) {
+    char metric[32];
+    if (n == 0) {
+        return;
+    }
+
+    qsort(lat_ns, n, sizeof(uint32_t), cmp_u32);
+    snprintf(metric, sizeof(metric), "%s_p50", op);
+    result(bench, metric, lat_ns[n / 2], "ns");
+    snprintf(metric, sizeof(metric), "%s_p99", op);
+    result(bench, metric, lat_ns[(n * 99) / 100], "ns");
+    snprintf(metric, sizeof(metric), "%s_max", op);
+    result(bench, metric, lat_ns[n - 1], "ns");
+}
+
+/* everything handed back, the heap should have no bytes left charged to anyone */
+static void check_empty(const char* bench) {
+    mem_stats_t stats;
+
+#if !defined(MEM_USE_TLSF)
+    _slab_shrink(&heap);
+#endif
+    _mstats(&heap, &stats);
+    if (stats.bytes_used != 0) {
+        fprintf(stderr, "core_bench: %s leaked %u B\n", bench, (unsigned)stats.bytes_used);
+        failed = 1;
+    }
+}
+
+/* a fresh kernel heap, object table, userspace heap and scheduler, with root on tid 0 */
+static taskbuff_t* bench_tasks(void) {
+    _kminit(&kernel_mem);
+    _minit(&heap);
+    taskbuff_t* tasks = _kmalloc(&kernel_mem, sizeof(taskbuff_t));
+    if (kobj_init(&kernel_mem) != _OK || init_taskbuff(tasks, &heap) != _OK || sched_init(tasks) != _OK ||
+        create_task(tasks, root, NULL, SCHED_PRIO_IDLE, STACK_SIZE, 0) != _OK) {
+        failed = 1;
+        return NULL;
+    }
+    return tasks;
+}
+
+/*
+ * mix: random alloc/free over a fixed set of slots, 16 B - 4 KB with a bias towards small
+ */
+static void run_mix(void) {
+    static address_t slots[BENCH_SLOTS];
+    uint32_t seed = 0x5EED1234;
+    uint32_t n_alloc = 0;
+    uint32_t failures = 0;
+
+    memset(slots, 0, sizeof(slots));
+    _minit(&heap);
+
+    uint64_t start = now_ns();
+    for (uint32_t op = 0; op < BENCH_MIX_OPS; op++) {
+        uint32_t r = xorshift(&seed);
+        uint32_t slot = r % BENCH_SLOTS;
+        if (slots[slot] != 0) {
+            _free(&heap, slots[slot]);
+            slots[slot] = 0;
+            continue;
+        }
+
+        memsize_t size = 16 + (xorshift(&seed) >> (20 + (r >> 30)));
+        uint64_t t = now_ns();
+        address_t addr = _malloc(&heap, size, slot % MAX_TASKS);
+        lat_ns[n_alloc++] = (uint32_t)(now_ns() - t);
+        if (addr == (address_t)_ERR) {
+            failures++;
+        } else {
+            slots[slot] = addr;
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    result("mix", "throughput", (double)BENCH_MIX_OPS * 1e3 / (double)elapsed, "Mops/s");
+    result("mix", "failures", failures, "allocs");
+    latency("mix", "alloc", n_alloc);
+
+    for (uint32_t i = 0; i < BENCH_SLOTS; i++) {
+        if (slots[i] != 0) {
+            _free(&heap, slots[i]);
+        }
+    }
+    check_empty("mix");
+}
+
+/*
+ * storm: fill the heap with random 16 B - 2 KB blocks until it fails, free every other one and
+ * see what's left for bigger blocks. the classic way to shred a heap
+ */
+static void run_storm(void) {
+    static address_t blocks[USERSPACE_HEAP_SIZE / 16];
+    uint32_t seed = 0xDEADBEEF;
+    uint64_t fill_ns = 0;
+    uint64_t fill_ops = 0;
+    uint64_t free_pct = 0;
+    uint64_t largest = 0;
+    uint32_t big_ok = 0;
+
+    for (uint32_t round = 0; round < BENCH_STORM_ROUNDS; round++) {
+        uint32_t n = 0;
+        address_t addr;
+        _minit(&heap);
+
+        uint64_t start = now_ns();
+        while ((addr = _malloc(&heap, 16 + (xorshift(&seed) % 2033), n % MAX_TASKS)) != (address_t)_ERR) {
+            blocks[n++] = addr;
+        }
+        fill_ns += now_ns() - start;
+        fill_ops += n + 1;
+
+        for (uint32_t i = 0; i < n; i += 2) {
+            _free(&heap, blocks[i]);
+            blocks[i] = 0;
+        }
+
+        mem_stats_t stats;
+        _mstats(&heap, &stats);
+        free_pct += (100ull * stats.bytes_free) / USERSPACE_HEAP_SIZE;
+        largest += stats.largest_free;
+
+        /* 4 KB blocks that still fit in the holes */
+        while ((addr = _malloc(&heap, 4096, 0)) != (address_t)_ERR) {
+            big_ok++;
+        }
+
+        for (tid_t t = 0; t < MAX_TASKS; t++) {
+            _free_all_owned(&heap, t);
+        }
+        check_empty("storm");
+    }
+
+    result("storm", "fill", (double)fill_ns / (double)fill_ops, "ns/op");
+    result("storm", "free_after", (double)free_pct / BENCH_STORM_ROUNDS, "%");
+    result("storm", "largest_free", (double)largest / BENCH_STORM_ROUNDS, "B");
+    result("storm", "4k_fit", (double)big_ok / BENCH_STORM_ROUNDS, "blocks");
+}
+
+/*
+ * churn: a full task buffer where random tasks allocate a few blocks, get removed (which
+ * reclaims them and their stack) and are replaced by one with a 512 B - 4 KB stack, timed per
+ * remove + create pair
+ */
+static void run_churn(void) {
+    uint32_t seed = 0xC0FFEE;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    while (create_task(tasks, root, NULL, SCHED_PRIO_IDLE, STACK_SIZE, 0) == _OK) {
+    }
+
+    for (uint32_t op = 0; op < BENCH_CHURN_OPS; op++) {
+        /* tid 0 is root and can't be removed, the freed slot is the one create fills */
+        tid_t tid = 1 + (xorshift(&seed) % (MAX_TASKS - 1));
+        for (uint32_t b = 0; b < 3; b++) {
+            _malloc(&heap, 24u << (xorshift(&seed) % 8), tid);
+        }
+
+        uint64_t t = now_ns();
+        remove_task(tasks, tid);
+        create_task(tasks, root, NULL, SCHED_PRIO_IDLE, STACK_CHUNK_B << (xorshift(&seed) % 4), 0);
+        lat_ns[op] = (uint32_t)(now_ns() - t);
+    }
+
+    if (tasks->tasks_in_buf != MAX_TASKS) {
+        fprintf(stderr, "core_bench: churn ended with %u tasks\n", (unsigned)tasks->tasks_in_buf);
+        failed = 1;
+    }
+    latency("churn", "pair", BENCH_CHURN_OPS);
+    result("churn", "stack_peak", tasks->stacks.stats.high_water, "B");
+
+    /* high water scans, nothing ran so every stack only has its initial frame on it */
+    uint64_t start = now_ns();
+    for (tid_t t = 0; t < MAX_TASKS; t++) {
+        task_stack_t usage;
+        if (task_stack_usage(tasks, t, &usage) != _OK || usage.peak == 0 || usage.peak > 128) {
+            fprintf(stderr, "core_bench: tid %u stack scan says %u B\n", (unsigned)t, (unsigned)usage.peak);
+            failed = 1;
+        }
+    }
+    result("churn", "stack_scan", (double)(now_ns() - start) / MAX_TASKS, "ns/task");
+
+    for (tid_t t = 1; t < MAX_TASKS; t++) {
+        remove_task(tasks, t);
+    }
+    check_empty("churn");
+    if (tasks->stacks.stats.stacks != 1) {
+        fprintf(stderr, "core_bench: churn left %u stacks\n", (unsigned)tasks->stacks.stats.stacks);
+        failed = 1;
+    }
+}
+
+/*
+ * sched: a started scheduler over a full task buffer at random priorities, random tasks get
+ * suspended and woken up again, timed per suspend + run pair. every one goes through the
+ * ready queues and a pick, the time shouldn't depend on how many tasks there are
+ */
+static void run_sched(void) {
+    uint32_t seed = 0x5C4ED;
+    uint32_t switches = 0;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    while (create_task(tasks, root, NULL, 1 + (xorshift(&seed) % (SCHED_PRIORITIES - 1)), STACK_SIZE, 0) == _OK) {
+    }
+    sched_start();
+
+    switches = scheduler.switches;
+    for (uint32_t op = 0; op < BENCH_SCHED_OPS; op++) {
+        tid_t tid = 1 + (xorshift(&seed) % (MAX_TASKS - 1));
+
+        uint64_t t = now_ns();
+        suspend_task(tasks, tid);
+        run_task(tasks, tid);
+        lat_ns[op] = (uint32_t)(now_ns() - t);
+    }
+
+    /* the highest priority task has to be the one on the cpu */
+    uint32_t top = 31 - __builtin_clz(scheduler.ready_map | 1u);
+    if (scheduler.next == NULL || scheduler.next->priority < top) {
+        fprintf(stderr, "core_bench: sched left a lower priority task running\n");
+        failed = 1;
+    }
+    result("sched", "switches", (double)(scheduler.switches - switches) / BENCH_SCHED_OPS, "per_pair");
+    latency("sched", "pair", BENCH_SCHED_OPS);
+
+    /* a top snapshot over the full buffer, every switch away was counted one way or the other */
+    static task_cpu_t snapshot[MAX_TASKS];
+    uint32_t count = 0;
+    uint64_t start = now_ns();
+    task_cpu_top(tasks, snapshot, MAX_TASKS, &count);
+    result("sched", "top", (double)(now_ns() - start), "ns");
+
+    uint32_t off_cpu = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        off_cpu += snapshot[i].preemptions + snapshot[i].voluntary;
+    }
+    if (count != MAX_TASKS || off_cpu + 1 != scheduler.switches) {
+        fprintf(stderr, "core_bench: top saw %u tasks, %u of %u switches\n",
+                (unsigned)count, (unsigned)off_cpu, (unsigned)scheduler.switches);
+        failed = 1;
+    }
+
+    /*
+     * the running task removes itself with blocks on the heap, on target it never runs again
+     * once the switch away is taken. they have to be back by the time remove_task returns
+     */
+    scheduler.current = scheduler.next;
+    volatile tcb_t* self = scheduler.current;
+    tid_t self_tid = self->tid;
+    address_t held[4];
+    for (uint32_t b = 0; b < 4; b++) {
+        held[b] = _malloc(&heap, 64u << b, self_tid);
+    }
+    if (remove_task(tasks, self_tid) != _OK || self->status != STATUS_NULL || scheduler.next == self) {
+        fprintf(stderr, "core_bench: sched self removal didn't switch away\n");
+        failed = 1;
+    }
+    for (uint32_t b = 0; b < 4; b++) {
+        if (held[b] == (address_t)_ERR || _mowner(&heap, held[b]) == self_tid) {
+            fprintf(stderr, "core_bench: sched self removal kept block %u\n", (unsigned)b);
+            failed = 1;
+        }
+    }
+
+    /* a faulting task is only taken off the cpu in the handler, PendSV's deferred work removes it */
+    mpu_fault_t faults;
+    mpu_fault_stats(&faults);
+    volatile tcb_t* faulted = scheduler.next;
+    uint32_t in_buf = tasks->tasks_in_buf;
+    scheduler.current = NULL;
+    mpu_fault(faulted, SCB_CFSR_MSTKERR, 0);
+    if (faulted->status == STATUS_NULL || tasks->tasks_in_buf != in_buf) {
+        fprintf(stderr, "core_bench: sched faulted task torn down in the handler\n");
+        failed = 1;
+    }
+    sched_run_deferred();
+    mpu_fault_t after;
+    mpu_fault_stats(&after);
+    if (faulted->status != STATUS_NULL || tasks->tasks_in_buf != in_buf - 1 || scheduler.next == faulted ||
+        after.faults != faults.faults + 1 || !after.overflow || after.tid != faulted->tid) {
+        fprintf(stderr, "core_bench: sched faulted task wasn't removed by deferred work\n");
+        failed = 1;
+    }
+    scheduler.current = scheduler.next;
+
+    for (tid_t t = 1; t < MAX_TASKS; t++) {
+        remove_task(tasks, t);
+    }
+    check_empty("sched");
+}
+
+/*
+ * edf: random periodic tasks are offered until the buffer is full or BENCH_EDF_OFFERS have
+ * been made, the ones that would take the EDF class over SCHED_EDF_UTIL_PPM are turned away.
+ * then the tick is simulated. whichever task the scheduler picked runs for
+ * the tick, an EDF job that has had its whole budget calls sched_wait_period. every admitted
+ * set has to go without a single deadline miss or overrun, SysTick_Handler is timed per tick
+ */
+static void run_edf(void) {
+    static uint32_t exec[MAX_TASKS];
+    uint32_t seed = 0xEDF0;
+    uint32_t admitted = 0;
+    uint32_t rejected = 0;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    for (uint32_t offer = 0; offer < BENCH_EDF_OFFERS && tasks->tasks_in_buf < MAX_TASKS; offer++) {
+        uint32_t period = 5 + (xorshift(&seed) % 96);
+        uint32_t deadline = period - (xorshift(&seed) % (period / 4 + 1));
+        uint32_t budget = 1 + (xorshift(&seed) % (deadline / 4 + 1));
+        if (create_rt_task(tasks, root, NULL, period, deadline, budget, STACK_SIZE, 0) == _OK) {
+            admitted++;
+        } else {
+            rejected++;
+        }
+    }
+    memset(exec, 0, sizeof(exec));
+    sched_start();
+
+    for (uint32_t tick = 0; tick < BENCH_EDF_TICKS; tick++) {
+        /*
+         * the switch PendSV would have made. a job that ends mid tick hands the rest of it to
+         * the next task, which is charged the whole tick, so that one gets a tick's work done too
+         */
+        scheduler.current = scheduler.next;
+        while (scheduler.current->edf.period != 0 &&
+               ++exec[scheduler.current->tid] == scheduler.current->edf.budget) {
+            exec[scheduler.current->tid] = 0;
+            sched_wait_period();
+            scheduler.current = scheduler.next;
+        }
+
+        uint64_t t = now_ns();
+        SysTick_Handler();
+        lat_ns[tick] = (uint32_t)(now_ns() - t);
+    }
+
+    uint32_t jobs = 0;
+    uint32_t misses = 0;
+    uint32_t overruns = 0;
+    for (tid_t t = 1; t < MAX_TASKS; t++) {
+        if (tasks->buffer[t].status != STATUS_NULL) {
+            jobs += tasks->buffer[t].edf.jobs;
+            misses += tasks->buffer[t].edf.deadline_misses;
+            overruns += tasks->buffer[t].edf.overruns;
+        }
+    }
+    if (admitted == 0 || misses != 0 || overruns != 0) {
+        fprintf(stderr, "core_bench: edf admitted %u tasks, %u misses %u overruns\n",
+                (unsigned)admitted, (unsigned)misses, (unsigned)overruns);
+        failed = 1;
+    }
+    result("edf", "tasks", admitted, "tasks");
+    result("edf", "rejected", rejected, "tasks");
+    result("edf", "util", scheduler.edf_util_ppm / 10000.0, "%");
+    result("edf", "jobs", jobs, "jobs");
+    result("edf", "misses", misses, "jobs");
+    latency("edf", "tick", BENCH_EDF_TICKS);
+
+    /* a job that sleeps part way through wakes up as the same job, not a new one */
+    scheduler.current = scheduler.next;
+    volatile tcb_t* sleeper = scheduler.current;
+    if (sleeper->edf.period != 0) {
+        uint32_t release = sleeper->edf.release;
+        uint32_t jobs_before = sleeper->edf.jobs;
+        sched_sleep(1);
+        for (uint32_t i = 0; i < 2 && sleeper->status == STATUS_SLEEPING; i++) {
+            SysTick_Handler();
+        }
+        if (sleeper->status == STATUS_SLEEPING || sleeper->edf.jobs != jobs_before ||
+            sleeper->edf.release != release) {
+            fprintf(stderr, "core_bench: edf wake started a new job\n");
+            failed = 1;
+        }
+    }
+
+    for (tid_t t = 1; t < MAX_TASKS; t++) {
+        remove_task(tasks, t);
+    }
+    if (scheduler.edf_util_ppm != 0) {
+        fprintf(stderr, "core_bench: edf left %u ppm admitted\n", (unsigned)scheduler.edf_util_ppm);
+        failed = 1;
+    }
+    check_empty("edf");
+}
+
+/*
+ * timer: BENCH_TIMERS timers on a wheel of their own, a quarter of them periodic, delays out to
+ * a few levels up. every tick a few random ones are restarted or cancelled, every firing is
+ * checked against the tick it was due on. then tasks sleep on the scheduler's wheel and none
+ * may run before its wakeup
+ */
+static ktimer_wheel_t bench_wheel;
+static ktimer_t bench_timers[BENCH_TIMERS];
+static uint32_t bench_due[BENCH_TIMERS];
+static uint32_t timer_errors;
+
+static void bench_timer_fired(void* arg) {
+    uint32_t i = (uint32_t)(uintptr_t)arg;
+
+    if (bench_wheel.now != bench_due[i]) {
+        timer_errors++;
+    }
+    bench_due[i] += bench_timers[i].period;
+}
+
+static void restart_timer(uint32_t* seed, uint32_t i) {
+    uint32_t delay = 1 + (xorshift(seed) % ((xorshift(seed) % 4 == 0) ? 300000 : 5000));
+    uint32_t period = (i % 4 == 0) ? 1 + (xorshift(seed) % 2000) : 0;
+
+    bench_due[i] = bench_wheel.now + delay;
+    _ktimer_start(&bench_wheel, &bench_timers[i], delay, period);
+}
+
+static void run_timer(void) {
+    static uint32_t woken_at[MAX_TASKS];
+    uint32_t seed = 0x71AE5;
+    uint32_t n_start = 0;
+
+    _ktimer_init(&bench_wheel, 0xFFFF0000u);        /* the tick count wraps part way */
+    timer_errors = 0;
+    for (uint32_t i = 0; i < BENCH_TIMERS; i++) {
+        _ktimer_setup(&bench_timers[i], bench_timer_fired, (void*)(uintptr_t)i);
+        uint64_t t = now_ns();
+        restart_timer(&seed, i);
+        lat_ns[n_start++] = (uint32_t)(now_ns() - t);
+    }
+    for (uint32_t tick = 0; tick < BENCH_TIMER_TICKS / 8; tick++) {
+        for (uint32_t op = 0; op < 4; op++) {
+            uint32_t i = xorshift(&seed) % BENCH_TIMERS;
+            uint64_t t = now_ns();
+            if (xorshift(&seed) % 4 == 0) {
+                _ktimer_cancel(&bench_wheel, &bench_timers[i]);
+            } else {
+                restart_timer(&seed, i);
+            }
+            lat_ns[n_start++] = (uint32_t)(now_ns() - t);
+        }
+        _ktimer_advance(&bench_wheel, bench_wheel.now + 1);
+    }
+    latency("timer", "start", n_start);
+
+    uint64_t start = now_ns();
+    for (uint32_t tick = 0; tick < BENCH_TIMER_TICKS; tick++) {
+        uint64_t t = now_ns();
+        _ktimer_advance(&bench_wheel, bench_wheel.now + 1);
+        lat_ns[tick] = (uint32_t)(now_ns() - t);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    ktimer_stats_t stats;
+    _ktimer_stats(&bench_wheel, &stats);
+    if (timer_errors != 0 || stats.fired == 0) {
+        fprintf(stderr, "core_bench: timer fired %u, %u on the wrong tick\n",
+                (unsigned)stats.fired, (unsigned)timer_errors);
+        failed = 1;
+    }
+    result("timer", "fired", stats.fired, "timers");
+    result("timer", "cascaded", (double)stats.cascaded / stats.fired, "per_fired");
+    result("timer", "tick", (double)elapsed / BENCH_TIMER_TICKS, "ns/tick");
+    latency("timer", "tick", BENCH_TIMER_TICKS);
+
+    /* sleeping tasks */
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    while (create_task(tasks, root, NULL, 1 + (xorshift(&seed) % (SCHED_PRIORITIES - 1)), STACK_SIZE, 0) == _OK) {
+    }
+    memset(woken_at, 0, sizeof(woken_at));
+    sched_start();
+
+    uint32_t sleeps = 0;
+    uint32_t early = 0;
+    for (uint32_t tick = 0; tick < BENCH_TIMER_TICKS; tick++) {
+        scheduler.current = scheduler.next;
+        tid_t tid = scheduler.current->tid;
+        if (tid != 0) {
+            if ((int32_t)(scheduler.ticks - woken_at[tid]) < 0) {
+                early++;
+            }
+            uint32_t ticks = 1 + (xorshift(&seed) % 1000);
+            woken_at[tid] = scheduler.ticks + ticks;
+            sched_sleep(ticks);
+            sleeps++;
+        }
+        SysTick_Handler();
+    }
+    if (early != 0) {
+        fprintf(stderr, "core_bench: %u tasks ran before their wakeup\n", (unsigned)early);
+        failed = 1;
+    }
+    result("timer", "sleeps", sleeps, "sleeps");
+
+    for (tid_t t = 1; t < MAX_TASKS; t++) {
+        remove_task(tasks, t);
+    }
+    if (scheduler.timers.stats.pending != 0) {
+        fprintf(stderr, "core_bench: %u sleep timers left\n", (unsigned)scheduler.timers.stats.pending);
+        failed = 1;
+    }
+    check_empty("timer");
+}
+
+/*
+ * ipc: BENCH_IPC_FRAME_B frames from one task to another, copied through a queue and then
+ * handed over as heap blocks through a block queue, timed per frame for send + receive. a
+ * handed over block has to be charged to the receiver and nothing left on the sender
+ */
+static void run_ipc(void) {
+    static uint8_t ring[MSGQ_BUFFER_B(BENCH_IPC_FRAME_B, 4)];
+    static uint8_t frame[BENCH_IPC_FRAME_B];
+    msgq_t queue;
+    uint32_t errors = 0;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    create_task(tasks, root, NULL, 1, STACK_SIZE, 0);
+    create_task(tasks, root, NULL, 1, STACK_SIZE, 0);
+    sched_start();
+    volatile tcb_t* sender = &tasks->buffer[1];
+    volatile tcb_t* receiver = &tasks->buffer[2];
+
+    msgq_init(&queue, ring, BENCH_IPC_FRAME_B, 4);
+    memset(frame, 0xA5, sizeof(frame));
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_IPC_FRAMES; i++) {
+        scheduler.current = sender;
+        msgq_send(&queue, frame);
+        scheduler.current = receiver;
+        msgq_recv(&queue, frame, false);
+    }
+    result("ipc", "copy", (double)(now_ns() - start) / BENCH_IPC_FRAMES, "ns/frame");
+
+    msgq_init(&queue, ring, MSGQ_BLOCK_B, 4);
+    for (uint32_t i = 0; i < BENCH_IPC_FRAMES; i++) {
+        address_t block = _malloc(&heap, BENCH_IPC_FRAME_B, sender->tid);
+        address_t got = 0;
+
+        uint64_t t = now_ns();
+        scheduler.current = sender;
+        int err = msgq_send_block(&queue, &heap, block, receiver->tid);
+        scheduler.current = receiver;
+        msgq_recv_block(&queue, &got, false);
+        lat_ns[i] = (uint32_t)(now_ns() - t);
+
+        if (err != _OK || got != block) {
+            errors++;
+        }
+        if ((i % 1024) == 0) {
+            mem_stats_t stats;
+            _mstats(&heap, &stats);
+            if (stats.owner_bytes[sender->tid] != 0 || stats.owner_bytes[receiver->tid] < BENCH_IPC_FRAME_B) {
+                errors++;
+            }
+        }
+        _free(&heap, got);
+    }
+    latency("ipc", "handover", BENCH_IPC_FRAMES);
+
+    /* a block that isn't the sender's stays where it is */
+    scheduler.current = sender;
+    address_t other = _malloc(&heap, BENCH_IPC_FRAME_B, receiver->tid);
+    if (msgq_send_block(&queue, &heap, other, receiver->tid) != _NOP || msgq_count(&queue) != 0) {
+        errors++;
+    }
+    _free(&heap, other);
+
+    /* a parked receiver is woken from PendSV's deferred work, not by the send itself */
+    msgq_init(&queue, ring, BENCH_IPC_FRAME_B, 4);
+    queue.waiter = receiver;
+    sched_block(receiver, STATUS_BLOCKED);
+    msgq_send(&queue, frame);
+    if (receiver->status != STATUS_BLOCKED) {
+        errors++;
+    }
+    sched_run_deferred();
+    if (receiver->status == STATUS_BLOCKED || queue.waiter != NULL) {
+        errors++;
+    }
+
+    if (errors != 0) {
+        fprintf(stderr, "core_bench: ipc %u frames lost or charged to the wrong task\n", (unsigned)errors);
+        failed = 1;
+    }
+
+    remove_task(tasks, 1);
+    remove_task(tasks, 2);
+    check_empty("ipc");
+}
+
+/*
+ * mutex: uncontended lock/unlock pairs, then an inheritance chain played out with run_task
+ * standing in for tasks turning up. low takes a, mid takes b and waits on a, high waits on b.
+ * low has to be running at high's priority two mutexes away, and everyone back at their own
+ * once it's all been handed back. timed per chain. nothing really blocks here, a task that
+ * waits just returns and the bench carries on as whoever the scheduler picked
+ */
+static void mutex_chain(taskbuff_t* tasks, mutex_t* a, mutex_t* b) {
+    scheduler.current = &tasks->buffer[1];
+    mutex_lock(a, SCHED_WAIT_FOREVER);
+    run_task(tasks, 2);
+    scheduler.current = scheduler.next;
+    mutex_lock(b, SCHED_WAIT_FOREVER);
+    mutex_lock(a, SCHED_WAIT_FOREVER);
+    run_task(tasks, 3);
+    scheduler.current = scheduler.next;
+    mutex_lock(b, SCHED_WAIT_FOREVER);
+}
+
+static void run_mutex(void) {
+    mutex_t a;
+    mutex_t b;
+    uint32_t errors = 0;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    create_task(tasks, root, NULL, 1, STACK_SIZE, 0);
+    create_task(tasks, root, NULL, 5, STACK_SIZE, 0);
+    create_task(tasks, root, NULL, 10, STACK_SIZE, 0);
+    suspend_task(tasks, 2);
+    suspend_task(tasks, 3);
+    sched_start();
+    volatile tcb_t* low = &tasks->buffer[1];
+    volatile tcb_t* mid = &tasks->buffer[2];
+    volatile tcb_t* high = &tasks->buffer[3];
+    mutex_init(&a);
+    mutex_init(&b);
+
+    scheduler.current = low;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_MUTEX_OPS; i++) {
+        mutex_lock(&a, SCHED_WAIT_FOREVER);
+        mutex_unlock(&a);
+    }
+    result("mutex", "pair", (double)(now_ns() - start) / BENCH_MUTEX_OPS, "ns/pair");
+
+    for (uint32_t i = 0; i < BENCH_MUTEX_CHAINS; i++) {
+        uint64_t t = now_ns();
+        mutex_chain(tasks, &a, &b);
+        if (scheduler.next != low || low->priority != high->base_priority) {
+            errors++;
+        }
+
+        /* a goes to mid, b to high, each one dropping back as it lets go */
+        scheduler.current = low;
+        mutex_unlock(&a);
+        scheduler.current = scheduler.next;
+        mutex_unlock(&a);
+        mutex_unlock(&b);
+        scheduler.current = scheduler.next;
+        mutex_unlock(&b);
+        suspend_task(tasks, 3);
+        suspend_task(tasks, 2);
+        lat_ns[i] = (uint32_t)(now_ns() - t);
+
+        if (scheduler.next != low || low->priority != low->base_priority ||
+            mid->priority != mid->base_priority || a.owner != 0 || b.owner != 0) {
+            errors++;
+        }
+    }
+    latency("mutex", "chain", BENCH_MUTEX_CHAINS);
+
+    /* high suspended while it waits, only mid's own priority is left to lend */
+    mutex_chain(tasks, &a, &b);
+    suspend_task(tasks, 3);
+    if (low->priority != mid->base_priority || mid->priority != mid->base_priority ||
+        (b.owner & MUTEX_TID_MASK) != mid->tid + 1) {
+        errors++;
+    }
+    scheduler.current = low;
+    mutex_unlock(&a);
+    scheduler.current = scheduler.next;
+    mutex_unlock(&a);
+    mutex_unlock(&b);
+    suspend_task(tasks, 2);
+    if (low->priority != low->base_priority || a.owner != 0 || b.owner != 0) {
+        errors++;
+    }
+
+    mutex_stats_t stats;
+    mutex_stats(&a, &stats);
+    result("mutex", "contended", 100.0 * stats.contended / stats.locks, "% of locks");
+    if (errors != 0 || stats.inherited != BENCH_MUTEX_CHAINS + 1) {
+        fprintf(stderr, "core_bench: mutex %u chains left the wrong priorities, %u inherited\n",
+                (unsigned)errors, (unsigned)stats.inherited);
+        failed = 1;
+    }
+
+    /* a wait that times out comes back without it, and low drops what mid lent it */
+    uint32_t timeouts = stats.timeouts;
+    scheduler.current = low;
+    mutex_lock(&a, SCHED_WAIT_FOREVER);
+    run_task(tasks, mid->tid);
+    scheduler.current = mid;
+    int polled = mutex_lock(&a, 0);
+    mutex_lock(&a, BENCH_SYNC_TIMEOUT);
+    for (uint32_t t = 1; t < BENCH_SYNC_TIMEOUT; t++) {
+        SysTick_Handler();
+    }
+    if (polled != _NOP || mid->status != STATUS_BLOCKED || low->priority != mid->base_priority) {
+        fprintf(stderr, "core_bench: mutex timed wait gave up early\n");
+        failed = 1;
+    }
+    SysTick_Handler();
+    mutex_stats(&a, &stats);
+    if (mid->status == STATUS_BLOCKED || mid->wait.value != 0 || low->priority != low->base_priority ||
+        a.owner != (low->serial << MUTEX_TID_BITS | (low->tid + 1)) || stats.timeouts != timeouts + 1) {
+        fprintf(stderr, "core_bench: mutex wait didn't time out\n");
+        failed = 1;
+    }
+    scheduler.current = low;
+    mutex_unlock(&a);
+    suspend_task(tasks, mid->tid);
+
+    /* removed holding them, a goes to the task waiting on it and b to whoever locks it next */
+    scheduler.current = low;
+    mutex_lock(&a, SCHED_WAIT_FOREVER);
+    run_task(tasks, mid->tid);
+    scheduler.current = mid;
+    mutex_lock(&b, SCHED_WAIT_FOREVER);
+    mutex_lock(&a, SCHED_WAIT_FOREVER);
+    remove_task(tasks, low->tid);
+    if ((a.owner & MUTEX_TID_MASK) != mid->tid + 1 || mid->status == STATUS_BLOCKED ||
+        mutex_unlock(&a) != _OK || a.owner != 0) {
+        fprintf(stderr, "core_bench: mutex not handed on from a removed holder\n");
+        failed = 1;
+    }
+    remove_task(tasks, mid->tid);
+    create_task(tasks, root, NULL, 1, STACK_SIZE, 0);
+    create_task(tasks, root, NULL, 5, STACK_SIZE, 0);
+    scheduler.current = mid;
+    if (mutex_unlock(&b) != _ERR || mutex_trylock(&b) != _OK || mutex_unlock(&b) != _OK || b.owner != 0) {
+        fprintf(stderr, "core_bench: mutex left by a removed task went to the wrong one\n");
+        failed = 1;
+    }
+
+    for (tid_t t = 1; t < 4; t++) {
+        remove_task(tasks, t);
+    }
+    check_empty("mutex");
+}
+
+/*
+ * sync: a task above the running one waits on a semaphore or an event group and an "ISR" (the
+ * bench, between two ticks) gives or sets, then PendSV's sched_run_deferred. timed from the
+ * give to the waiter being next with what it was woken with, which is what's left of the
+ * wakeup on target besides the exception entry and the switch itself. waits that time out
+ * have to come back empty handed on the tick they're due
+ */
+static void run_sync(void) {
+    sem_t sem;
+    event_t event;
+    uint32_t errors = 0;
+    uint32_t n = 0;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    create_task(tasks, root, NULL, 1, STACK_SIZE, 0);
+    create_task(tasks, root, NULL, 10, STACK_SIZE, 0);
+    sched_start();
+    volatile tcb_t* low = &tasks->buffer[1];
+    volatile tcb_t* waiter = &tasks->buffer[2];
+    sem_init(&sem, 0, 1);
+    event_init(&event);
+
+    for (uint32_t i = 0; i < BENCH_SYNC_OPS; i++) {
+        scheduler.current = waiter;
+        sem_take(&sem, SCHED_WAIT_FOREVER);
+        scheduler.current = low;
+
+        uint64_t t = now_ns();
+        sem_give(&sem);
+        sched_run_deferred();
+        lat_ns[n++] = (uint32_t)(now_ns() - t);
+
+        if (scheduler.next != waiter || waiter->wait.value != 1 || sem_count(&sem) != 0) {
+            errors++;
+        }
+    }
+    latency("sync", "sem_wake", n);
+
+    /* two flags, both wanted and cleared by the waiter, the first alone isn't enough */
+    n = 0;
+    for (uint32_t i = 0; i < BENCH_SYNC_OPS; i++) {
+        scheduler.current = waiter;
+        event_wait(&event, 0x3, EVENT_ALL | EVENT_CLEAR, SCHED_WAIT_FOREVER, NULL);
+        scheduler.current = low;
+        event_set(&event, 0x1);
+        sched_run_deferred();
+        if (scheduler.next != low) {
+            errors++;
+        }
+
+        uint64_t t = now_ns();
+        event_set(&event, 0x2);
+        sched_run_deferred();
+        lat_ns[n++] = (uint32_t)(now_ns() - t);
+
+        if (scheduler.next != waiter || waiter->wait.value != 0x3 || event.flags != 0) {
+            errors++;
+        }
+    }
+    latency("sync", "event_wake", n);
+
+    /* timeouts, through the timer wheel */
+    scheduler.current = waiter;
+    sem_take(&sem, BENCH_SYNC_TIMEOUT);
+    uint32_t due = scheduler.ticks + BENCH_SYNC_TIMEOUT;
+    scheduler.current = low;
+    while (scheduler.next != waiter && scheduler.ticks != due + 1) {
+        SysTick_Handler();
+    }
+    if (scheduler.ticks != due || waiter->wait.value != 0 || sem.waiting != 0 || sem.stats.timeouts != 1) {
+        errors++;
+    }
+
+    sem_stats_t stats;
+    sem_stats(&sem, &stats);
+    result("sync", "sem_woken", stats.woken, "waits");
+    if (errors != 0 || stats.woken != BENCH_SYNC_OPS) {
+        fprintf(stderr, "core_bench: sync %u waiters woken wrong, %u by the semaphore\n",
+                (unsigned)errors, (unsigned)stats.woken);
+        failed = 1;
+    }
+
+    remove_task(tasks, 1);
+    remove_task(tasks, 2);
+    check_empty("sync");
+}
+
+/*
+ * syscall: an unprivileged task's calls through syscall_dispatch, on host the stubs build the
+ * frame the svc would have stacked. timed per call is what the kernel adds on top of the
+ * function it ends up in, the svc entry and exception return are qemu_bench's. its buffers
+ * have to be its own, and a take that blocks gets its result written into the frame it left
+ * when it's woken or times out
+ */
+static void run_syscall(void) {
+    static uint32_t ring[4];
+    uint32_t errors = 0;
+
+    taskbuff_t* tasks = bench_tasks();
+    if (tasks == NULL) {
+        return;
+    }
+    create_task(tasks, root, NULL, 1, STACK_SIZE, TASK_UNPRIVILEGED);
+    create_task(tasks, root, NULL, 10, STACK_SIZE, TASK_UNPRIVILEGED);
+    sched_start();
+    volatile tcb_t* user = &tasks->buffer[1];
+    volatile tcb_t* waiter = &tasks->buffer[2];
+    kobj_t sem = kobj_new(KOBJ_SEM);
+    kobj_t queue = kobj_new(KOBJ_MSGQ);
+    sem_init(kobj_get(sem, KOBJ_SEM), 0, 1);
+    msgq_init(kobj_get(queue, KOBJ_MSGQ), ring, sizeof(uint32_t), 4);
+    scheduler.current = user;
+
+    uint32_t sum = 0;
+    uint64_t t = now_ns();
+    for (uint32_t i = 0; i < BENCH_SYSCALL_OPS; i++) {
+        sum += sys_task_id();
+    }
+    uint64_t elapsed = now_ns() - t;
+    result("syscall", "null", (double)elapsed / BENCH_SYSCALL_OPS, "ns/call");
+
+    t = now_ns();
+    for (uint32_t i = 0; i < BENCH_SYSCALL_OPS; i++) {
+        sys_sem_give(sem);
+        if (sys_sem_take(sem, 0) != _OK) {
+            errors++;
+        }
+    }
+    elapsed = now_ns() - t;
+    result("syscall", "sem_give_take", (double)elapsed / BENCH_SYSCALL_OPS, "ns/pair");
+    if (sum != BENCH_SYSCALL_OPS * user->tid || syscall4(SYS_COUNT, 0, 0, 0, 0) != (address_t)_ERR) {
+        errors++;
+    }
+
+    /*
+     * its own stack above the guard and its own blocks from their start are fine. the guard,
+     * the inside of a block and somebody else's block aren't
+     */
+    uint32_t* on_stack = (uint32_t*)(user->stack_high - 16);
+    uint32_t* on_guard = (uint32_t*)(user->stack_high - user->stack_size);
+    address_t mine = sys_malloc(64);
+    address_t big = sys_malloc(1024);
+    address_t theirs = _malloc(&heap, 64, waiter->tid);
+    if (sys_msgq_send(queue, on_stack) != _OK || sys_msgq_send(queue, (void*)mine) != _OK ||
+        sys_msgq_send(queue, on_guard) != _ERR || sys_msgq_send(queue, (void*)(mine + 8)) != _ERR ||
+        sys_msgq_send(queue, (void*)(big + 8)) != _ERR || sys_msgq_send(queue, (void*)theirs) != _ERR ||
+        sys_msgq_recv(queue, (void*)mine) != _OK || sys_free(mine + 8) != _NOP || sys_free(theirs) != _NOP ||
+        sys_free(mine) != _OK || sys_free(big) != _OK || _free(&heap, theirs) != _OK) {
+        errors++;
+    }
+
+    /* only live handles of the right type, and no one else's tasks */
+    kobj_t stale = kobj_new(KOBJ_SEM);
+    kobj_delete(stale);
+    address_t handed = sys_malloc(1024);
+    if (sys_sem_give(queue) != _ERR || sys_sem_give(stale) != _ERR || sys_msgq_send(sem, on_stack) != _ERR ||
+        sys_sem_take(stale, 0) != _NOP || sys_msgq_send_block(queue, handed, MAX_TASKS) != _ERR ||
+        sys_msgq_send_block(queue, handed + 8, waiter->tid) != _NOP ||
+        sys_task_suspend(0) != _ERR || sys_task_run(waiter->tid) != _ERR || suspend_task(tasks, 0) != _NOP) {
+        errors++;
+    }
+    sys_free(handed);
+
+#if !defined(MEM_USE_TLSF)
+    /*
+     * grants are only on its own blocks, and go with the block, freed or given away. tlsf
+     * blocks aren't aligned for a region
+     */
+    theirs = _malloc(&heap, 1024, waiter->tid);
+    if (grant_task(tasks, user->tid, theirs, 1024) != _NOP) {
+        errors++;
+    }
+    for (uint32_t i = 0; i < 2 * MPU_GRANTS; i++) {
+        address_t block = sys_malloc(1024);
+        if (grant_task(tasks, user->tid, block, 1024) != _OK || user->mpu[3] == 0) {
+            errors++;
+        }
+        int err = (i & 1) ? _mgive(&heap, block, user->tid, waiter->tid) : sys_free(block);
+        if (err != _OK || user->mpu[3] != 0) {
+            errors++;
+        }
+        if (i & 1) {
+            _free(&heap, block);
+        }
+    }
+    _free(&heap, theirs);
+#endif
+
+    /* blocks in the call, the give's wake fills in the frame */
+    volatile address_t frame[SYSCALL_FRAME_WORDS] = { (address_t)sem, SCHED_WAIT_FOREVER, 0, 0, SYS_SEM_TAKE, 0, 0, 0 };
+    scheduler.current = waiter;
+    syscall_dispatch(frame);
+    if (waiter->status != STATUS_BLOCKED || waiter->syscall_frame != frame) {
+        errors++;
+    }
+    scheduler.current = user;
+    sys_sem_give(sem);
+    sched_run_deferred();
+    if (frame[0] != 1 || waiter->syscall_frame != NULL || scheduler.next != waiter) {
+        errors++;
+    }
+
+    /* and one that times out comes back with 0 */
+    frame[0] = (address_t)sem;
+    frame[1] = BENCH_SYNC_TIMEOUT;
+    scheduler.current = waiter;
+    syscall_dispatch(frame);
+    scheduler.current = user;
+    for (uint32_t i = 0; i <= BENCH_SYNC_TIMEOUT && waiter->status == STATUS_BLOCKED; i++) {
+        SysTick_Handler();
+    }
+    if (frame[0] != 0 || waiter->syscall_frame != NULL || scheduler.next != waiter) {
+        errors++;
+    }
+
+    syscall_stats_t stats;
+    syscall_stats(SYS_TASK_ID, &stats);
+    result("syscall", "task_id_calls", stats.calls, "calls");
+    syscall_stats(SYS_SEM_TAKE, &stats);
+    if (stats.calls != BENCH_SYSCALL_OPS + 3) {
+        errors++;
+    }
+
+    /* gone once it exits, its returns go through here */
+    scheduler.current = waiter;
+    (void)syscall4(SYS_EXIT, 0, 0, 0, 0);
+    if (waiter->status != STATUS_NULL) {
+        errors++;
+    }
+
+    if (errors != 0) {
+        fprintf(stderr, "core_bench: syscall %u calls went wrong\n", (unsigned)errors);
+        failed = 1;
+    }
+
+    remove_task(tasks, 1);
+    kobj_delete(sem);
+    kobj_delete(queue);
+    check_empty("syscall");
+}
+
+/*
+ * pool: kernel heap fixed size objects, tcb sized
+ */
+static void run_pool(void) {
+    static void* objs[64];
+    kmem_pool_t pool;
+    uint32_t seed = 0x600D;
+
+    _kminit(&kernel_mem);
+    if (_kpool_init(&kernel_mem, &pool, "tcb", sizeof(tcb_t), MAX_TASKS, MAX_TASKS) != _OK) {
+        failed = 1;
+        return;
+    }
+    memset(objs, 0, sizeof(objs));
+
+    uint64_t start = now_ns();
+    for (uint32_t op = 0; op < BENCH_POOL_OPS; op++) {
+        uint32_t slot = xorshift(&seed) % 64;
+        if (objs[slot] != NULL) {
+            _kpool_free(&pool, objs[slot]);
+            objs[slot] = NULL;
+        } else {
+            objs[slot] = _kpool_alloc(&pool);
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    result("pool", "op", (double)elapsed / BENCH_POOL_OPS, "ns/op");
+    result("pool", "high_water", pool.stats.high_water, "objs");
+
+    /* handles on top of the pools, a pair is what every ipc object set up at runtime costs */
+    if (kobj_init(&kernel_mem) != _OK) {
+        failed = 1;
+        return;
+    }
+
+    start = now_ns();
+    for (uint32_t op = 0; op < BENCH_POOL_OPS; op++) {
+        kobj_t handle = kobj_new(KOBJ_SEM);
+        if (handle == KOBJ_NULL || kobj_delete(handle) != _OK) {
+            failed = 1;
+            break;
+        }
+    }
+    elapsed = now_ns() - start;
+    result("kobj", "new_delete", (double)elapsed / BENCH_POOL_OPS, "ns/pair");
+
+    /* a deleted handle, the wrong type and a made up one all come back empty */
+    kobj_t stale = kobj_new(KOBJ_SEM);
+    kobj_delete(stale);
+    kobj_t sem = kobj_new(KOBJ_SEM);
+    if (kobj_get(stale, KOBJ_SEM) != NULL || kobj_get(sem, KOBJ_MSGQ) != NULL ||
+        kobj_get(sem | KOBJ_SLOT_MASK, KOBJ_SEM) != NULL || kobj_get(sem, KOBJ_SEM) == NULL) {
+        fprintf(stderr, "core_bench: kobj resolved a handle it shouldn't have\n");
+        failed = 1;
+    }
+    kobj_delete(sem);
+
+    /* the table fills up before the dtcm gap does */
+    static kobj_t handles[KOBJ_MAX + 1];
+    uint32_t made = 0;
+    while (made <= KOBJ_MAX && (handles[made] = kobj_new(KOBJ_TIMER)) != KOBJ_NULL) {
+        made++;
+    }
+    if (made != KOBJ_MAX) {
+        fprintf(stderr, "core_bench: kobj table took %u handles\n", made);
+        failed = 1;
+    }
+    for (uint32_t i = 0; i < made; i++) {
+        kobj_delete(handles[i]);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && strcmp(argv[1], "--csv") == 0) {
+        csv = fopen(argv[2], "w");
+        if (csv == NULL) {
+            fprintf(stderr, "core_bench: can't open %s\n", argv[2]);
+            return 1;
+        }
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: core_bench [--csv <file>]\n");
+        return 1;
+    }
+
+    run_mix();
+    run_storm();
+    run_churn();
+    run_sched();
+    run_edf();
+    run_timer();
+    run_ipc();
+    run_mutex();
+    run_sync();
+    run_syscall();
+    run_pool();
+
+    if (csv != NULL) {
+        fclose(csv);
+    }
+    return failed;
+}
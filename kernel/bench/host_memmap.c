@@ -0,0 +1,27 @@
+#include <stdint.h>
+
+#include "memmap_config.h"
+
+/*
+ * simulated memory map for host builds
+ * on target these come from sprinter.ld, here dtcm and userspace are just big static arrays.
+ * link with -no-pie so they land below 4GB like the real thing would
+ */
+#define HOST_KERNEL_BSS_B       (16 * 1024)     /* stand in for the kernel's .data + .bss */
+#define HOST_KERNEL_STACK_B     0x10000         /* same as _kernel_stack_size in sprinter.ld */
+
+uint8_t _userspace_start[USERSPACE_SIZE_B] __attribute__((aligned(USERSPACE_SIZE_B & -USERSPACE_SIZE_B)));
+uint8_t _dtcm_start[DTCM_SIZE_B] __attribute__((aligned(DTCM_SIZE_B & -DTCM_SIZE_B)));
+
+/*
+ * the rest are addresses, not objects, so they're set the way the linker script does it.
+ * _end is renamed under SPRINTER_HOST (see mem.h), the host linker has its own
+ */
+#define HOST_STR(x)     #x
+#define HOST_SYM(name, value) \
+    __asm__(".globl " #name "\n.set " #name ", " HOST_STR(value))
+
+HOST_SYM(_userspace_end, _userspace_start + USERSPACE_SIZE_B);
+HOST_SYM(_dtcm_end, _dtcm_start + DTCM_SIZE_B);
+HOST_SYM(_host_end, _dtcm_start + HOST_KERNEL_BSS_B);
+HOST_SYM(_kernel_stack_size, HOST_KERNEL_STACK_B);
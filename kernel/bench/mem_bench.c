@@ -0,0 +1,358 @@
+/*
+ * host benchmark for the buddy allocator
+ * runs the same workloads through the bitmap allocator in core/mem.c and the old layer scanning,
+ * subtree marking allocator (kept below as legacy_*), checks they hand out the same addresses
+ * and reports ns per op
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sprinter_common.h"
+#include "mem.h"
+
+#define BENCH_SLOTS       1024
+#define BENCH_MIX_OPS     200000
+#define BENCH_FILL_ROUNDS 200
+#define BENCH_WORST_ROUNDS 20000
+
+/*
+ * the allocator as it was before the free bitmaps, scans whole layers for a free node and marks
+ * every node under an allocated or coalesced block
+ */
+typedef struct legacy_heap {
+    node_state_t state[MEM_BUDDY_MAX_BLOCKS];
+} legacy_heap;
+
+static void legacy_mark(legacy_heap* heap, uint32_t i, node_state_t state) {
+    if (i >= MEM_BUDDY_MAX_BLOCKS) {
+        return;
+    }
+    heap->state[i] = state;
+    legacy_mark(heap, (2 * i) + 1, state);
+    legacy_mark(heap, (2 * i) + 2, state);
+}
+
+static void legacy_init(legacy_heap* heap) {
+    heap->state[0] = NODE_FREE;
+    legacy_mark(heap, 1, NODE_INVALID);
+    legacy_mark(heap, 2, NODE_INVALID);
+}
+
+static address_t legacy_allocate(legacy_heap* heap, uint32_t i, uint32_t layer) {
+    heap->state[i] = NODE_USED;
+    legacy_mark(heap, (2 * i) + 1, NODE_INVALID);
+    legacy_mark(heap, (2 * i) + 2, NODE_INVALID);
+    return USERSPACE_HEAP_START_ADDR + (USERSPACE_HEAP_SIZE >> layer) * (i - ((1u << layer) - 1));
+}
+
+static address_t legacy_malloc(legacy_heap* heap, memsize_t req_size) {
+    if ((req_size == 0) || (req_size > USERSPACE_HEAP_SIZE)) {
+        return _ERR;
+    }
+    memsize_t block = round_up_to_power_of_2(req_size);
+    if (block <= MEM_BUDDY_MIN_BLOCK_SIZE_B) {
+        block = MEM_BUDDY_MIN_BLOCK_SIZE_B;
+    }
+    uint32_t target = (uint32_t)(__builtin_clz(block) - __builtin_clz(USERSPACE_HEAP_SIZE));
+    for (uint32_t i = (1u << target) - 1; i < (1u << (target + 1)) - 1; i++) {
+        if (heap->state[i] == NODE_FREE) {
+            return legacy_allocate(heap, i, target);
+        }
+    }
+    uint32_t layer = target;
+    while (layer > 0) {
+        layer--;
+        for (uint32_t i = (1u << layer) - 1; i < (1u << (layer + 1)) - 1; i++) {
+            if (heap->state[i] == NODE_FREE) {
+                while (layer < target) {
+                    heap->state[i] = NODE_SPLIT;
+                    heap->state[(2 * i) + 1] = NODE_FREE;
+                    heap->state[(2 * i) + 2] = NODE_FREE;
+                    i = (2 * i) + 1;
+                    layer++;
+                }
+                return legacy_allocate(heap, i, target);
+            }
+        }
+    }
+    return _ERR;
+}
+
+static int legacy_free(legacy_heap* heap, address_t target) {
+    address_t offset = target - USERSPACE_HEAP_START_ADDR;
+    memsize_t size = USERSPACE_HEAP_SIZE;
+    uint32_t i = 0;
+    while (heap->state[i] == NODE_SPLIT) {
+        size /= 2;
+        if (offset < size) {
+            i = (2 * i) + 1;
+        } else {
+            offset -= size;
+            i = (2 * i) + 2;
+        }
+    }
+    if ((heap->state[i] != NODE_USED) || (offset != 0)) {
+        return _ERR;
+    }
+    heap->state[i] = NODE_FREE;
+    while (i != 0) {
+        uint32_t parent = (i - 1) / 2;
+        uint32_t sibling = ((i % 2) == 1) ? i + 1 : i - 1;
+        if (heap->state[sibling] != NODE_FREE) {
+            break;
+        }
+        heap->state[i] = NODE_INVALID;
+        heap->state[sibling] = NODE_INVALID;
+        heap->state[parent] = NODE_FREE;
+        i = parent;
+    }
+    return _OK;
+}
+
+/*
+ * workloads, each run against both allocators through these two hooks
+ */
+typedef struct bench_alloc {
+    const char* name;
+    void (*init)(void* heap);
+    address_t (*alloc)(void* heap, memsize_t size);
+    int (*free)(void* heap, address_t addr);
+    void* heap;
+} bench_alloc;
+
+static void bitmap_init(void* heap) { _minit(heap); }
+static address_t bitmap_alloc(void* heap, memsize_t size) { return _malloc(heap, size, 1); }
+static int bitmap_free(void* heap, address_t addr) { return _free(heap, addr); }
+static void scan_init(void* heap) { legacy_init(heap); }
+static address_t scan_alloc(void* heap, memsize_t size) { return legacy_malloc(heap, size); }
+static int scan_free(void* heap, address_t addr) { return legacy_free(heap, addr); }
+
+static heap_manager bitmap_heap;
+static legacy_heap scan_heap;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t xorshift(uint32_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/* fill the heap with 256 B blocks until it fails, then free them all */
+static double run_fill(bench_alloc* a, address_t* log) {
+    static address_t slots[USERSPACE_HEAP_SIZE / MEM_BUDDY_MIN_BLOCK_SIZE_B];
+    uint64_t ops = 0;
+    uint64_t start = now_ns();
+
+    for (int round = 0; round < BENCH_FILL_ROUNDS; round++) {
+        a->init(a->heap);
+        uint32_t n = 0;
+        address_t addr;
+        while ((addr = a->alloc(a->heap, MEM_BUDDY_MIN_BLOCK_SIZE_B)) != (address_t)_ERR) {
+            if (round == 0) {
+                log[n] = addr;
+            }
+            slots[n++] = addr;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            a->free(a->heap, slots[i]);
+        }
+        ops += (2 * n) + 1;
+    }
+
+    return (double)(now_ns() - start) / (double)ops;
+}
+
+/*
+ * random sizes just past the slab classes up to 16 KB, random alloc/free with a fixed seed.
+ * these only touch the buddy tree so placement can be compared
+ */
+static double run_mix(bench_alloc* a, address_t* log) {
+    static address_t slots[BENCH_SLOTS];
+    uint32_t seed = 0x5EED1234;
+    memset(slots, 0, sizeof(slots));
+    a->init(a->heap);
+
+    uint64_t start = now_ns();
+    for (uint32_t op = 0; op < BENCH_MIX_OPS; op++) {
+        uint32_t r = xorshift(&seed);
+        uint32_t slot = r % BENCH_SLOTS;
+        address_t result;
+        if (slots[slot] != 0) {
+            result = (address_t)a->free(a->heap, slots[slot]);
+            slots[slot] = 0;
+        } else {
+            memsize_t size = (xorshift(&seed) >> (18 + (r >> 29))) + SLAB_MAX_OBJ_SIZE_B + 1;
+            result = a->alloc(a->heap, size);
+            if (result != (address_t)_ERR) {
+                slots[slot] = result;
+            }
+        }
+        log[op] = result;
+    }
+
+    return (double)(now_ns() - start) / (double)BENCH_MIX_OPS;
+}
+
+/*
+ * the worst case paths, each timed over a batch since they're deterministic: a 256 KB block
+ * (old allocator marks all 2047 nodes) and a 256 B block out of an empty heap, which splits
+ * every layer on the way down and coalesces every layer on free
+ */
+typedef struct worst_case {
+    double big_pair_ns;
+    double deep_pair_ns;
+} worst_case;
+
+static void run_worst(bench_alloc* a, worst_case* w) {
+    a->init(a->heap);
+
+    uint64_t start = now_ns();
+    for (int round = 0; round < BENCH_WORST_ROUNDS; round++) {
+        a->free(a->heap, a->alloc(a->heap, USERSPACE_HEAP_SIZE));
+    }
+    w->big_pair_ns = (double)(now_ns() - start) / BENCH_WORST_ROUNDS;
+
+    start = now_ns();
+    for (int round = 0; round < BENCH_WORST_ROUNDS; round++) {
+        a->free(a->heap, a->alloc(a->heap, 1));
+    }
+    w->deep_pair_ns = (double)(now_ns() - start) / BENCH_WORST_ROUNDS;
+}
+
+/*
+ * bulk reclaim, four owners interleave 24 B and 256 B - 2 KB allocations until the heap is full, then
+ * each is torn down with _free_all_owned. checks the heap coalesced back to one free block
+ */
+static double run_reclaim(int* ok) {
+    uint64_t ns = 0;
+    uint64_t freed = 0;
+    uint32_t seed = 0xC0FFEE;
+    *ok = 1;
+
+    for (int round = 0; round < BENCH_FILL_ROUNDS; round++) {
+        _minit(&bitmap_heap);
+        tid_t owner = 0;
+        while (_malloc(&bitmap_heap, MEM_BUDDY_MIN_BLOCK_SIZE_B << (xorshift(&seed) & 3), owner) != (address_t)_ERR) {
+            _malloc(&bitmap_heap, 24, owner);
+            owner = (owner + 1) & 3;
+            freed += 2;
+        }
+
+        uint64_t start = now_ns();
+        for (tid_t t = 0; t < 4; t++) {
+            _free_all_owned(&bitmap_heap, t);
+        }
+        ns += now_ns() - start;
+
+        _slab_shrink(&bitmap_heap);
+        address_t whole = _malloc(&bitmap_heap, USERSPACE_HEAP_SIZE, 0);
+        if (whole != USERSPACE_HEAP_START_ADDR) {
+            *ok = 0;
+        }
+    }
+
+    return (double)ns / (double)freed;
+}
+
+/*
+ * small objects, 16 - 64 B: how many fit before the heap runs out, and the cost of churning them
+ */
+static double run_small(bench_alloc* a, uint32_t* fitted) {
+    static address_t slots[USERSPACE_HEAP_SIZE / SLAB_MIN_OBJ_SIZE_B];
+    uint32_t seed = 0xBEEF;
+    uint32_t n = 0;
+    address_t addr;
+
+    a->init(a->heap);
+    while ((addr = a->alloc(a->heap, 32)) != (address_t)_ERR) {
+        slots[n++] = addr;
+    }
+    *fitted = n;
+    for (uint32_t i = 0; i < n; i++) {
+        a->free(a->heap, slots[i]);
+    }
+
+    memset(slots, 0, BENCH_SLOTS * sizeof(address_t));
+    uint64_t start = now_ns();
+    for (uint32_t op = 0; op < BENCH_MIX_OPS; op++) {
+        uint32_t slot = xorshift(&seed) % BENCH_SLOTS;
+        if (slots[slot] != 0) {
+            a->free(a->heap, slots[slot]);
+            slots[slot] = 0;
+        } else {
+            address_t obj = a->alloc(a->heap, SLAB_MIN_OBJ_SIZE_B << (xorshift(&seed) % 3));
+            slots[slot] = (obj == (address_t)_ERR) ? 0 : obj;
+        }
+    }
+
+    return (double)(now_ns() - start) / (double)BENCH_MIX_OPS;
+}
+
+/*
+ * a slab object freed twice has to be turned away, or it goes on being handed out to two owners.
+ * b keeps the slab alive so the second free really does land on it
+ */
+static int run_double_free(void) {
+    _minit(&bitmap_heap);
+    address_t a = _malloc(&bitmap_heap, 24, 1);
+    address_t b = _malloc(&bitmap_heap, 24, 1);
+    int ok = (_free(&bitmap_heap, a) == _OK) && (_free(&bitmap_heap, a) == _ERR);
+
+    address_t c = _malloc(&bitmap_heap, 24, 1);
+    address_t d = _malloc(&bitmap_heap, 24, 1);
+    return ok && (c == a) && (d != a) && (d != b);
+}
+
+int main(void) {
+    bench_alloc allocs[2] = {
+        { "bitmap", bitmap_init, bitmap_alloc, bitmap_free, &bitmap_heap },
+        { "scan",   scan_init,   scan_alloc,   scan_free,   &scan_heap },
+    };
+    static address_t fill_log[2][USERSPACE_HEAP_SIZE / MEM_BUDDY_MIN_BLOCK_SIZE_B];
+    static address_t mix_log[2][BENCH_MIX_OPS];
+    double fill_ns[2];
+    double mix_ns[2];
+    worst_case worst[2];
+    double small_ns[2];
+    uint32_t small_fit[2];
+
+    for (int a = 0; a < 2; a++) {
+        fill_ns[a] = run_fill(&allocs[a], fill_log[a]);
+        mix_ns[a] = run_mix(&allocs[a], mix_log[a]);
+        run_worst(&allocs[a], &worst[a]);
+        small_ns[a] = run_small(&allocs[a], &small_fit[a]);
+    }
+
+    int reclaim_ok;
+    double reclaim_ns = run_reclaim(&reclaim_ok);
+    int double_free_ok = run_double_free();
+
+    int same = (memcmp(fill_log[0], fill_log[1], sizeof(fill_log[0])) == 0) &&
+               (memcmp(mix_log[0], mix_log[1], sizeof(mix_log[0])) == 0);
+
+    printf("%-10s %14s %14s\n", "workload", "bitmap ns/op", "scan ns/op");
+    printf("%-10s %14.1f %14.1f\n", "fill-256", fill_ns[0], fill_ns[1]);
+    printf("%-10s %14.1f %14.1f\n", "mix", mix_ns[0], mix_ns[1]);
+    printf("%-10s %14.1f %14.1f  (alloc+free pair)\n", "256K", worst[0].big_pair_ns, worst[1].big_pair_ns);
+    printf("%-10s %14.1f %14.1f  (alloc+free pair)\n", "deep", worst[0].deep_pair_ns, worst[1].deep_pair_ns);
+    printf("%-10s %14.1f %14.1f\n", "small", small_ns[0], small_ns[1]);
+    printf("%-10s %14u %14u  (32 B objects that fit)\n", "small fit", small_fit[0], small_fit[1]);
+    printf("%-10s %14.1f %14s  (per block, %s)\n", "reclaim", reclaim_ns, "-",
+           reclaim_ok ? "coalesced" : "LEAKED");
+    printf("%-10s %14s\n", "dbl free", double_free_ok ? "rejected" : "ACCEPTED");
+    printf("bound: %d splits per malloc, %d levels down + %d coalesces per free\n",
+           MEM_BUDDY_MAX_LAYER_ID, MEM_BUDDY_MAX_LAYER_ID, MEM_BUDDY_MAX_LAYER_ID);
+    printf("metadata: %zu B bitmap, %zu B scan\n", sizeof(heap_manager), sizeof(legacy_heap));
+    printf("placement %s\n", same ? "identical" : "DIFFERS");
+
+    return (same && reclaim_ok && double_free_ok) ? 0 : 1;
+}
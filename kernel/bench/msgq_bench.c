@@ -0,0 +1,150 @@
+/*
+ * host stress test and throughput benchmark for the message queues
+ * a producer and a consumer thread on one queue, neither side ever takes a lock, so this is
+ * the ring's memory ordering against real concurrency rather than an ISR and a task on one
+ * core. every message carries its sequence number and a payload made from it, the consumer
+ * checks both, one out of order or torn message fails the run. a side that finds the queue
+ * full or empty gives up its time slice, so this still gets through on a single cpu. prints
+ * one result per line:
+ *
+ *   msgq <bench> <metric> <value> <unit>
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sprinter_common.h"
+#include "msgq.h"
+
+#define STRESS_MSGS         4000000u
+#define STRESS_SLOTS        64
+#define BENCH_MSGS          2000000u
+#define BENCH_SLOTS         256
+#define MAX_MSG_B           256
+
+typedef struct bench_run_t {
+    msgq_t queue;
+    memsize_t msg_size;
+    uint32_t msgs;
+    uint32_t errors;
+} bench_run_t;
+
+static uint8_t ring[BENCH_SLOTS * MAX_MSG_B];
+static int failed;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+/* sequence number first, every byte after it follows from it */
+static void fill(uint8_t* msg, memsize_t size, uint32_t seq) {
+    memcpy(msg, &seq, sizeof(seq));
+    for (memsize_t i = sizeof(seq); i < size; i++) {
+        msg[i] = (uint8_t)(seq * 31 + i);
+    }
+}
+
+static int intact(const uint8_t* msg, memsize_t size, uint32_t seq) {
+    uint32_t got;
+    memcpy(&got, msg, sizeof(got));
+    if (got != seq) {
+        return 0;
+    }
+    for (memsize_t i = sizeof(seq); i < size; i++) {
+        if (msg[i] != (uint8_t)(seq * 31 + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * the other side needs the cpu, on a single core spinning would just burn the slice. straight
+ * to the syscall, the kernel's own sched_yield is linked in and hides libc's
+ */
+static void wait_for_other_side(void) {
+    syscall(SYS_sched_yield);
+}
+
+static void* producer(void* arg) {
+    bench_run_t* run = arg;
+    uint8_t msg[MAX_MSG_B];
+
+    for (uint32_t seq = 0; seq < run->msgs; seq++) {
+        fill(msg, run->msg_size, seq);
+        while (msgq_send(&run->queue, msg) == _NOP) {
+            wait_for_other_side();
+        }
+    }
+    return NULL;
+}
+
+static void* consumer(void* arg) {
+    bench_run_t* run = arg;
+    uint8_t msg[MAX_MSG_B];
+
+    for (uint32_t seq = 0; seq < run->msgs; seq++) {
+        while (msgq_recv(&run->queue, msg, false) == _NOP) {
+            wait_for_other_side();
+        }
+        if (!intact(msg, run->msg_size, seq)) {
+            run->errors++;
+        }
+    }
+    return NULL;
+}
+
+static void result(const char* bench, const char* metric, double value, const char* unit) {
+    printf("msgq   %-10s %-16s %14.1f %s\n", bench, metric, value, unit);
+}
+
+static void run(const char* bench, memsize_t msg_size, uint32_t slots, uint32_t msgs) {
+    static bench_run_t r;
+    pthread_t prod;
+    pthread_t cons;
+
+    memset(&r, 0, sizeof(r));
+    r.msg_size = msg_size;
+    r.msgs = msgs;
+    if (msgq_init(&r.queue, ring, msg_size, slots) != _OK) {
+        fprintf(stderr, "msgq_bench: %s init failed\n", bench);
+        failed = 1;
+        return;
+    }
+
+    uint64_t start = now_ns();
+    pthread_create(&cons, NULL, consumer, &r);
+    pthread_create(&prod, NULL, producer, &r);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    uint64_t elapsed = now_ns() - start;
+
+    msgq_stats_t stats;
+    msgq_stats(&r.queue, &stats);
+    if (r.errors != 0 || stats.sent != msgs || stats.received != msgs || msgq_count(&r.queue) != 0) {
+        fprintf(stderr, "msgq_bench: %s %u torn or out of order, sent %u received %u\n",
+                bench, (unsigned)r.errors, (unsigned)stats.sent, (unsigned)stats.received);
+        failed = 1;
+    }
+
+    result(bench, "throughput", (double)msgs * 1e9 / (double)elapsed, "msgs/s");
+    result(bench, "bandwidth", (double)msgs * msg_size * 1e3 / (double)elapsed, "MB/s");
+    result(bench, "full", 100.0 * stats.full / (stats.full + msgs), "% of sends");
+    result(bench, "high_water", stats.high_water, "msgs");
+}
+
+int main(void) {
+    run("stress", 16, STRESS_SLOTS, STRESS_MSGS);
+    run("msg_4", 4, BENCH_SLOTS, BENCH_MSGS);
+    run("msg_16", 16, BENCH_SLOTS, BENCH_MSGS);
+    run("msg_64", 64, BENCH_SLOTS, BENCH_MSGS);
+    run("msg_256", 256, BENCH_SLOTS, BENCH_MSGS);
+
+    return failed;
+}
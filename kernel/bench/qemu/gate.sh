@@ -0,0 +1,65 @@
+#!/bin/sh
+#  ******************************************************************************
+#  @file           : gate.sh
+#  @author         : Steven Mu
+#  @summary		   : Compares "@bench <name> <ops> <cycles>" lines from a qemu run against
+#                    a baseline, fails if any benchmark got slower than tolerance percent
+#                    or went missing
+#
+#  usage: gate.sh <results> <baseline> <tolerance %>
+#         gate.sh --record <results> <baseline>
+#  ******************************************************************************
+
+record=0
+if [ "$1" = "--record" ]; then
+    record=1
+    shift
+fi
+
+results=$1
+baseline=$2
+tolerance=$3
+
+# a run that failed a check isn't compared, and never becomes the baseline
+if grep -q '^@fail ' "$results"; then
+    grep '^@fail ' "$results"
+    exit 1
+fi
+
+if ! grep -q '^@bench ' "$results"; then
+    echo "gate: no @bench lines in $results"
+    exit 1
+fi
+
+if [ $record -eq 1 ]; then
+    grep '^@bench ' "$results" > "$baseline"
+    echo "gate: recorded $baseline"
+    exit 0
+fi
+
+# nothing to compare against isn't a pass
+if [ ! -f "$baseline" ]; then
+    echo "gate: no $baseline, record one with make qemu-baseline"
+    exit 1
+fi
+
+grep '^@bench ' "$results" | awk -v tolerance="$tolerance" '
+    FNR == NR { base[$2] = $4; next }
+    { now[$2] = $4 }
+    END {
+        status = 0
+        for (name in base) {
+            if (!(name in now)) {
+                printf "gate: %-14s missing\n", name
+                status = 1
+                continue
+            }
+            limit = base[name] * (100 + tolerance) / 100
+            verdict = (now[name] > limit) ? "REGRESSED" : "ok"
+            if (now[name] > limit) {
+                status = 1
+            }
+            printf "gate: %-14s %10d -> %10d  %s\n", name, base[name], now[name], verdict
+        }
+        exit status
+    }' "$baseline" -
@@ -0,0 +1,74 @@
+#  ******************************************************************************
+#  @file           : qemu.mk
+#  @author         : Steven Mu
+#  @summary		   : Kernel image for qemu's mps2-an500 (cortex-m7) with the benchmark
+#                    payload, and a regression gate over its cycle counts
+#  ******************************************************************************
+
+QEMU            := qemu-system-arm
+QEMU_DIR        := bench/qemu
+QEMU_BUILD_DIR  := build/qemu
+QEMU_OBJ_DIR    := $(QEMU_BUILD_DIR)/obj
+QEMU_MEMMAP_DIR := ../memmap/qemu
+
+QEMU_ELF      := $(QEMU_BUILD_DIR)/$(TARGET).elf
+QEMU_MAP      := $(QEMU_BUILD_DIR)/$(TARGET).map
+QEMU_MEMMAP   := $(QEMU_BUILD_DIR)/memmap.ld
+QEMU_RESULTS  := $(QEMU_BUILD_DIR)/results.txt
+QEMU_BASELINE := $(QEMU_DIR)/baseline.txt
+
+# percent a benchmark may get slower than the baseline before the gate fails
+QEMU_TOLERANCE ?= 5
+# -icount makes qemu's clock follow the instruction count so every run measures the same
+QEMU_ICOUNT    ?= 0
+QEMU_TIMEOUT   ?= 60
+
+# no tick, the systick is the cycle counter here (see qemu_bench.c) and switches are yields
+QEMU_DEFS     := -DSPRINTER_QEMU -DSPRINTER_BENCH -DSCHED_TICK_HZ=0
+QEMU_INCLUDES := -I$(QEMU_MEMMAP_DIR) $(INCLUDES) -I$(QEMU_DIR)
+QEMU_LDFLAGS  := $(MCUFLAGS) -T $(LDSCRIPT) -L $(QEMU_BUILD_DIR) \
+                 --specs=nano.specs --specs=nosys.specs \
+                 -Wl,--gc-sections -Wl,-Map=$(QEMU_MAP) -Wl,--print-memory-usage \
+                 -Wl,--start-group -lc -lm -lnosys -Wl,--end-group
+QEMU_FLAGS    := -M mps2-an500 -nographic -monitor none -serial null \
+                 -semihosting-config enable=on,target=native -icount shift=$(QEMU_ICOUNT)
+
+QEMU_C_SRCS := $(C_SRCS) $(QEMU_DIR)/qemu_bench.c
+QEMU_OBJS := \
+$(patsubst %.c, $(QEMU_OBJ_DIR)/%.o, $(QEMU_C_SRCS)) \
+$(patsubst %.s, $(QEMU_OBJ_DIR)/%.o, $(S_SRCS))
+
+$(QEMU_OBJ_DIR)/%.o: %.c
+	@mkdir -p $(dir $@)
+	$(COMPILER) $(MCUFLAGS) $(DEFS) $(QEMU_DEFS) $(QEMU_INCLUDES) $(CFLAGS) -MMD -MP -c $< -o $@
+
+$(QEMU_OBJ_DIR)/%.o: %.s
+	@mkdir -p $(dir $@)
+	$(COMPILER) $(MCUFLAGS) $(DEFS) -c $< -o $@
+
+# preprocessed from a copy, next to the original it would always pick up ../memmap_config.h
+$(QEMU_MEMMAP): $(MEMMAP_DIR)/memmap.ld.in $(QEMU_MEMMAP_DIR)/memmap_config.h
+	@mkdir -p $(dir $@)
+	@cp $< $(QEMU_BUILD_DIR)/memmap.ld.in
+	$(COMPILER) -E -P -x c -I $(QEMU_MEMMAP_DIR) $(QEMU_BUILD_DIR)/memmap.ld.in -o $@
+
+$(QEMU_ELF): $(QEMU_OBJS) $(QEMU_MEMMAP)
+	$(COMPILER) $(MCUFLAGS) $(QEMU_OBJS) $(QEMU_LDFLAGS) -o $@
+
+# "make qemu-bench" runs the payload and fails on any regression past QEMU_TOLERANCE percent,
+# or when there's no baseline to compare with. "make qemu-baseline" records the current numbers
+# as the new baseline, a run that failed a check is refused
+.PHONY: qemu-bench qemu-baseline qemu-run
+
+qemu-run: $(QEMU_ELF)
+	timeout $(QEMU_TIMEOUT) $(QEMU) $(QEMU_FLAGS) -kernel $< > $(QEMU_RESULTS) 2>&1; \
+	    status=$$?; cat $(QEMU_RESULTS); \
+	    test $$status -eq 0 || { echo "qemu exited with $$status"; exit 1; }
+
+qemu-bench: qemu-run
+	sh $(QEMU_DIR)/gate.sh $(QEMU_RESULTS) $(QEMU_BASELINE) $(QEMU_TOLERANCE)
+
+qemu-baseline: qemu-run
+	sh $(QEMU_DIR)/gate.sh --record $(QEMU_RESULTS) $(QEMU_BASELINE)
+
+-include $(QEMU_OBJS:.o=.d)
@@ -0,0 +1,485 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/cortex.h"
+#include "core/kmem.h"
+#include "core/kobj.h"
+#include "core/mem.h"
+#include "core/mpu.h"
+#include "core/msgq.h"
+#include "core/mutex.h"
+#include "core/sched.h"
+#include "core/sem.h"
+#include "core/sprinter_common.h"
+#include "core/stack.h"
+#include "core/syscall.h"
+#include "core/tcb.h"
+#include "core/tcb_buf.h"
+#include "drivers/semihost.h"
+#include "drivers/uart.h"
+#include "qemu_bench.h"
+
+#define BENCH_OPS           1000
+#define BENCH_SLOTS         64
+
+/*
+ * cycle counter
+ * on hardware this is the dwt cycle counter. qemu doesn't model the dwt, so there systick
+ * free runs off the core clock instead, and with -icount the count is the same on every run.
+ * either way a measurement has to stay under 2^24 counts
+ */
+#if defined(SPRINTER_QEMU)
+static inline uint32_t cycles_now(void) {
+    return SYSTICK_MAX_RELOAD - SYSTICK->VAL;
+}
+
+static inline uint32_t cycles_since(uint32_t start) {
+    return (cycles_now() - start) & SYSTICK_MAX_RELOAD;
+}
+#else
+static inline uint32_t cycles_now(void) {
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t cycles_since(uint32_t start) {
+    return DWT->CYCCNT - start;
+}
+#endif
+
+/* overrides the weak one in startup_sprinter.s, .bss isn't zeroed yet so registers only */
+void _early_init(void) {
+#if defined(SPRINTER_QEMU)
+    SYSTICK->LOAD = SYSTICK_MAX_RELOAD;
+    SYSTICK->VAL = 0;
+    SYSTICK->CTRL = SYSTICK_CTRL_CLKSOURCE | SYSTICK_CTRL_ENABLE;
+#else
+    DEMCR |= DEMCR_TRCENA;
+    DWT_LAR = DWT_LAR_KEY;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA;
+#endif
+}
+
+static uint32_t boot_cycles;
+static int failed;
+
+/* counter started at reset, so whatever it reads now is reset to _main */
+void bench_boot_mark(void) {
+    boot_cycles = cycles_now();
+}
+
+static void report(char* name, uint32_t ops, uint32_t cycles) {
+    uart_out("@bench %s %d %d", name, (int)ops, (int)cycles);
+}
+
+static void check(int ok, char* what) {
+    if (!ok) {
+        uart_out("@fail %s", what);
+        failed = 1;
+    }
+}
+
+static uint32_t xorshift(uint32_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+/*
+ * workloads
+ */
+static void bench_pair(heap_manager* heap_mgr, char* name, memsize_t size) {
+    _minit(heap_mgr);
+
+    uint32_t start = cycles_now();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        _free(heap_mgr, _malloc(heap_mgr, size, 1));
+    }
+    report(name, BENCH_OPS, cycles_since(start));
+
+    mem_stats_t stats;
+    _mstats(heap_mgr, &stats);
+    check(stats.allocs == BENCH_OPS && stats.frees == BENCH_OPS, name);
+}
+
+static void bench_mix(heap_manager* heap_mgr) {
+    static address_t slots[BENCH_SLOTS];
+    uint32_t seed = 0x5EED1234;
+
+    _minit(heap_mgr);
+    for (uint32_t i = 0; i < BENCH_SLOTS; i++) {
+        slots[i] = 0;
+    }
+
+    uint32_t start = cycles_now();
+    for (uint32_t op = 0; op < BENCH_OPS; op++) {
+        uint32_t r = xorshift(&seed);
+        uint32_t slot = r % BENCH_SLOTS;
+        if (slots[slot] != 0) {
+            _free(heap_mgr, slots[slot]);
+            slots[slot] = 0;
+        } else {
+            address_t addr = _malloc(heap_mgr, 16 + (xorshift(&seed) >> (20 + (r >> 30))), slot % MAX_TASKS);
+            slots[slot] = (addr == (address_t)_ERR) ? 0 : addr;
+        }
+    }
+    report("mix", BENCH_OPS, cycles_since(start));
+}
+
+/* stand in for root, SCHED_TICK_HZ is 0 in this image so it has to give the cpu up itself */
+static void idle_task(void* args) {
+    (void)args;
+    while (1) {
+        sched_yield();
+    }
+}
+
+static void bench_churn(heap_manager* heap_mgr, taskbuff_t* tasks) {
+    uint32_t seed = 0xC0FFEE;
+
+    _minit(heap_mgr);
+    while (create_task(tasks, idle_task, NULL, SCHED_PRIO_IDLE, STACK_SIZE, 0) == _OK) {
+    }
+
+    uint32_t start = cycles_now();
+    for (uint32_t op = 0; op < BENCH_OPS; op++) {
+        tid_t tid = 1 + (xorshift(&seed) % (MAX_TASKS - 1));
+        _malloc(heap_mgr, 64, tid);
+        remove_task(tasks, tid);
+        create_task(tasks, idle_task, NULL, SCHED_PRIO_IDLE, STACK_SIZE, 0);
+    }
+    report("task_churn", BENCH_OPS, cycles_since(start));
+    check(tasks->tasks_in_buf == MAX_TASKS, "task_churn");
+
+    for (tid_t t = 1; t < MAX_TASKS; t++) {
+        remove_task(tasks, t);
+    }
+}
+
+static void bench_pool(kmem_arena_t* kernel_mem) {
+    static kmem_pool_t pool;
+    if (_kpool_init(kernel_mem, &pool, "bench", sizeof(tcb_t), 1, 1) != _OK) {
+        check(0, "kpool");
+        return;
+    }
+
+    uint32_t start = cycles_now();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        _kpool_free(&pool, _kpool_alloc(&pool));
+    }
+    report("kpool_pair", BENCH_OPS, cycles_since(start));
+}
+
+/* what PendSV adds per switch to swap the task's stack, grant and guard regions */
+static void bench_mpu(taskbuff_t* tasks) {
+    volatile tcb_t* task = &tasks->buffer[0];
+
+    uint32_t start = cycles_now();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        mpu_load(task);
+    }
+    report("mpu_load", BENCH_OPS, cycles_since(start));
+}
+
+/*
+ * context switch, two tasks and the idle one yielding round robin. every yield is a full
+ * PendSV switch, the cost includes picking the next task
+ *
+ * runs twice, first with tasks that never touch the fpu and then with two that do a float op
+ * between yields, so their switches carry s16-s31 and the lazily stacked s0-s15. the idle
+ * task stays integer only in both
+ */
+#define SWITCH_MEASURE      (1u << 0)
+#define SWITCH_FPU          (1u << 1)
+
+static uint32_t switch_start;
+static uint32_t switches_start;
+static taskbuff_t* switch_tasks;
+
+static int switch_pair(uint32_t flags);
+
+/* runs off the bottom of its stack, the guard should catch it and get it removed */
+static void overflow_task(void* args) {
+    (void)args;
+    volatile uint8_t* p = (volatile uint8_t*)__builtin_frame_address(0);
+    while (1) {
+        *(--p) = 0;
+    }
+}
+
+/* from a task, the overflowing one outranks it so it's done by the time create_task returns */
+static void check_guard(void) {
+    mpu_fault_t before;
+    mpu_fault_t after;
+
+    mpu_fault_stats(&before);
+    uint32_t in_buf = switch_tasks->tasks_in_buf;
+    if (create_task(switch_tasks, overflow_task, NULL, SCHED_PRIO_IDLE + 1, STACK_CHUNK_B, 0) != _OK) {
+        check(0, "mpu_guard");
+        return;
+    }
+    mpu_fault_stats(&after);
+    check(after.faults == before.faults + 1 && after.overflow && switch_tasks->tasks_in_buf == in_buf, "mpu_guard");
+}
+
+/* every yield in the pair was a switch in and a voluntary one out, cycles are 0 under qemu */
+static void check_top(void) {
+    static task_cpu_t top[MAX_TASKS];
+    uint32_t count = 0;
+    int ok = 0;
+
+    if (task_cpu_top(switch_tasks, top, MAX_TASKS, &count) == _OK) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (top[i].tid == scheduler.current->tid) {
+                ok = top[i].switches >= BENCH_OPS && top[i].voluntary >= BENCH_OPS;
+            }
+        }
+    }
+    check(ok, "cpu_top");
+}
+
+/*
+ * a receiver above the sending task blocks on an empty queue, every send wakes it, it takes
+ * the message and blocks again. a round trip is a wakeup and two switches
+ */
+static msgq_t wake_queue;
+static uint32_t wake_slots[BENCH_SLOTS];
+
+static void receiver_task(void* args) {
+    (void)args;
+    uint32_t msg;
+
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        msgq_recv(&wake_queue, &msg, true);
+    }
+}
+
+static void bench_msgq_wake(void) {
+    msgq_init(&wake_queue, wake_slots, sizeof(uint32_t), BENCH_SLOTS);
+    if (create_task(switch_tasks, receiver_task, NULL, SCHED_PRIO_IDLE + 1, STACK_CHUNK_B, 0) != _OK) {
+        check(0, "msgq_wake");
+        return;
+    }
+
+    uint32_t start = cycles_now();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        msgq_send(&wake_queue, &i);
+    }
+    report("msgq_wake", BENCH_OPS, cycles_since(start));
+    check(wake_queue.stats.received == BENCH_OPS && wake_queue.stats.blocked >= BENCH_OPS, "msgq_wake");
+}
+
+/*
+ * a waiter above the measuring task blocks on a semaphore and every give wakes it through
+ * PendSV's deferred work, the way an ISR's would. it adds up the cycles from the give to it
+ * running again
+ */
+static sem_t wake_sem;
+static uint32_t sem_gave;
+static uint32_t sem_cycles;
+
+static void sem_waiter_task(void* args) {
+    (void)args;
+
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        sem_take(&wake_sem, SCHED_WAIT_FOREVER);
+        sem_cycles += cycles_since(sem_gave);
+    }
+}
+
+static void bench_sem_wake(void) {
+    sem_init(&wake_sem, 0, 1);
+    if (create_task(switch_tasks, sem_waiter_task, NULL, SCHED_PRIO_IDLE + 1, STACK_CHUNK_B, 0) != _OK) {
+        check(0, "sem_wake");
+        return;
+    }
+
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        sem_gave = cycles_now();
+        sem_give(&wake_sem);
+    }
+    report("sem_wake", BENCH_OPS, sem_cycles);
+    check(wake_sem.stats.woken == BENCH_OPS && sem_count(&wake_sem) == 0, "sem_wake");
+}
+
+/*
+ * the measuring task holds a mutex and wakes a waiter above it, which blocks on it and lends
+ * its priority. giving it back hands it over and drops the measuring task back, the waiter
+ * gives it back in turn and suspends itself. a round is two switches and a handover
+ */
+static mutex_t handoff_mutex;
+static uint32_t handoff_boosted;
+
+static void waiter_task(void* args) {
+    (void)args;
+
+    while (1) {
+        mutex_lock(&handoff_mutex, SCHED_WAIT_FOREVER);
+        mutex_unlock(&handoff_mutex);
+        suspend_task(switch_tasks, scheduler.current->tid);
+    }
+}
+
+static void bench_mutex_handoff(void) {
+    volatile tcb_t* self = scheduler.current;
+
+    mutex_init(&handoff_mutex);
+    if (create_task(switch_tasks, waiter_task, NULL, self->priority + 2, STACK_CHUNK_B, 0) != _OK) {
+        check(0, "mutex_handoff");
+        return;
+    }
+
+    /* the waiter ran straight away and is suspended again, it's the last task made */
+    tid_t waiter = 0;
+    for (tid_t t = 0; t < MAX_TASKS; t++) {
+        if (switch_tasks->buffer[t].ptask == waiter_task && switch_tasks->buffer[t].status == STATUS_SUSPENDED) {
+            waiter = t;
+        }
+    }
+
+    uint32_t start = cycles_now();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        mutex_lock(&handoff_mutex, SCHED_WAIT_FOREVER);
+        run_task(switch_tasks, waiter);
+        if (self->priority == self->base_priority + 2) {
+            handoff_boosted++;
+        }
+        mutex_unlock(&handoff_mutex);
+    }
+    report("mutex_handoff", BENCH_OPS, cycles_since(start));
+    check(handoff_boosted == BENCH_OPS && self->priority == self->base_priority &&
+          handoff_mutex.stats.contended == BENCH_OPS && handoff_mutex.owner == 0, "mutex_handoff");
+    remove_task(switch_tasks, waiter);
+}
+
+/*
+ * null system call round trips from the measuring task, svc entry, dispatch and the exception
+ * return. then an unprivileged task above it blocks in a sem_take call, is woken through its
+ * frame, signals back through another call and returns into sys_exit
+ */
+static kobj_t syscall_wake;
+static kobj_t syscall_done;
+
+static void user_task(void* args) {
+    (void)args;
+
+    if (sys_sem_take(syscall_wake, SCHED_WAIT_FOREVER) == _OK) {
+        sys_sem_give(syscall_done);
+    }
+}
+
+static void bench_syscall(void) {
+    tid_t self = scheduler.current->tid;
+    uint32_t ok = 0;
+
+    uint32_t start = cycles_now();
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        ok += (sys_task_id() == self);
+    }
+    report("syscall_null", BENCH_OPS, cycles_since(start));
+    check(ok == BENCH_OPS, "syscall_null");
+
+    syscall_wake = kobj_new(KOBJ_SEM);
+    syscall_done = kobj_new(KOBJ_SEM);
+    sem_t* wake = kobj_get(syscall_wake, KOBJ_SEM);
+    sem_t* done = kobj_get(syscall_done, KOBJ_SEM);
+    if (wake == NULL || done == NULL) {
+        check(0, "syscall_user");
+        return;
+    }
+    sem_init(wake, 0, 1);
+    sem_init(done, 0, 1);
+    syscall_stats_t before;
+    syscall_stats_t after;
+    syscall_stats(SYS_EXIT, &before);
+    if (create_task(switch_tasks, user_task, NULL, scheduler.current->priority + 1, STACK_CHUNK_B,
+                    TASK_UNPRIVILEGED) != _OK) {
+        check(0, "syscall_user");
+        return;
+    }
+
+    /* it's blocked in the call by now, the give wakes it and it's gone again before this returns */
+    sem_give(wake);
+    syscall_stats(SYS_EXIT, &after);
+    check(sem_take(done, 0) == _OK && after.calls == before.calls + 1, "syscall_user");
+    kobj_delete(syscall_wake);
+    kobj_delete(syscall_done);
+}
+
+static void switch_task(void* args) {
+    uint32_t flags = (uint32_t)(address_t)args;
+    volatile float acc = 1.0f;
+
+    for (uint32_t i = 0; i < BENCH_OPS; i++) {
+        if (flags & SWITCH_FPU) {
+            acc = (acc * 1.0001f) + 0.5f;
+        }
+        sched_yield();
+    }
+    if (!(flags & SWITCH_MEASURE)) {
+        return;
+    }
+
+    uint32_t cycles = cycles_since(switch_start);
+    if (!(flags & SWITCH_FPU)) {
+        report("yield_switch", scheduler.switches - switches_start, cycles);
+
+        /* the fpu pair takes over once this one returns */
+        check(switch_pair(SWITCH_FPU) == _OK, "yield_switch_fpu");
+        return;
+    }
+    report("yield_switch_fpu", scheduler.switches - switches_start, cycles);
+    check_top();
+    bench_msgq_wake();
+    bench_mutex_handoff();
+    bench_sem_wake();
+    bench_syscall();
+    check_guard();
+    check(scheduler.current->fpu_used, "fpu_used");
+
+    uart_out("@done");
+    semihost_call(SEMIHOST_SYS_EXIT, (void*)(failed ? SEMIHOST_ADP_RUNTIME_ERROR : SEMIHOST_ADP_APPLICATION_EXIT));
+}
+
+static int switch_pair(uint32_t flags) {
+    if (create_task(switch_tasks, switch_task, (void*)(address_t)flags, SCHED_PRIO_IDLE, STACK_SIZE, 0) != _OK ||
+        create_task(switch_tasks, switch_task, (void*)(address_t)(flags | SWITCH_MEASURE), SCHED_PRIO_IDLE, STACK_SIZE, 0) != _OK) {
+        return _ERR;
+    }
+
+    switches_start = scheduler.switches;
+    switch_start = cycles_now();
+    return _OK;
+}
+
+static void bench_switch(taskbuff_t* tasks) {
+    /* tid 0 is still the idle task from the churn bench */
+    switch_tasks = tasks;
+    if (switch_pair(0) != _OK) {
+        check(0, "yield_switch");
+        return;
+    }
+
+    sched_start();
+}
+
+void kernel_bench(heap_manager* heap_mgr, kmem_arena_t* kernel_mem, taskbuff_t* tasks) {
+    report("boot_to_main", 1, boot_cycles);
+
+    bench_pair(heap_mgr, "malloc_24", 24);
+    bench_pair(heap_mgr, "malloc_1k", 1024);
+    bench_pair(heap_mgr, "malloc_whole", USERSPACE_HEAP_SIZE - (2 * MEM_BLOCK_OVERHEAD_B));
+    bench_mix(heap_mgr);
+    bench_churn(heap_mgr, tasks);
+    bench_pool(kernel_mem);
+    bench_mpu(tasks);
+
+    /* last since it never comes back, the measuring task exits qemu */
+    bench_switch(tasks);
+
+    uart_out("@done");
+    semihost_call(SEMIHOST_SYS_EXIT, (void*)SEMIHOST_ADP_RUNTIME_ERROR);
+    while (1) {
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef __QEMU_BENCH_H__
+#define __QEMU_BENCH_H__
+
+#include "core/kmem.h"
+#include "core/mem.h"
+#include "core/tcb_buf.h"
+
+/*
+ * benchmark payload, linked into the kernel image by "make qemu-bench" (SPRINTER_BENCH).
+ * _main calls bench_boot_mark first thing and hands over to kernel_bench once the heaps, the
+ * task buffer and the scheduler are up, which measures, prints "@bench <name> <ops> <cycles>"
+ * lines and exits through semihosting instead of starting root
+ */
+void bench_boot_mark(void);
+void kernel_bench(heap_manager* heap_mgr, kmem_arena_t* kernel_mem, taskbuff_t* tasks);
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * host allocation trace replayer
+ * built once per allocator (MEM_ALLOCATOR), replays traces recorded with MEM_TRACE=1 and
+ * reports failures, internal fragmentation at the peak and per op latency
+ *
+ * a trace is the raw uart log, only lines like these are looked at, addresses are just ids
+ *   @a 0x20020100 24 3       (allocated 24 B for tid 3)
+ *   @f 0x20020100
+ *
+ * trace_bench --synth <seed> prints a synthetic trace in the same format
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sprinter_common.h"
+#include "mem.h"
+
+#if defined(MEM_USE_TLSF)
+#define ALLOCATOR_NAME "tlsf"
+#else
+#define ALLOCATOR_NAME "buddy"
+#endif
+
+#define TRACE_MAP_SIZE      16384           /* live block ids, power of two */
+#define TRACE_MAX_OPS       (1 << 20)
+#define SYNTH_OPS           100000
+#define SYNTH_LIVE          160
+
+static heap_manager heap;
+
+/*
+ * recorded id -> replayed address, open addressing with tombstones
+ */
+typedef struct trace_entry {
+    uint64_t id;            /* 0 empty, 1 tombstone */
+    address_t addr;
+    memsize_t req_size;
+} trace_entry;
+
+static trace_entry live[TRACE_MAP_SIZE];
+
+static trace_entry* lookup(uint64_t id, int insert) {
+    uint32_t h = (uint32_t)((id * 0x9E3779B97F4A7C15ull) >> 40) & (TRACE_MAP_SIZE - 1);
+    trace_entry* tomb = NULL;
+
+    for (uint32_t probe = 0; probe < TRACE_MAP_SIZE; probe++) {
+        trace_entry* e = &live[(h + probe) & (TRACE_MAP_SIZE - 1)];
+        if (e->id == id) {
+            return e;
+        }
+        if (e->id == 1 && tomb == NULL) {
+            tomb = e;
+        }
+        if (e->id == 0) {
+            return insert ? ((tomb != NULL) ? tomb : e) : NULL;
+        }
+    }
+
+    return insert ? tomb : NULL;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct trace_result {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint64_t peak_consumed;
+    uint64_t requested_at_peak;
+    uint32_t n_alloc_ns;
+    uint32_t n_free_ns;
+} trace_result;
+
+static uint32_t alloc_ns[TRACE_MAX_OPS];
+static uint32_t free_ns[TRACE_MAX_OPS];
+
+static int replay(FILE* trace, trace_result* r) {
+    char line[128];
+    uint64_t requested = 0;
+    uint64_t consumed = 0;
+
+    memset(r, 0, sizeof(*r));
+    memset(live, 0, sizeof(live));
+    _minit(&heap);
+
+    while (fgets(line, sizeof(line), trace) != NULL) {
+        unsigned long long id;
+        unsigned size;
+        unsigned tid;
+
+        if (sscanf(line, "@a %llx %u %u", &id, &size, &tid) == 3) {
+            id += 2;
+            uint64_t start = now_ns();
+            address_t addr = _malloc(&heap, size, tid);
+            uint64_t ns = now_ns() - start;
+            if (r->n_alloc_ns < TRACE_MAX_OPS) {
+                alloc_ns[r->n_alloc_ns++] = (uint32_t)ns;
+            }
+
+            r->allocs++;
+            if (addr == (address_t)_ERR) {
+                r->failures++;
+                continue;
+            }
+
+            trace_entry* e = lookup(id, 1);
+            if (e == NULL) {
+                fprintf(stderr, "trace_bench: more than %d live blocks\n", TRACE_MAP_SIZE);
+                return 1;
+            }
+            e->id = id;
+            e->addr = addr;
+            e->req_size = size;
+
+            requested += size;
+            consumed += _msize(&heap, addr) + MEM_BLOCK_OVERHEAD_B;
+            if (consumed > r->peak_consumed) {
+                r->peak_consumed = consumed;
+                r->requested_at_peak = requested;
+            }
+        } else if (sscanf(line, "@f %llx", &id) == 1) {
+            id += 2;
+            trace_entry* e = lookup(id, 0);
+            if (e == NULL) {
+                /* the matching alloc failed in this replay */
+                continue;
+            }
+
+            requested -= e->req_size;
+            consumed -= _msize(&heap, e->addr) + MEM_BLOCK_OVERHEAD_B;
+
+            uint64_t start = now_ns();
+            _free(&heap, e->addr);
+            uint64_t ns = now_ns() - start;
+            if (r->n_free_ns < TRACE_MAX_OPS) {
+                free_ns[r->n_free_ns++] = (uint32_t)ns;
+            }
+
+            r->frees++;
+            e->id = 1;
+        }
+    }
+
+    return 0;
+}
+
+static void report(const char* name, trace_result* r) {
+    qsort(alloc_ns, r->n_alloc_ns, sizeof(uint32_t), cmp_u32);
+    qsort(free_ns, r->n_free_ns, sizeof(uint32_t), cmp_u32);
+
+    double waste = (r->peak_consumed == 0) ? 0.0 :
+                   100.0 * (1.0 - ((double)r->requested_at_peak / (double)r->peak_consumed));
+    uint32_t a50 = r->n_alloc_ns ? alloc_ns[r->n_alloc_ns / 2] : 0;
+    uint32_t a99 = r->n_alloc_ns ? alloc_ns[(r->n_alloc_ns * 99) / 100] : 0;
+    uint32_t f50 = r->n_free_ns ? free_ns[r->n_free_ns / 2] : 0;
+    uint32_t f99 = r->n_free_ns ? free_ns[(r->n_free_ns * 99) / 100] : 0;
+
+    printf("%-6s %-24s allocs %7u failed %6u peak %7llu B waste %5.1f%%  "
+           "alloc p50/p99 %4u/%5u ns  free p50/p99 %4u/%5u ns\n",
+           ALLOCATOR_NAME, name, r->allocs, r->failures, (unsigned long long)r->peak_consumed,
+           waste, a50, a99, f50, f99);
+}
+
+/*
+ * synthetic trace: a live set of mixed objects, small messages, 1-2 KB descriptors and
+ * just-over-a-power-of-two sensor frames, randomly replaced
+ */
+static uint32_t xorshift(uint32_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static void synth(uint32_t seed) {
+    static uint32_t ids[SYNTH_LIVE];
+    uint32_t next_id = 0x100;
+
+    for (uint32_t op = 0; op < SYNTH_OPS; op++) {
+        uint32_t slot = xorshift(&seed) % SYNTH_LIVE;
+        if (ids[slot] != 0) {
+            printf("@f 0x%08X\n", ids[slot]);
+        }
+
+        uint32_t kind = xorshift(&seed) % 100;
+        uint32_t size;
+        if (kind < 60) {
+            size = 16 + (xorshift(&seed) % 49);                 /* messages, 16-64 B */
+        } else if (kind < 90) {
+            size = 1024 + (xorshift(&seed) % 1025);             /* descriptors, 1-2 KB */
+        } else {
+            size = 4096 + 100 + (xorshift(&seed) % 200);        /* sensor frames, ~4.1 KB */
+        }
+
+        ids[slot] = next_id;
+        next_id += 8;
+        printf("@a 0x%08X %u %u\n", ids[slot], size, slot % MAX_TASKS);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && strcmp(argv[1], "--synth") == 0) {
+        synth((uint32_t)strtoul(argv[2], NULL, 0));
+        return 0;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: trace_bench <trace>... | trace_bench --synth <seed>\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        FILE* trace = fopen(argv[i], "r");
+        if (trace == NULL) {
+            fprintf(stderr, "trace_bench: can't open %s\n", argv[i]);
+            return 1;
+        }
+
+        trace_result r;
+        int err = replay(trace, &r);
+        fclose(trace);
+        if (err) {
+            return err;
+        }
+
+        const char* name = strrchr(argv[i], '/');
+        report((name != NULL) ? name + 1 : argv[i], &r);
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef __CORTEX_H__
+#define __CORTEX_H__
+
+#include <stdint.h>
+
+/*
+ * cortex-m7 core peripherals, these sit in the system control space and are the same on
+ * every m7 part (stm32 or otherwise)
+ */
+
+/* system control block */
+struct scb {
+	volatile uint32_t CPUID, ICSR, VTOR, AIRCR, SCR, CCR, SHPR1, SHPR2, SHPR3, SHCSR,
+	                  CFSR, HFSR, DFSR, MMFAR, BFAR, AFSR;
+};
+#define SCB ((struct scb *) 0xE000ED00)
+
+#define SCB_ICSR_PENDSVSET          (1u << 28)
+#define SCB_ICSR_PENDSTSET          (1u << 26)    /* SysTick is pending */
+#define SCB_ICSR_RETTOBASE          (1u << 11)    /* the active exception is the only one */
+#define SCB_SHCSR_MEMFAULTENA       (1u << 16)    /* memmanage faults get their own handler */
+#define SCB_CFSR_MMFSR_MASK         0xFFu         /* memmanage status, write 1 to clear */
+#define SCB_CFSR_MSTKERR            (1u << 4)     /* fault while stacking for an exception */
+#define SCB_CFSR_MMARVALID          (1u << 7)     /* MMFAR holds the faulting address */
+#define SCB_SHPR2_SVCALL_SHIFT      24
+#define SCB_SHPR3_PENDSV_SHIFT      16
+#define SCB_SHPR3_SYSTICK_SHIFT     24
+
+/* stm32f7 implements the top 4 bits of each priority byte, lower number wins */
+#define PRIO_LOWEST                 0xF0u
+#define PRIO_KERNEL_TICK            0xE0u
+
+/*
+ * pmsav7 mpu, 8 regions on the m7. a higher region number wins where regions overlap, the
+ * aliases write RBAR/RASR pairs back to back so up to 4 regions can go in one stm. RBAR with
+ * VALID set picks the region from its low bits instead of RNR
+ */
+struct mpu {
+	volatile uint32_t TYPE, CTRL, RNR, RBAR, RASR, RBAR_A1, RASR_A1, RBAR_A2, RASR_A2, RBAR_A3, RASR_A3;
+};
+#define MPU ((struct mpu *) 0xE000ED90)
+
+#define MPU_CTRL_ENABLE             (1u << 0)
+#define MPU_CTRL_PRIVDEFENA         (1u << 2)     /* privileged code falls back to the default map */
+
+#define MPU_RBAR_VALID              (1u << 4)
+#define MPU_RBAR_ADDR_MASK          (~0x1Fu)
+#define MPU_RASR_ENABLE             (1u << 0)
+#define MPU_RASR_SIZE(log2_size)    ((uint32_t)((log2_size) - 1) << 1)
+#define MPU_RASR_XN                 (1u << 28)
+
+#define MPU_RASR_AP_NONE            (0u << 24)
+#define MPU_RASR_AP_PRIV            (1u << 24)    /* privileged rw, unprivileged nothing */
+#define MPU_RASR_AP_URO             (2u << 24)    /* privileged rw, unprivileged ro */
+#define MPU_RASR_AP_FULL            (3u << 24)
+
+#define MPU_RASR_MEM_WT             (0x2u << 16)  /* TEX 000 C 1 B 0, normal write through */
+#define MPU_RASR_MEM_WBWA           (0xBu << 16)  /* TEX 001 C 1 B 1, normal write back allocate */
+
+/* fpu, startup turns on cp10/cp11 in CPACR. FPCCR picks how exceptions stack fp state */
+#define CPACR (*(volatile uint32_t *) 0xE000ED88)
+#define FPCCR (*(volatile uint32_t *) 0xE000EF34)
+
+#define FPCCR_ASPEN                 (1u << 31)    /* track fp use per context (CONTROL.FPCA) */
+#define FPCCR_LSPEN                 (1u << 30)    /* reserve the s0-s15 space, only write it if needed */
+#define FPCCR_LSPACT                (1u << 0)     /* that space is reserved and not written yet */
+
+/* systick, 24 bit down counter */
+struct systick {
+	volatile uint32_t CTRL, LOAD, VAL, CALIB;
+};
+#define SYSTICK ((struct systick *) 0xE000E010)
+
+#define SYSTICK_CTRL_ENABLE         (1u << 0)
+#define SYSTICK_CTRL_TICKINT        (1u << 1)
+#define SYSTICK_CTRL_CLKSOURCE      (1u << 2)     /* processor clock */
+#define SYSTICK_CTRL_COUNTFLAG      (1u << 16)    /* hit 0 since last read, reading clears it */
+#define SYSTICK_MAX_RELOAD          0x00FFFFFFu
+
+/* data watchpoint and trace, only the counters */
+struct dwt {
+	volatile uint32_t CTRL, CYCCNT, CPICNT, EXCCNT, SLEEPCNT, LSUCNT, FOLDCNT, PCSR;
+};
+#define DWT ((struct dwt *) 0xE0001000)
+#define DWT_LAR (*(volatile uint32_t *) 0xE0001FB0)
+
+#define DWT_CTRL_CYCCNTENA          (1u << 0)
+#define DWT_LAR_KEY                 0xC5ACCE55u   /* m7 locks the dwt until this is written */
+
+/* debug exception and monitor control, TRCENA powers the dwt */
+#define DEMCR (*(volatile uint32_t *) 0xE000EDFC)
+#define DEMCR_TRCENA                (1u << 24)
+
+#endif /* __CORTEX_H__ */
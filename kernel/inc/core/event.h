@@ -0,0 +1,53 @@
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+#include <stdint.h>
+
+#include "sched.h"
+#include "sprinter_common.h"
+#include "tcb.h"
+
+/*
+ * event flag groups, 32 flags an ISR or task sets and tasks wait on
+ *
+ * flags only change through port_cas, so setting and clearing are lock free from anywhere.
+ * like sem.h a set that finds tasks waiting defers the group to PendSV, which wakes every
+ * waiter whose flags are now there, highest priority first. with EVENT_CLEAR a waiter takes
+ * the flags it was woken by, so a later waiter on the same ones isn't woken by them too
+ *
+ * a waiter keeps what it wants in tcb.wait.value and gets back the flags that woke it there
+ */
+#define EVENT_ALL               (1u << 0)       /* every flag asked for rather than any of them */
+#define EVENT_CLEAR             (1u << 1)       /* clears the flags that woke it */
+
+typedef struct event_stats_t {
+    uint32_t blocked;              /* waits that had to block */
+    uint32_t woken;
+    uint32_t timeouts;             /* waits that timed out or were cancelled */
+    uint32_t waiters_max;
+} event_stats_t;
+
+typedef struct event_t {
+    volatile uint32_t flags;
+    volatile tcb_t* waiters;       /* highest priority first */
+    uint32_t waiting;
+    sched_deferred_t wake;
+    event_stats_t stats;
+} event_t;
+
+int event_init(event_t* event);
+
+/* from anywhere */
+int event_set(event_t* event, uint32_t flags);
+int event_clear(event_t* event, uint32_t flags);
+
+/*
+ * tasks only, waits up to timeout ticks (SCHED_WAIT_FOREVER, or 0 to not wait) for any of
+ * flags, or all of them with EVENT_ALL. the flags that did it go in woken_by if it isn't NULL.
+ * _NOP if it timed out or the task was suspended while it waited
+ */
+int event_wait(event_t* event, uint32_t flags, uint32_t options, uint32_t timeout, uint32_t* woken_by);
+
+int event_stats(const event_t* event, event_stats_t* stats);
+
+#endif /* __EVENT_H__ */
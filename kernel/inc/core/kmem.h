@@ -0,0 +1,81 @@
+#ifndef __KMEM_H__
+#define __KMEM_H__
+
+#include <stdint.h>
+
+#include "mem.h"
+#include "sprinter_common.h"
+
+/*
+ * kernel private memory in the dtcm gap between _end and the kernel stack
+ * (KERNELSPACE_HEAP_START_ADDR - KERNELSPACE_HEAP_END_ADDR, see mem.h). dtcm is zero wait
+ * state and never contended by the AXI bus, so kernel objects go here and not in userspace
+ *
+ * two layers:
+ *  - the arena is a bump allocator, _kmalloc never frees. boot time objects live for good,
+ *    scratch use can roll the arena back to a _kmark
+ *  - pools hand out fixed size objects from a free list, O(1) both ways. a pool that runs dry
+ *    carves another batch off the arena, so capacity is only bounded by the dtcm gap, not by a
+ *    compile time array size. ipc objects and timers come from kobj.h's pools, the task buffer
+ *    (tcbs by tid) is a single arena block
+ *
+ * none of this locks, call with interrupts masked or from handler mode
+ */
+#define KMEM_ALIGN_B                8
+
+typedef struct kmem_pool_stats_t {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;             /* pool was empty and the arena couldn't grow it */
+    uint32_t in_use;
+    uint32_t high_water;           /* most objects ever in use at once */
+    uint32_t capacity;             /* objects carved so far, in use or on the free list */
+} kmem_pool_stats_t;
+
+typedef struct kmem_pool_t {
+    struct kmem_pool_t* next;      /* arena's list of pools, for stats */
+    struct kmem_arena_t* arena;
+    const char* name;
+    void* free_list;               /* next pointer in each free object's first word */
+    uint16_t obj_size;
+    uint16_t batch;                /* objects carved whenever the pool runs dry */
+    kmem_pool_stats_t stats;
+} kmem_pool_t;
+
+typedef struct kmem_stats_t {
+    memsize_t size;                /* bytes in the dtcm gap */
+    memsize_t used;                /* bytes bumped off so far */
+    memsize_t high_water;          /* most bytes ever bumped off, survives _krelease */
+    uint32_t allocs;
+    uint32_t failures;
+} kmem_stats_t;
+
+typedef struct kmem_arena_t {
+    address_t start;
+    address_t top;                 /* next free byte */
+    address_t end;
+    kmem_pool_t* pools;
+    kmem_stats_t stats;
+} kmem_arena_t;
+
+/*
+ * arena, init once during kernel bootup
+ */
+void _kminit(kmem_arena_t* arena);
+void* _kmalloc(kmem_arena_t* arena, memsize_t size);
+address_t _kmark(const kmem_arena_t* arena);
+int _krelease(kmem_arena_t* arena, address_t mark);
+
+/*
+ * pools, prealloc objects are carved right away so a pool can be sized for its common case
+ * up front and only dip into the arena past it
+ */
+int _kpool_init(kmem_arena_t* arena, kmem_pool_t* pool, const char* name,
+                memsize_t obj_size, uint32_t prealloc, uint32_t batch);
+void* _kpool_alloc(kmem_pool_t* pool);
+int _kpool_free(kmem_pool_t* pool, void* obj);
+
+int _kmstats(const kmem_arena_t* arena, kmem_stats_t* stats);
+int _kpool_stats(const kmem_pool_t* pool, kmem_pool_stats_t* stats);
+
+#endif /* __KMEM_H__ */
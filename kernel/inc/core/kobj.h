@@ -0,0 +1,66 @@
+#ifndef __KOBJ_H__
+#define __KOBJ_H__
+
+#include <stdint.h>
+
+#include "kmem.h"
+#include "sprinter_common.h"
+
+/*
+ * kernel objects, ipc objects and timers out of kernel heap pools (kmem.h), named by handle
+ *
+ * a privileged task makes one with kobj_new, sets it up with its own init (msgq_init,
+ * sem_init, ...) on what kobj_get gives back and hands the handle to whoever uses it. a handle
+ * is the object's slot in a table of KOBJ_MAX plus the slot's generation, so once an object is
+ * deleted its handle stops resolving even after the slot is reused. kobj_get checks the type
+ * too, a semaphore's handle doesn't get anyone a queue. system calls (syscall.h) only take
+ * handles, so an unprivileged task can't point the kernel at memory of its choosing
+ *
+ * each type has its own pool, carved off the arena a batch at a time as they're needed. tcbs
+ * aren't in here, they're the task buffer's array (itself off the arena) and tids name them
+ */
+#define KOBJ_MAX                64
+#define KOBJ_NULL               0u
+#define KOBJ_SLOT_MASK          0xFFu           /* slot + 1, the rest is the generation */
+#define KOBJ_GEN_SHIFT          8
+#define KOBJ_POOL_BATCH         4
+
+_Static_assert(KOBJ_MAX < KOBJ_SLOT_MASK && (KOBJ_MAX % 32) == 0, "slots have to fit the handle and the free map");
+
+typedef uint32_t kobj_t;
+
+enum kobj_type {
+    KOBJ_MSGQ = 0,
+    KOBJ_SEM,
+    KOBJ_EVENT,
+    KOBJ_MUTEX,
+    KOBJ_TIMER,
+    KOBJ_TYPES
+};
+
+typedef struct kobj_entry_t {
+    void* obj;                     /* NULL while the slot is free */
+    uint16_t gen;                  /* bumped every time the slot is freed */
+    uint8_t type;
+} kobj_entry_t;
+
+typedef struct kobj_table_t {
+    kmem_pool_t pools[KOBJ_TYPES];
+    kobj_entry_t entries[KOBJ_MAX];
+    uint32_t free_slots[KOBJ_MAX / 32];
+    uint32_t live;
+} kobj_table_t;
+
+/* once during kernel bootup, after _kminit */
+int kobj_init(kmem_arena_t* arena);
+
+/* a zeroed object, KOBJ_NULL if the table is full or the pool can't grow */
+kobj_t kobj_new(enum kobj_type type);
+
+/* NULL unless handle is a live object of type */
+void* kobj_get(kobj_t handle, enum kobj_type type);
+
+/* back to its pool. _NOP while something still waits on it or a timer is still running */
+int kobj_delete(kobj_t handle);
+
+#endif /* __KOBJ_H__ */
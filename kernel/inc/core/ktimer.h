@@ -0,0 +1,74 @@
+#ifndef __KTIMER_H__
+#define __KTIMER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sprinter_common.h"
+
+/*
+ * hierarchical timer wheel, one-shot and periodic software timers in ticks
+ *
+ * KTIMER_LEVELS wheels of KTIMER_SLOTS slots each, level n slots are KTIMER_SLOTS^n ticks
+ * wide. a timer goes on the level its delay fits in, into the slot its expiry falls in, so
+ * starting and cancelling are a list insert/unlink. every tick runs level 0's current slot,
+ * and whenever a level wraps the next level's current slot is cascaded down a level. a timer
+ * is moved at most once per level, so expiry is amortised O(1) per timer
+ *
+ * delays past the top level go round it more than once and are re-filed on each pass.
+ * timers are owned by the caller (embedded in whatever they belong to), so there's no limit
+ * on how many there are
+ *
+ * none of this locks, call with interrupts masked or from handler mode. sched.h has the
+ * locked versions on the kernel's wheel
+ */
+#define KTIMER_SLOT_BITS        6
+#define KTIMER_SLOTS            (1u << KTIMER_SLOT_BITS)
+#define KTIMER_LEVELS           4
+#define KTIMER_IDLE             0xFFFF          /* ktimer_t.slot of a timer that isn't started */
+
+typedef struct ktimer_t {
+    struct ktimer_t* next;
+    struct ktimer_t* prev;
+    uint32_t expires;              /* tick it runs on */
+    uint32_t period;               /* 0 for one-shot */
+    uint16_t slot;                 /* level * KTIMER_SLOTS + slot, KTIMER_IDLE when not started */
+    void (*callback)(void* arg);   /* called from the tick, keep it short */
+    void* arg;
+} ktimer_t;
+
+typedef struct ktimer_stats_t {
+    uint32_t started;
+    uint32_t cancelled;
+    uint32_t fired;
+    uint32_t cascaded;             /* timers moved down a level */
+    uint32_t pending;
+} ktimer_stats_t;
+
+typedef struct ktimer_wheel_t {
+    uint32_t now;                  /* last tick run */
+    uint64_t occupied[KTIMER_LEVELS];                       /* bit set per non-empty slot */
+    ktimer_t* slots[KTIMER_LEVELS][KTIMER_SLOTS];
+    ktimer_stats_t stats;
+} ktimer_wheel_t;
+
+void _ktimer_init(ktimer_wheel_t* wheel, uint32_t now);
+void _ktimer_setup(ktimer_t* timer, void (*callback)(void*), void* arg);
+
+/* runs delay ticks from now (at least one), then every period ticks if period isn't 0 */
+int _ktimer_start(ktimer_wheel_t* wheel, ktimer_t* timer, uint32_t delay, uint32_t period);
+int _ktimer_cancel(ktimer_wheel_t* wheel, ktimer_t* timer);
+
+static inline bool _ktimer_pending(const ktimer_t* timer) {
+    return timer->slot != KTIMER_IDLE;
+}
+
+/* runs every tick up to and including now */
+void _ktimer_advance(ktimer_wheel_t* wheel, uint32_t now);
+
+/* ticks until the wheel next has something to do, a lower bound, at most max */
+uint32_t _ktimer_idle_ticks(const ktimer_wheel_t* wheel, uint32_t max);
+
+int _ktimer_stats(const ktimer_wheel_t* wheel, ktimer_stats_t* stats);
+
+#endif /* __KTIMER_H__ */
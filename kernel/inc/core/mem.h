@@ -6,11 +6,16 @@
 #include <stdint.h>
 
 #include "memmap_config.h"
+#include "slab.h"
 #include "sprinter_common.h"
 
 /* 
  * memory regions used for userspace & kernelspace
  */
+#if defined(SPRINTER_HOST)
+/* host linkers set _end themselves, the simulated one in bench/host_memmap.c goes by this */
+#define _end _host_end
+#endif
 extern uint8_t _dtcm_start[];
 extern uint8_t _dtcm_end[];
 extern uint8_t _userspace_start[];
@@ -18,15 +23,15 @@ extern uint8_t _userspace_end[];
 extern uint8_t _kernel_stack_size[];
 extern uint8_t _end[];
 
-#define USERSPACE_START_ADDR        ((uint32_t)_userspace_start)
-#define USERSPACE_END_ADDR          ((uint32_t)_userspace_end)
+#define USERSPACE_START_ADDR        ((address_t)_userspace_start)
+#define USERSPACE_END_ADDR          ((address_t)_userspace_end)
 
-#define KERNELSPACE_START_ADDR      ((uint32_t)_dtcm_start)
-#define KERNELSPACE_END_ADDR        ((uint32_t)_dtcm_end)
+#define KERNELSPACE_START_ADDR      ((address_t)_dtcm_start)
+#define KERNELSPACE_END_ADDR        ((address_t)_dtcm_end)
 
 /* kernel heap runs from the end of .bss up to the bottom of the kernel stack */
-#define KERNELSPACE_HEAP_START_ADDR   ((uint32_t)_end)
-#define KERNELSPACE_HEAP_END_ADDR     ((uint32_t)_dtcm_end - (uint32_t)_kernel_stack_size)
+#define KERNELSPACE_HEAP_START_ADDR   ((address_t)_end)
+#define KERNELSPACE_HEAP_END_ADDR     ((address_t)_dtcm_end - (address_t)_kernel_stack_size)
 /*  
     KERNEL MEMORY LAYOUT
     -----------------------------------------------------------------------------
@@ -36,18 +41,75 @@ extern uint8_t _end[];
 */
 
 /* 
- * userspace is sectioned by 4KB - right now, each task just gets a 4KB piece of the stack 
+ * userspace is the heap and, above it, whatever is left over for task stacks. stacks are
+ * carved to size from there (see stack.h) so how many tasks fit depends on how big they are
  * TODO virtual memory & proper paging coming soon
  */          
-#define USERSPACE_STACKS_SIZE_B           (STACK_SIZE * MAX_TASKS)
 #define USERSPACE_HEAP_SIZE               (256 * 1024)
 #define USERSPACE_HEAP_START_ADDR         USERSPACE_START_ADDR
 #define USERSPACE_HEAP_END_ADDR           (USERSPACE_HEAP_START_ADDR + USERSPACE_HEAP_SIZE)
+#define USERSPACE_STACKS_SIZE_B           (USERSPACE_SIZE_B - USERSPACE_HEAP_SIZE)
+#define USERSPACE_STACKS_START_ADDR       USERSPACE_HEAP_END_ADDR
 
 _Static_assert((USERSPACE_HEAP_SIZE & (USERSPACE_HEAP_SIZE - 1)) == 0,
                "buddy pool must be a power of two");
-_Static_assert((USERSPACE_HEAP_SIZE + USERSPACE_STACKS_SIZE_B) <= USERSPACE_SIZE_B,
-               "heap plus task stacks do not fit in userspace");
+_Static_assert(USERSPACE_HEAP_SIZE < USERSPACE_SIZE_B, "heap leaves no room for task stacks");
+
+/*
+ * live heap counters, kept up to date by every alloc/free/transfer so reading them never scans.
+ * bytes are what blocks really take (rounded up, with any header), not what was asked for
+ */
+typedef struct mem_counters_t {
+    memsize_t bytes_used;
+    memsize_t owner_bytes[MAX_TASKS];
+    memsize_t kernel_bytes;        /* blocks owned by TID_NULL or anything that isn't a task */
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+} mem_counters_t;
+
+static inline void mem_charge(mem_counters_t* counters, uint32_t owner, memsize_t size) {
+    counters->bytes_used += size;
+    if (owner < MAX_TASKS) {
+        counters->owner_bytes[owner] += size;
+    } else {
+        counters->kernel_bytes += size;
+    }
+}
+
+static inline void mem_uncharge(mem_counters_t* counters, uint32_t owner, memsize_t size) {
+    counters->bytes_used -= size;
+    if (owner < MAX_TASKS) {
+        counters->owner_bytes[owner] -= size;
+    } else {
+        counters->kernel_bytes -= size;
+    }
+}
+
+/*
+ * called whenever a task's block or slab object stops being its own, freed or handed on,
+ * before anyone else can get it. the task buffer hooks this to drop mpu grants on it
+ * (init_taskbuff), _minit leaves it empty
+ */
+typedef struct mem_release_t {
+    void (*fn)(void* ctx, tid_t owner, address_t base);
+    void* ctx;
+} mem_release_t;
+
+static inline void mem_released(const mem_release_t* release, uint32_t owner, address_t base) {
+    if (release->fn != NULL && owner < MAX_TASKS) {
+        release->fn(release->ctx, (tid_t)owner, base);
+    }
+}
+
+/*
+ * the userspace heap is a buddy allocator with slab caches in front of it by default. building
+ * with MEM_ALLOCATOR=tlsf swaps in a two level segregated fit allocator (see mem_tlsf.h) behind
+ * the same functions at the bottom of this file
+ */
+#if defined(MEM_USE_TLSF)
+#include "mem_tlsf.h"
+#else
 
 /* 
  * memory buddy allocator algorithm
@@ -70,10 +132,53 @@ _Static_assert((USERSPACE_HEAP_SIZE + USERSPACE_STACKS_SIZE_B) <= USERSPACE_SIZE
    9   |     511-1022 |   512 |    512 B
   10   |    1023-2046 |  1024 |    256 B
 -------+--------------+-------+-----------
+
+ * a node's state only means something while its parent is SPLIT, USED and FREE nodes speak for
+ * their whole subtree. so no operation walks a subtree and the worst case is bounded by depth:
+ * _malloc splits at most MEM_BUDDY_MAX_LAYER_ID times, _free walks down at most that many
+ * layers and coalesces back up at most that many, whatever the heap looks like
 */
 #define MEM_BUDDY_MIN_BLOCK_SIZE_B  256
-#define MEM_BUDDY_MAX_BLOCKS        (2 * (USERSPACE_HEAP_SIZE / MEM_BUDDY_MIN_BLOCK_SIZE_B) - 1)
+#define MEM_BUDDY_MIN_BLOCKS        (USERSPACE_HEAP_SIZE / MEM_BUDDY_MIN_BLOCK_SIZE_B)
+#define MEM_BUDDY_MAX_BLOCKS        (2 * MEM_BUDDY_MIN_BLOCKS - 1)
 #define MEM_BUDDY_MAX_LAYER_ID      __builtin_ctz((USERSPACE_HEAP_SIZE / MEM_BUDDY_MIN_BLOCK_SIZE_B))
+#define MEM_BUDDY_LAYERS            (MEM_BUDDY_MAX_LAYER_ID + 1)
+
+/*
+ * free bitmaps, one bit per node, indexed by node index + 1 so that every layer from 5 down
+ * starts on a word boundary (layer n owns bits [2^n, 2^(n+1))). layers 0-4 share word 0.
+ * the summary has a bit per bitmap word that still has a free node in it, and layer_mask has
+ * a bit per layer with at least one free node, so finding a free block is a handful of ctz/clz
+ */
+#define MEM_BUDDY_MAP_WORDS         ((MEM_BUDDY_MAX_BLOCKS + 1) / 32)
+#define MEM_BUDDY_SUMMARY_WORDS     ((MEM_BUDDY_MAP_WORDS + 31) / 32)
+
+/*
+ * node states are packed 2 bits each, 16 to a word. owners are only meaningful for USED blocks,
+ * and no two USED blocks start on the same min block, so they're kept per min block instead of
+ * per node (a block's owner sits at the slot of its first min block)
+ */
+#define MEM_BUDDY_STATE_BITS        2
+#define MEM_BUDDY_STATE_WORDS       ((MEM_BUDDY_MAX_BLOCKS + 15) / 16)
+#define MEM_OWNER_NONE              0xFF
+
+_Static_assert(MAX_TASKS < MEM_OWNER_NONE, "tids must fit in the uint8_t owner table");
+
+/*
+ * per task index of owned blocks for bulk reclaim, a bitmap over 1 KB pages per tid with a
+ * summary word of which bitmap words have anything in them. a page's bit is set while any of
+ * the blocks starting in it is the task's, reclaim looks at the page's 4 owner slots to find
+ * them. bitmap words are only valid while their summary bit is set, so resetting a task is just
+ * clearing its summary
+ */
+#define MEM_OWNER_PAGE_B            1024
+#define MEM_OWNER_PAGE_SLOTS        (MEM_OWNER_PAGE_B / MEM_BUDDY_MIN_BLOCK_SIZE_B)
+#define MEM_BUDDY_OWNER_WORDS       (USERSPACE_HEAP_SIZE / MEM_OWNER_PAGE_B / 32)
+
+_Static_assert(MEM_BUDDY_OWNER_WORDS <= 32, "owner summary is a single word");
+
+/* one bit per slab sized page of the heap, set while that page is a slab (see slab.h) */
+#define MEM_SLAB_MAP_WORDS          ((USERSPACE_HEAP_SIZE / SLAB_PAGE_SIZE_B + 31) / 32)
 
 typedef enum node_state_t {
     NODE_FREE = 0,
@@ -82,22 +187,108 @@ typedef enum node_state_t {
     NODE_INVALID = 3,
 } node_state_t;
 
-typedef struct mem_node_t {
+typedef struct heap_manager {
     /* free, used, split into children somewhere in the tree, or doesnt exist */
-    node_state_t state;
-    tid_t owner_tid;
-} mem_node_t;
+    uint32_t node_states[MEM_BUDDY_STATE_WORDS];
+    uint8_t owners[MEM_BUDDY_MIN_BLOCKS];
+    uint32_t owned_map[MAX_TASKS][MEM_BUDDY_OWNER_WORDS];
+    uint32_t owned_summary[MAX_TASKS];
 
-typedef struct heap_manager {
-    mem_node_t mem_nodes[MEM_BUDDY_MAX_BLOCKS];
+    uint32_t free_map[MEM_BUDDY_MAP_WORDS];
+    uint32_t free_summary[MEM_BUDDY_SUMMARY_WORDS];
+    uint16_t free_count[MEM_BUDDY_LAYERS];
+    uint32_t layer_mask;
+
+    slab_cache_t slab_caches[SLAB_CLASSES];
+    uint32_t slab_map[MEM_SLAB_MAP_WORDS];
+
+    mem_counters_t counters;
+    mem_release_t release;
 } heap_manager;
 
+/*
+ * used to be 16 KB of DTCM as an enum + tid_t per node, for the buddy tree alone. on target,
+ * the slab caches' pointers are twice the size on host
+ */
+#if !defined(SPRINTER_HOST)
+_Static_assert(sizeof(heap_manager) <= 3 * 1024, "heap metadata outgrew its 3 KB budget");
+#endif
+
+/* buddy blocks carry no header */
+#define MEM_BLOCK_OVERHEAD_B        0
+
+/* free blocks are counted per buddy layer */
+#define MEM_FREE_CLASSES            MEM_BUDDY_LAYERS
+
+/* untraced buddy entry points, for the slab layer */
+address_t _mblock_alloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor);
+int _mblock_free(heap_manager* heap_mgr, address_t target);
+
+#endif /* MEM_USE_TLSF */
+
 /*
  * this mem allocator is init duing kernel bootup
  * the design is these are kernel functions, when exposed to the user, they do NOT have access to heap_mgr
+ * everything below masks interrupts for its own duration, that's the heap's only lock. the masks
+ * nest, so a check and the call that acts on it (_mowner then _free) go under one more around both
  */
 void _minit(heap_manager* heap_mgr);
 address_t _malloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor);
 int _free(heap_manager* heap_mgr, address_t target);
 
+/* frees every block owned by a task, used when the task goes away */
+int _free_all_owned(heap_manager* heap_mgr, tid_t owner);
+
+/* hands a whole block to another owner */
+int _mtransfer(heap_manager* heap_mgr, address_t target, tid_t new_owner);
+
+/*
+ * same, but only if from owns it, _NOP otherwise. for tasks passing blocks to each other
+ * (msgq_send_block). small buddy requests are slab objects that share a page and an owner with
+ * the rest of it, those can't change hands on their own and get _NOP too
+ */
+int _mgive(heap_manager* heap_mgr, address_t target, tid_t from, tid_t to);
+
+/* who a block (or slab object) belongs to, MEM_OWNER_NONE unless target is the start of one in use */
+tid_t _mowner(heap_manager* heap_mgr, address_t target);
+
+/* bytes usable at target, not counting MEM_BLOCK_OVERHEAD_B */
+memsize_t _msize(heap_manager* heap_mgr, address_t target);
+
+/*
+ * heap introspection, counters plus what can be read straight off the free bitmaps
+ */
+typedef struct mem_stats_t {
+    memsize_t bytes_used;
+    memsize_t bytes_free;
+    memsize_t largest_free;        /* see _mlargest_free */
+    memsize_t owner_bytes[MAX_TASKS];
+    memsize_t kernel_bytes;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint16_t free_blocks[MEM_FREE_CLASSES];     /* free blocks per buddy layer / tlsf first level */
+} mem_stats_t;
+
+int _mstats(heap_manager* heap_mgr, mem_stats_t* stats);
+
+/*
+ * largest request that is guaranteed to succeed right now, O(1) so it can gate big allocations.
+ * exact for the buddy heap, for tlsf it's the bottom of the biggest non-empty size class
+ */
+memsize_t _mlargest_free(heap_manager* heap_mgr);
+
+/*
+ * allocation tracing, building with MEM_TRACE=1 logs every _malloc/_free over uart in the
+ * format the host trace replayer reads (bench/trace_bench.c), addresses double as block ids
+ */
+#if defined(MEM_TRACE)
+#include "drivers/uart.h"
+#define MEM_TRACE_ALLOC(addr, size, tid)  uart_out("@a %h %d %d", (int)(addr), (int)(size), (int)(tid))
+#define MEM_TRACE_FREE(addr)              uart_out("@f %h", (int)(addr))
+#else
+#define MEM_TRACE_ALLOC(addr, size, tid)
+#define MEM_TRACE_FREE(addr)
+#endif
+
 #endif
@@ -0,0 +1,71 @@
+#ifndef __MEM_TLSF_H__
+#define __MEM_TLSF_H__
+
+#include <stdint.h>
+
+#include "sprinter_common.h"
+
+/*
+ * two level segregated fit allocator for the userspace heap (MEM_ALLOCATOR=tlsf)
+ * free blocks are binned by size: the first level is the power of two, the second splits each
+ * power of two into TLSF_SL_COUNT linear ranges. a bitmap per level makes finding a free block
+ * two ffs, and blocks are split/merged with their physical neighbours, so malloc and free are
+ * O(1) and a request only rounds up to the next second level range (~6%) instead of the next
+ * power of two
+ *
+ *   fl |  block sizes   | sl step
+ * -----+----------------+--------
+ *    0 |     0 - 127 B  |    8 B
+ *    1 |   128 - 255 B  |    8 B
+ *    2 |   256 - 511 B  |   16 B
+ *   .. |       ..       |    ..
+ *   11 | 128 K - 256 KB |    8 KB
+ * -----+----------------+--------
+ */
+#define TLSF_ALIGN_LOG2             3
+#define TLSF_ALIGN_B                (1 << TLSF_ALIGN_LOG2)
+#define TLSF_SL_COUNT_LOG2          4
+#define TLSF_SL_COUNT               (1 << TLSF_SL_COUNT_LOG2)
+#define TLSF_FL_SHIFT               (TLSF_SL_COUNT_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK_B          (1 << TLSF_FL_SHIFT)
+#define TLSF_FL_COUNT               (__builtin_ctz(USERSPACE_HEAP_SIZE) - TLSF_FL_SHIFT + 1)
+#define TLSF_MIN_BLOCK_B            16
+
+/*
+ * every block, free or used, starts with this header and the payload follows it. free blocks
+ * sit on a size class list through next/prev, used blocks sit on their owner's list through
+ * the same links so _free_all_owned doesn't have to look at anything else
+ */
+typedef struct tlsf_block_t {
+    struct tlsf_block_t* prev_phys;     /* block physically before this one, valid when it's free */
+    uint32_t info;                      /* payload size | owner << 24 | TLSF_BLOCK_ flags */
+    struct tlsf_block_t* next;
+    struct tlsf_block_t* prev;
+} tlsf_block_t;
+
+#define TLSF_BLOCK_FREE             0x1u
+#define TLSF_BLOCK_PREV_FREE        0x2u
+#define TLSF_BLOCK_SIZE_MASK        0x00FFFFF8u
+#define TLSF_BLOCK_OWNER_SHIFT      24
+#define MEM_OWNER_NONE              0xFF
+
+#define MEM_BLOCK_OVERHEAD_B        ((sizeof(tlsf_block_t) + TLSF_ALIGN_B - 1) & ~(uintptr_t)(TLSF_ALIGN_B - 1))
+
+_Static_assert(USERSPACE_HEAP_SIZE <= TLSF_BLOCK_SIZE_MASK, "heap too big for the block size field");
+_Static_assert(MAX_TASKS < MEM_OWNER_NONE, "tids must fit in the block owner byte");
+
+typedef struct heap_manager {
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    tlsf_block_t* free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    tlsf_block_t* owned[MAX_TASKS];
+    uint16_t free_count[TLSF_FL_COUNT];
+
+    mem_counters_t counters;
+    mem_release_t release;
+} heap_manager;
+
+/* free blocks are counted per first level */
+#define MEM_FREE_CLASSES            TLSF_FL_COUNT
+
+#endif /* __MEM_TLSF_H__ */
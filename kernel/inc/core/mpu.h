@@ -0,0 +1,97 @@
+#ifndef __MPU_H__
+#define __MPU_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cortex.h"
+#include "sprinter_common.h"
+#include "stack.h"
+#include "tcb.h"
+
+/*
+ * memory protection
+ *
+ *  region | what                                 | access
+ * --------+--------------------------------------+----------------------------------
+ *    0    | dtcm and userspace                   | privileged only, no exec
+ *    1    | kernel image                         | unprivileged read only
+ *    4    | running task's stack                 | full, no exec
+ *   5, 6  | running task's grants (heap blocks)  | full, no exec
+ *    7    | bottom MPU_GUARD_B of its stack      | none
+ * --------+--------------------------------------+----------------------------------
+ *
+ * 0 and 1 are set once by mpu_init, 4 - 7 live in each tcb and PendSV copies them in on every
+ * switch (4 RBAR/RASR pairs, one ldm and one stm). the guard is in the stack's own bottom
+ * chunk rather than under it, the stack below belongs to another task that may be getting its
+ * first frame built right now
+ *
+ * privileged code outside a region sees the default memory map (PRIVDEFENA), so the kernel and
+ * privileged tasks only notice the guard. an unprivileged task (TASK_UNPRIVILEGED) only gets its
+ * stack, its grants and the code, so it can't call into the kernel either. it goes through the
+ * system calls instead (syscall.h), returning from ptask included
+ *
+ * a task that faults is reported with its tid and removed, a fault in root or in the kernel
+ * itself stops everything. the handler only takes the task off the cpu, the report and
+ * remove_task are deferred work (sched.h) that PendSV runs before it switches. a fault inside
+ * a masked section can't be taken as a memmanage fault at all, it escalates to a hardfault and
+ * stops everything too
+ */
+#define MPU_GUARD_B             32
+#define MPU_GRANTS              2
+
+#define MPU_REGION_SRAM         0
+#define MPU_REGION_IMAGE        1
+#define MPU_REGION_STACK        4
+#define MPU_REGION_GRANT        5
+#define MPU_REGION_GUARD        7
+
+_Static_assert(TCB_MPU_REGIONS == MPU_REGION_GUARD - MPU_REGION_STACK + 1, "tcb_t.mpu is regions 4 - 7");
+_Static_assert(STACK_CHUNK_B > MPU_GUARD_B, "guard would take the whole stack");
+
+typedef struct mpu_fault_t {
+    uint32_t faults;               /* tasks that took a memmanage fault so far */
+    tid_t tid;                     /* the last one */
+    address_t addr;                /* what it touched, 0 if the mpu couldn't tell */
+    uint32_t cfsr;
+    bool overflow;                 /* ran into its guard */
+} mpu_fault_t;
+
+void mpu_init(void);
+
+/* stack and guard regions for a new task, no grants */
+void mpu_task_init(tcb_t* task);
+
+/*
+ * lets the task at a block, base and size have to be something a region can cover: a power of
+ * two of at least 32 B, aligned to itself (buddy blocks are, tlsf blocks usually aren't)
+ */
+int mpu_grant(volatile tcb_t* task, uint32_t slot, address_t base, memsize_t size);
+
+/* drops the task's grants on the block at base, _NOP if it had none */
+int mpu_revoke(volatile tcb_t* task, address_t base);
+
+/* the slot a grant on base would go in, one already on it or a free one. MPU_GRANTS if all are taken */
+uint32_t mpu_grant_slot(const volatile tcb_t* task, address_t base);
+
+int mpu_fault_stats(mpu_fault_t* stats);
+
+/* records a task's fault and defers its removal, MemManage_Handler's part that isn't hardware */
+void mpu_fault(volatile tcb_t* task, uint32_t cfsr, address_t addr);
+
+/* exception handlers, in the vector table */
+void MemManage_Handler(void);
+void HardFault_Handler(void);
+
+#if !defined(SPRINTER_HOST)
+/* the same 4 region load PendSV does, for when the running task's regions change */
+static inline void mpu_load(const volatile tcb_t* task) {
+    volatile uint32_t* rbar = &MPU->RBAR;
+    for (uint32_t i = 0; i < TCB_MPU_WORDS; i++) {
+        rbar[i] = task->mpu[i];
+    }
+    __asm__ volatile ("dsb\n\tisb" ::: "memory");
+}
+#endif
+
+#endif /* __MPU_H__ */
@@ -0,0 +1,79 @@
+#ifndef __MSGQ_H__
+#define __MSGQ_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mem.h"
+#include "sched.h"
+#include "sprinter_common.h"
+#include "tcb.h"
+
+/*
+ * message queues, fixed size messages copied through a single producer / single consumer ring
+ *
+ * head only ever moves in msgq_recv and tail only in msgq_send, both free running and
+ * compared by difference. each side reads the other's index, copies and then publishes its own
+ * behind a dmb, so neither ever waits on or masks out the other. an ISR can send to a task
+ * (or a task to an ISR) with interrupts left on, it's one copy and two barriers
+ *
+ * one sender and one receiver per queue at a time, that's the whole contract. anything else
+ * needs a queue per sender
+ *
+ * a receiver that blocks parks itself on the queue, and only then does a send touch the
+ * scheduler. even then it doesn't wake it itself, it defers the queue to PendSV (sched_defer)
+ * like a semaphore give, so a send from an ISR still never masks. the empty check is redone
+ * with interrupts masked after parking, so a send can't slip in between and be missed
+ *
+ * block queues (msg_size MSGQ_BLOCK_B) carry heap blocks instead of copies. the sender gives
+ * up the block, _mgive moves it to the receiver's tid, and only the address goes through the
+ * ring, so a multi-KB frame costs the same as a word. the receiver frees it or sends it on
+ */
+#define MSGQ_BUFFER_B(msg_size, slots)  ((memsize_t)(msg_size) * (slots))
+#define MSGQ_BLOCK_B                    ((memsize_t)sizeof(address_t))
+
+typedef struct msgq_stats_t {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t full;                 /* sends turned away */
+    uint32_t blocked;              /* receives that had to wait */
+    uint32_t high_water;           /* most messages queued at once, as seen by send */
+} msgq_stats_t;
+
+typedef struct msgq_t {
+    volatile uint32_t head;        /* next to receive, receiver writes it */
+    volatile uint32_t tail;        /* next to send into, sender writes it */
+    uint32_t mask;                 /* slots - 1 */
+    memsize_t msg_size;
+    uint8_t* buffer;               /* slots * msg_size bytes */
+    volatile tcb_t* volatile waiter;
+    sched_deferred_t wake;
+    msgq_stats_t stats;
+} msgq_t;
+
+/* slots has to be a power of two, buffer MSGQ_BUFFER_B(msg_size, slots) bytes */
+int msgq_init(msgq_t* queue, void* buffer, memsize_t msg_size, uint32_t slots);
+
+/* _NOP if it's full, from a task or an ISR */
+int msgq_send(msgq_t* queue, const void* msg);
+
+/* _NOP if it's empty and block is false, otherwise sleeps until there's something */
+int msgq_recv(msgq_t* queue, void* msg, bool block);
+
+/*
+ * hands block, a whole _malloc'd block the calling task owns, to task to. tasks only, the
+ * sender has to be scheduler.current. _NOP if the queue is full or the block can't change
+ * hands (not the caller's, or a slab object), the block stays with the caller either way
+ */
+int msgq_send_block(msgq_t* queue, heap_manager* heap_mgr, address_t block, tid_t to);
+
+/* as msgq_recv, block is the receiver's from here on */
+int msgq_recv_block(msgq_t* queue, address_t* block, bool wait);
+
+static inline uint32_t msgq_count(const msgq_t* queue) {
+    return queue->tail - queue->head;
+}
+
+int msgq_stats(const msgq_t* queue, msgq_stats_t* stats);
+
+#endif /* __MSGQ_H__ */
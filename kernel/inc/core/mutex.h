@@ -0,0 +1,85 @@
+#ifndef __MUTEX_H__
+#define __MUTEX_H__
+
+#include <stdint.h>
+
+#include "sprinter_common.h"
+#include "tcb.h"
+
+/*
+ * mutexes between tasks, with priority inheritance
+ *
+ * owner is the holder's tid + 1 with its tcb.serial above it, 0 while it's free. taking a free one and giving back one
+ * nobody waits on is a single ldrex/strex on owner (port_cas) from the task itself, nothing is
+ * masked and the scheduler isn't involved. only a task that finds it taken goes the slow way:
+ * with interrupts masked it sets MUTEX_WAITERS in owner, which makes the holder's own fast
+ * unlock fail, queues itself and blocks
+ *
+ * waiters queue highest priority first (FIFO among equals, sched_waitq_add). unlock hands the
+ * mutex straight to the first one, so a waiter is only ever passed over by higher priority
+ * ones and can't be starved by a task that comes along and grabs it first
+ *
+ * the holder runs at the highest priority of anyone waiting on anything it holds, and if the
+ * holder is itself waiting on another mutex that one's holder inherits it too, all the way
+ * down the chain. an EDF waiter counts as the top fixed priority. every change is worked out
+ * again from tcb.base_priority and the mutexes on tcb.boosting, so giving one back or a waiter
+ * being suspended drops exactly what it lent
+ *
+ * the fast path is only there for privileged tasks. an unprivileged one can't reach a mutex
+ * (they're kernel objects, kobj.h), so every lock and unlock it makes is a system call
+ * (sys_mutex_lock) and pays the svc entry and exit even when nobody else wants the mutex
+ *
+ * a lock waits for at most timeout ticks, like sem_take. a waiter that times out leaves the
+ * queue and the holder drops whatever it lent
+ *
+ * not recursive and tasks only, never from an ISR. a task that's removed holding one hands it
+ * to its first waiter (mutex_abandon). one nobody waits on is left to the next task that locks
+ * it, the serial in owner keeps a new task on the same tid from counting as its holder
+ */
+#define MUTEX_WAITERS           (1u << 31)      /* in owner, someone's queued */
+#define MUTEX_OWNER_MASK        (~MUTEX_WAITERS)
+#define MUTEX_TID_BITS          8
+#define MUTEX_TID_MASK          ((1u << MUTEX_TID_BITS) - 1)
+
+_Static_assert(MAX_TASKS < MUTEX_TID_MASK, "tid + 1 has to fit under the serial");
+
+typedef struct mutex_stats_t {
+    uint32_t locks;                /* times it was taken, either way */
+    uint32_t contended;            /* locks that had to wait */
+    uint32_t timeouts;             /* waits that timed out or were cancelled */
+    uint32_t inherited;            /* holders that had their priority raised */
+    uint32_t waiters_max;
+    uint32_t wait_cycles_last;     /* blocked to handed the mutex, 0 without a cycle counter */
+    uint32_t wait_cycles_max;
+    uint64_t wait_cycles_total;
+} mutex_stats_t;
+
+typedef struct mutex_t {
+    volatile uint32_t owner;
+    volatile tcb_t* waiters;       /* highest priority first */
+    uint32_t waiting;
+    struct mutex_t* boosting_next; /* on the holder's tcb.boosting while there are waiters */
+    mutex_stats_t stats;
+} mutex_t;
+
+int mutex_init(mutex_t* mutex);
+
+/*
+ * waits for up to timeout ticks (SCHED_WAIT_FOREVER, or 0 to not wait at all). _ERR if the
+ * caller holds it already, _NOP if it timed out or the task was suspended while it waited and
+ * resumed without it. timeouts need the tick
+ */
+int mutex_lock(mutex_t* mutex, uint32_t timeout);
+
+/* _NOP if someone else has it */
+int mutex_trylock(mutex_t* mutex);
+
+/* _ERR if the caller isn't the holder */
+int mutex_unlock(mutex_t* mutex);
+
+int mutex_stats(const mutex_t* mutex, mutex_stats_t* stats);
+
+/* task is being removed (remove_task), interrupts masked */
+void mutex_abandon(volatile tcb_t* task);
+
+#endif /* __MUTEX_H__ */
@@ -0,0 +1,120 @@
+#ifndef __PORT_H__
+#define __PORT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cortex.h"
+
+/*
+ * the bits of the scheduler that touch the core, host builds (SPRINTER_HOST) get no-ops so the
+ * scheduler's bookkeeping can be benchmarked off target
+ */
+#if defined(SPRINTER_HOST)
+
+static inline uint32_t port_irq_save(void) { return 0; }
+static inline void port_irq_restore(uint32_t primask) { (void)primask; }
+static inline void port_pend_switch(void) { }
+static inline void port_wait_for_interrupt(void) { }
+static inline void port_cycle_counter_init(void) { }
+static inline uint32_t port_cycles(void) { return 0; }
+static inline volatile uint32_t* port_cycle_source(void) { static uint32_t zero; return &zero; }
+static inline void port_fpu_lazy_init(void) { }
+
+/* the host bench runs queues across real threads, so the barriers have to be real too */
+static inline void port_dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+static inline bool port_cas(volatile uint32_t* word, uint32_t expect, uint32_t desired) {
+    return __atomic_compare_exchange_n(word, &expect, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+static inline bool port_cas_ptr(void* volatile* word, void* expect, void* desired) {
+    return __atomic_compare_exchange_n(word, &expect, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+#else
+
+/* masks interrupts, returns whether they already were so sections can nest */
+static inline uint32_t port_irq_save(void) {
+    uint32_t primask;
+    __asm__ volatile ("mrs %0, primask\n\tcpsid i" : "=r" (primask) :: "memory");
+    return primask;
+}
+
+static inline void port_irq_restore(uint32_t primask) {
+    __asm__ volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+/* the switch itself happens in PendSV once nothing of higher priority is running */
+static inline void port_pend_switch(void) {
+    SCB->ICSR = SCB_ICSR_PENDSVSET;
+}
+
+/* both are the reset default on the m7, set anyway since context_switch.s depends on them */
+static inline void port_fpu_lazy_init(void) {
+    FPCCR |= FPCCR_ASPEN | FPCCR_LSPEN;
+}
+
+/* orders memory accesses either side of it, for anything shared without masking interrupts */
+static inline void port_dmb(void) {
+    __asm__ volatile ("dmb" ::: "memory");
+}
+
+/*
+ * word = desired if it's still expect, without masking interrupts. an exception between the
+ * ldrex and the strex clears the monitor, so the strex fails and it's looked at again. the dmb
+ * makes whatever the word guards visible either side of it changing hands
+ */
+static inline bool port_cas(volatile uint32_t* word, uint32_t expect, uint32_t desired) {
+    uint32_t seen;
+    uint32_t failed;
+
+    do {
+        __asm__ volatile ("ldrex %0, [%1]" : "=r" (seen) : "r" (word) : "memory");
+        if (seen != expect) {
+            __asm__ volatile ("clrex" ::: "memory");
+            return false;
+        }
+        __asm__ volatile ("strex %0, %2, [%1]" : "=&r" (failed) : "r" (word), "r" (desired) : "memory");
+    } while (failed != 0);
+    port_dmb();
+
+    return true;
+}
+
+static inline bool port_cas_ptr(void* volatile* word, void* expect, void* desired) {
+    return port_cas((volatile uint32_t*)word, (uint32_t)expect, (uint32_t)desired);
+}
+
+/* sleeps until an interrupt is pending, which wakes the core even with primask set */
+static inline void port_wait_for_interrupt(void) {
+    __asm__ volatile ("dsb\n\twfi\n\tisb" ::: "memory");
+}
+
+/*
+ * free running cpu cycle count, qemu has no dwt so it just reads 0 there. port_cycle_source is
+ * where the count can be read from, for context_switch.s
+ */
+#if defined(SPRINTER_QEMU)
+static inline void port_cycle_counter_init(void) { }
+static inline uint32_t port_cycles(void) { return 0; }
+static inline volatile uint32_t* port_cycle_source(void) { static uint32_t zero; return &zero; }
+#else
+static inline void port_cycle_counter_init(void) {
+    DEMCR |= DEMCR_TRCENA;
+    DWT_LAR = DWT_LAR_KEY;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+static inline uint32_t port_cycles(void) {
+    return DWT->CYCCNT;
+}
+
+static inline volatile uint32_t* port_cycle_source(void) {
+    return &DWT->CYCCNT;
+}
+#endif
+
+#endif /* SPRINTER_HOST */
+
+#endif /* __PORT_H__ */
@@ -0,0 +1,216 @@
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ktimer.h"
+#include "sprinter_common.h"
+#include "tcb.h"
+#include "tcb_buf.h"
+
+/*
+ * preemptive priority scheduler
+ * every priority has a FIFO queue of READY tasks and a bit in ready_map while it isn't empty,
+ * so the next task is the head of queue 31 - clz(ready_map) whatever MAX_TASKS is. the running
+ * task is never on a queue. a task that becomes ready above the running one's priority
+ * preempts it straight away, tasks of the same priority take turns every
+ * SCHED_TIMESLICE_TICKS ticks (0 turns that off, they then only switch on yield/block)
+ *
+ * the switch itself is PendSV (context_switch.s) at the lowest priority, SysTick just above
+ * it drives the slices. tasks run in thread mode on their own psp stack, handlers and the
+ * kernel stay on msp
+ *
+ * SCHED_TICK_HZ 0 leaves SysTick alone
+ *
+ * above all the priorities there's an earliest deadline first class for periodic tasks
+ * (create_rt_task). any ready EDF task beats every fixed priority one, among them the
+ * earliest absolute deadline runs. ready EDF tasks sit in a min heap on their deadline and the
+ * ones waiting for their next period in another on their release, so picking, releasing and
+ * blocking are all O(log n). a job ends with sched_wait_period, one that uses up its budget
+ * first is throttled until its next period. a job that sleeps or blocks is still the same job
+ * when it wakes, deadline and budget left included. admission is the density test, the sum of
+ * budget / deadline can't go over SCHED_EDF_UTIL_PPM, which is enough for EDF to meet every
+ * deadline on one core. it defaults to less than all of it so root and fixed priority tasks
+ * still get some cpu
+ *
+ * the tick is also the kernel's clock. it drives a timer wheel (ktimer.h) that software timers
+ * and sleeping tasks are on, a sleeping task is off every queue until its timer wakes it
+ *
+ * ISRs don't touch any of this to wake a task. they queue a sched_deferred_t without masking
+ * anything (sched_defer) and pend PendSV, which runs the queued work before it switches. the
+ * work wakes whoever it should and the switch then goes straight to them
+ */
+#ifndef SCHED_TICK_HZ
+#define SCHED_TICK_HZ           1000
+#endif
+#ifndef SCHED_TIMESLICE_TICKS
+#define SCHED_TIMESLICE_TICKS   10
+#endif
+
+#define SCHED_PRIORITIES        32
+#define SCHED_PRIO_IDLE         0
+
+#define SCHED_WAIT_FOREVER      0xFFFFFFFFu     /* sched_wait timeout */
+
+#ifndef SCHED_EDF_UTIL_PPM
+#define SCHED_EDF_UTIL_PPM      900000
+#endif
+
+typedef struct sched_heap_t {
+    volatile tcb_t* items[MAX_TASKS];
+    uint32_t count;
+    bool by_release;                    /* key is edf.release rather than edf.abs_deadline */
+} sched_heap_t;
+
+/*
+ * tickless idle, root calls sched_idle in its loop. with nothing else ready SysTick is stretched
+ * over the ticks until something is next due and the core sleeps in wfi, the ticks it slept
+ * through are added back on wakeup. a sleep lasts until the next timer or EDF release is due,
+ * some interrupt or one full SysTick reload (~93 ms at 180 MHz), which keeps the watchdog fed
+ *
+ * fewer than SCHED_IDLE_MIN_TICKS to go and it isn't worth reprogramming the timer, the core
+ * just sleeps until the next tick
+ */
+#ifndef SCHED_IDLE_MIN_TICKS
+#define SCHED_IDLE_MIN_TICKS    2
+#endif
+
+typedef struct sched_idle_stats_t {
+    uint32_t sleeps;
+    uint32_t idle_ticks;                /* ticks slept through with the tick stretched */
+    uint32_t ticks;                     /* all ticks so far, idle_ticks / ticks is the residency */
+    uint32_t wake_cycles_last;          /* wfi returning to the waking interrupt being taken */
+    uint32_t wake_cycles_max;
+} sched_idle_stats_t;
+
+/* work an ISR leaves for PendSV, run(arg) once however many times it's deferred before then */
+typedef struct sched_deferred_t {
+    struct sched_deferred_t* next;
+    volatile uint32_t queued;
+    void (*run)(void* arg);
+    void* arg;
+} sched_deferred_t;
+
+typedef struct sched_t {
+    volatile tcb_t* volatile current;   /* offset 0, context_switch.s reads both of these */
+    volatile tcb_t* volatile next;      /* offset 4, differs from current while a switch is pending */
+    uint32_t switch_stamp;              /* offset 8, cycle count at the last switch */
+    volatile uint32_t* cycle_source;    /* offset 12, what context_switch.s reads it from */
+    taskbuff_t* tasks;
+    sched_deferred_t* volatile deferred;
+
+    uint32_t ready_map;
+    volatile tcb_t* ready_head[SCHED_PRIORITIES];
+    volatile tcb_t* ready_tail[SCHED_PRIORITIES];
+
+    sched_heap_t edf_ready;
+    sched_heap_t edf_waiting;
+    uint32_t edf_util_ppm;              /* admitted so far */
+
+    ktimer_wheel_t timers;
+
+    volatile uint32_t ticks;
+    volatile uint32_t tick_wraps;       /* high word of the clock */
+    volatile uint32_t switches;
+    sched_idle_stats_t idle;
+    bool started;                       /* tasks only queue up until sched_start */
+} sched_t;
+
+#if !defined(SPRINTER_HOST)
+_Static_assert(offsetof(sched_t, current) == 0 && offsetof(sched_t, next) == 4 &&
+               offsetof(sched_t, switch_stamp) == 8 && offsetof(sched_t, cycle_source) == 12,
+               "context_switch.s depends on the sched_t layout");
+#endif
+_Static_assert(SCHED_PRIORITIES <= 32, "ready_map is a single word");
+
+extern sched_t scheduler;
+
+int sched_init(taskbuff_t* tasks);
+
+/*
+ * switches to the highest priority READY task, never returns. _main's stack is abandoned.
+ * host builds only make the first pick and return, nothing actually runs there
+ */
+void sched_start(void);
+
+/* task is now READY (new, or woken up), preempts the running task if it outranks it */
+void sched_ready(volatile tcb_t* task);
+
+/*
+ * takes a task off the cpu, its ready queue or whatever it's waiting on and leaves it in status
+ * (SUSPENDED or NULL)
+ */
+void sched_block(volatile tcb_t* task, enum Status status);
+
+/*
+ * moves a task to another fixed priority wherever it is, a READY one changes queues and a
+ * RUNNING one that drops below something READY is preempted. base_priority stays as it is,
+ * this is for priority inheritance (mutex.h)
+ */
+void sched_set_priority(volatile tcb_t* task, uint8_t priority);
+
+/*
+ * blocking on kernel objects. the object sets up tcb.wait and queues the running task on its
+ * waiters, then sched_wait blocks it, for at most timeout ticks unless it's SCHED_WAIT_FOREVER.
+ * called with interrupts masked, the task is switched away once they're back on and returns
+ * from there when it's woken. the object wakes it with sched_wake, a timeout runs wait.cancel
+ * and wakes it with wait.value 0. timeouts need the tick
+ */
+void sched_wait(uint32_t timeout);
+void sched_wake(volatile tcb_t* task, uint32_t value);
+
+/*
+ * waiters queued highest priority first and FIFO among equals, on the ready links since a
+ * BLOCKED task isn't on a ready queue. EDF tasks go ahead of every fixed priority one.
+ * interrupts masked
+ */
+static inline uint8_t sched_rank(volatile tcb_t* task) {
+    return (task->edf.period != 0) ? (SCHED_PRIORITIES - 1) : task->priority;
+}
+
+void sched_waitq_add(volatile tcb_t** head, volatile tcb_t* task);
+void sched_waitq_remove(volatile tcb_t** head, volatile tcb_t* task);
+
+/* from anywhere, ISRs included, nothing is masked. PendSV calls sched_run_deferred */
+void sched_defer(sched_deferred_t* work);
+void sched_run_deferred(void);
+
+/* gives up the rest of this slice to the next task of the same priority */
+void sched_yield(void);
+
+/*
+ * EDF admission, reserves the task's share or returns _NOP if the set wouldn't be schedulable.
+ * create_rt_task does this, remove_task gives it back. needs the tick, _ERR with SCHED_TICK_HZ 0
+ */
+int sched_admit(tcb_t* task);
+void sched_unadmit(volatile tcb_t* task);
+
+/* an EDF task's job is done, it waits for its next release */
+void sched_wait_period(void);
+
+/*
+ * clock and timers. sched_clock_us counts from sched_start and doesn't wrap, it's 0 without a
+ * tick. timers are set up with _ktimer_setup and their callbacks run in the tick
+ */
+uint64_t sched_clock_us(void);
+int sched_timer_start(ktimer_t* timer, uint32_t delay, uint32_t period);
+int sched_timer_cancel(ktimer_t* timer);
+
+/* the running task sleeps for ticks, or until scheduler.ticks reaches tick */
+void sched_sleep(uint32_t ticks);
+void sched_sleep_until(uint32_t tick);
+
+/* sleeps until there's something to do, only makes sense from the idle task */
+void sched_idle(void);
+int sched_idle_stats(sched_idle_stats_t* stats);
+
+/* what a task's ptask returns into, removes it and switches away */
+void sched_exit(void);
+
+/* exception handlers, in the vector table */
+void SysTick_Handler(void);
+void PendSV_Handler(void);
+
+#endif /* __SCHED_H__ */
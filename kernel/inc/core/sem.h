@@ -0,0 +1,52 @@
+#ifndef __SEM_H__
+#define __SEM_H__
+
+#include <stdint.h>
+
+#include "sched.h"
+#include "sprinter_common.h"
+#include "tcb.h"
+
+/*
+ * counting semaphores, for ISRs to tell tasks something's done
+ *
+ * count only ever changes through port_cas, so sem_give is lock free and can come from any
+ * ISR at any priority, or a task. a give that finds tasks waiting doesn't wake them itself, it
+ * defers the semaphore to PendSV (sched_defer) which hands the counts out highest priority
+ * waiter first. a task that has to wait queues itself with interrupts masked and then looks
+ * at count once more, so a give can't slip in between and be missed
+ *
+ * sem_take blocks for up to timeout ticks (SCHED_WAIT_FOREVER, or 0 to not wait at all)
+ */
+typedef struct sem_stats_t {
+    uint32_t blocked;              /* takes that had to wait */
+    uint32_t woken;                /* waiters handed a count */
+    uint32_t timeouts;             /* waits that timed out or were cancelled */
+    uint32_t waiters_max;
+} sem_stats_t;
+
+typedef struct sem_t {
+    volatile uint32_t count;
+    uint32_t max;
+    volatile tcb_t* waiters;       /* highest priority first */
+    uint32_t waiting;
+    sched_deferred_t wake;
+    sem_stats_t stats;
+} sem_t;
+
+/* count to start at, gives past max are turned away */
+int sem_init(sem_t* sem, uint32_t count, uint32_t max);
+
+/* _NOP at max, from anywhere */
+int sem_give(sem_t* sem);
+
+/* tasks only, _NOP if it timed out or the task was suspended while it waited */
+int sem_take(sem_t* sem, uint32_t timeout);
+
+static inline uint32_t sem_count(const sem_t* sem) {
+    return sem->count;
+}
+
+int sem_stats(const sem_t* sem, sem_stats_t* stats);
+
+#endif /* __SEM_H__ */
@@ -0,0 +1,84 @@
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include <stdint.h>
+
+#include "sprinter_common.h"
+
+/*
+ * slab layer over the buddy heap for small objects
+ * a slab is one 1 KB buddy block with a header at the front and the rest carved into objects
+ * of a single size. every request up to SLAB_MAX_OBJ_SIZE_B is routed here by _malloc, so a
+ * 24 B message takes 32 B instead of a whole 256 B min block
+ *
+ *  class | object size | objects per slab
+ * -------+-------------+-----------------
+ *    0   |        16 B |       62
+ *    1   |        32 B |       31
+ *    2   |        64 B |       15
+ *    3   |       128 B |        7
+ * -------+-------------+-----------------
+ *
+ * slabs belong to a task like any other block (so _free_all_owned takes them back), each
+ * cache keeps a list of partially used slabs per owner. a slab has a bit per object that's set
+ * while it's handed out, alloc takes the lowest clear one (a ctz on one of two words) and free
+ * only takes back an object whose bit is set, so freeing one twice is turned away
+ */
+#define SLAB_PAGE_SIZE_B        1024
+#define SLAB_HEADER_SIZE_B      32
+#define SLAB_MIN_OBJ_SIZE_B     16
+#define SLAB_MAX_OBJ_SIZE_B     128
+#define SLAB_CLASSES            (__builtin_ctz(SLAB_MAX_OBJ_SIZE_B) - __builtin_ctz(SLAB_MIN_OBJ_SIZE_B) + 1)
+#define SLAB_OWNER_LISTS        (MAX_TASKS + 1)     /* last list is for kernel owned slabs */
+#define SLAB_USED_WORDS         2
+
+typedef struct slab_t {
+    struct slab_t* next;           /* partial list links */
+    struct slab_t* prev;
+    uint32_t used[SLAB_USED_WORDS];     /* a bit per object, set while it's handed out */
+    uint16_t in_use;               /* objects handed out */
+    uint8_t class_id;
+    uint8_t owner;
+} slab_t;
+
+_Static_assert(sizeof(slab_t) <= SLAB_HEADER_SIZE_B, "slab header does not fit in front of the objects");
+_Static_assert((SLAB_PAGE_SIZE_B - SLAB_HEADER_SIZE_B) / SLAB_MIN_OBJ_SIZE_B <= 32 * SLAB_USED_WORDS,
+               "not enough used bits for the smallest class");
+
+typedef struct slab_stats_t {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;             /* no slab could be had from the buddy heap */
+    uint32_t objs_in_use;
+    uint32_t slabs;                /* slabs held, including the cached empty one */
+} slab_stats_t;
+
+typedef struct slab_cache_t {
+    slab_t* partial[SLAB_OWNER_LISTS];
+    slab_t* empty;                 /* one empty slab kept around so alloc/free at a boundary doesn't thrash */
+    uint16_t obj_size;
+    uint16_t objs_per_slab;
+    slab_stats_t stats;
+} slab_cache_t;
+
+/*
+ * the heap manager embeds the caches (along with a map of which pages are slabs), these are
+ * called by _minit, _malloc, _free and _free_all_owned. _slab_shrink and _slab_stats are for
+ * the rest of the kernel
+ */
+struct heap_manager;
+
+void _slab_init(struct heap_manager* heap_mgr);
+address_t _slab_alloc(struct heap_manager* heap_mgr, memsize_t req_size, tid_t requestor);
+int _slab_free(struct heap_manager* heap_mgr, address_t target);
+int _slab_owns(const struct heap_manager* heap_mgr, address_t target);
+/* MEM_OWNER_NONE unless target is the start of an object that's handed out */
+tid_t _slab_owner(const struct heap_manager* heap_mgr, address_t target);
+void _slab_reclaim(struct heap_manager* heap_mgr, address_t target);
+memsize_t _slab_obj_size(struct heap_manager* heap_mgr, address_t target);
+
+/* hands every cached empty slab back to the buddy heap */
+void _slab_shrink(struct heap_manager* heap_mgr);
+int _slab_stats(struct heap_manager* heap_mgr, uint32_t class_id, slab_stats_t* stats);
+
+#endif /* __SLAB_H__ */
@@ -6,7 +6,8 @@
 /* general constants */
 #define TID_NULL        (-1)         /* nulltask tid */
 #define MAX_TASKS       16           /* max tasks system will support */
-#define STACK_SIZE      0x1000       /* 4KB static blocks for now */
+#define STACK_SIZE      0x1000       /* default task stack, any power of two from 512 B works */
+#define CPU_CLOCK_HZ    180000000    /* set up by the bootloader */
 
 /*
  * error codes
@@ -32,7 +33,7 @@ typedef uint32_t memsize_t;
  */
 static inline uint32_t round_up_to_power_of_2(uint32_t val) {
     if (val <= 1) { return 1; }
-    return (1 << (sizeof(uint32_t) * 8 - __builtin_clz(val - 1)));
+    return (1u << ((sizeof(uint32_t) * 8) - (uint32_t)__builtin_clz(val - 1)));
 }
 
 #endif /* __SPRINTER_COMMON_H__ */
@@ -0,0 +1,64 @@
+#ifndef __STACK_H__
+#define __STACK_H__
+
+#include <stdint.h>
+
+#include "mem.h"
+#include "sprinter_common.h"
+
+/*
+ * task stack arena, the part of userspace above the heap (USERSPACE_STACKS_START_ADDR -
+ * USERSPACE_END_ADDR, see mem.h), handed out in STACK_CHUNK_B chunks
+ *
+ * a stack is rounded up to a power of two and aligned to its own size, so a 512 B I/O task
+ * takes 512 B instead of a 4 KB slot and every stack is something a single MPU region can
+ * cover. finding one walks the aligned candidates of that size in a chunk bitmap, at most
+ * USERSPACE_STACKS_SIZE_B / size of them, and a removed task's chunks are free for the next
+ * one straight away. the arena doesn't remember sizes, the tcb does
+ *
+ * none of this locks, call with interrupts masked or from handler mode
+ */
+#define STACK_CHUNK_B           512
+#define STACK_CHUNKS            (USERSPACE_STACKS_SIZE_B / STACK_CHUNK_B)
+#define STACK_MAP_WORDS         ((STACK_CHUNKS + 31) / 32)
+
+_Static_assert(STACK_CHUNKS > 0, "no room left in userspace for task stacks");
+
+typedef struct stack_stats_t {
+    memsize_t size;                /* bytes in the arena */
+    memsize_t used;
+    memsize_t high_water;
+    uint32_t stacks;               /* handed out right now */
+    uint32_t failures;             /* no aligned run of the size left */
+} stack_stats_t;
+
+typedef struct stack_arena_t {
+    address_t start;
+    uint32_t used_map[STACK_MAP_WORDS];     /* bit set per chunk in use */
+    stack_stats_t stats;
+} stack_arena_t;
+
+void _stack_init(stack_arena_t* arena);
+
+/* bottom of the stack or _ERR, size comes back rounded up to what was really taken */
+address_t _stack_alloc(stack_arena_t* arena, memsize_t* size);
+int _stack_free(stack_arena_t* arena, address_t bottom, memsize_t size);
+
+int _stack_stats(const stack_arena_t* arena, stack_stats_t* stats);
+
+/*
+ * high water marks
+ * a new stack is painted with STACK_PAINT_WORD and anything a task ever pushed overwrote some
+ * of it, so the lowest word that isn't paint anymore is how deep it went. stacks grow down and
+ * the untouched part is at the bottom, scanning up from there a word at a time stops at the
+ * first used one. a word that was used once stays used, so a rescan can also stop at an
+ * earlier mark (known) instead of going all the way
+ */
+#define STACK_PAINT_WORD        0x5AC5AC5Au
+
+void _stack_paint(address_t bottom, memsize_t size);
+
+/* bytes from the top down to the deepest word ever written, at least known */
+memsize_t _stack_used(address_t bottom, memsize_t size, memsize_t known);
+
+#endif /* __STACK_H__ */
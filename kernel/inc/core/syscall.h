@@ -0,0 +1,182 @@
+#ifndef __SYSCALL_H__
+#define __SYSCALL_H__
+
+#include <stdint.h>
+
+#include "kobj.h"
+#include "mem.h"
+#include "sprinter_common.h"
+#include "tcb.h"
+
+/*
+ * system calls, how unprivileged tasks (TASK_UNPRIVILEGED) get at the kernel
+ *
+ * svc #0 with the call number in r12 and up to 4 arguments in r0 - r3, the result comes back
+ * in r0. the hardware has stacked all of them on the task's psp by the time SVC_Handler
+ * (syscall_entry.s) runs, so all it does is hand that frame to syscall_dispatch, which is a
+ * bounds check and a call through a const table. the calls are thin wrappers over the kernel
+ * functions a privileged task calls directly
+ *
+ * SVC is taken at the tick's priority, above PendSV, so a call that switches away (yield,
+ * sleep, blocking) only pends the switch, and it's tail chained on the way out. a call that
+ * blocks (sem_take, event_wait, mutex_lock) can't wait in the handler either. its frame is
+ * left on tcb.syscall_frame and whatever wakes the task puts tcb.wait.value in the stacked r0
+ * (sched_ready), so those return nonzero for success and 0 for a timeout or a cancelled wait.
+ * the stubs below turn that back into _OK / _NOP. a message queue receive doesn't block over
+ * a system call, wait on a semaphore the sender gives instead
+ *
+ * message buffers are checked against the caller, they have to be on its own stack (above the
+ * guard) or be a heap block or slab object it owns, from its start. queues, semaphores and the
+ * rest are by handle (kobj.h), a privileged task makes them and hands the handles over, and a
+ * handle that doesn't name a live object of the right type gets _ERR. blocks from sys_malloc
+ * are the caller's but it only gets at them once they're granted (grant_task), until then it
+ * can only pass them on. an unprivileged task can only run or suspend itself
+ *
+ * every call is counted with the cycles spent in dispatch (syscall_stats). the entry and the
+ * exception return around it are the same for all of them, qemu_bench measures those
+ *
+ * tasks only, and not with interrupts masked, either way the svc escalates to a hard fault
+ */
+enum sys_call {
+    SYS_EXIT = 0,
+    SYS_YIELD,
+    SYS_TASK_ID,
+    SYS_TASK_RUN,
+    SYS_TASK_SUSPEND,
+    SYS_SLEEP,
+    SYS_TICKS,
+    SYS_MALLOC,
+    SYS_FREE,
+    SYS_MSGQ_SEND,
+    SYS_MSGQ_RECV,
+    SYS_MSGQ_SEND_BLOCK,
+    SYS_SEM_GIVE,
+    SYS_SEM_TAKE,
+    SYS_EVENT_SET,
+    SYS_EVENT_WAIT,
+    SYS_MUTEX_LOCK,
+    SYS_MUTEX_UNLOCK,
+    SYS_COUNT
+};
+
+/* the exception frame the hardware stacks, as syscall_dispatch sees it */
+#define SYSCALL_FRAME_WORDS     8
+#define SYSCALL_FRAME_CALL      4               /* r12 */
+
+typedef struct syscall_stats_t {
+    uint32_t calls;
+    uint32_t cycles_max;           /* in dispatch, 0 without a cycle counter */
+    uint64_t cycles_total;
+} syscall_stats_t;
+
+/* SVC_Handler's, frame is r0 - r3, r12, lr, pc, xpsr of the caller */
+void syscall_dispatch(volatile address_t* frame);
+
+/* _ERR for a call number past SYS_COUNT */
+int syscall_stats(uint32_t call, syscall_stats_t* stats);
+
+/* what an unprivileged task's ptask returns into (tcb_init_frame), the task is removed */
+void sys_exit(void);
+
+/*
+ * the caller's side. host builds have no svc, dispatch is called on a frame on the stack, and
+ * a call that blocks there is only completed while that frame is still around
+ */
+#if !defined(SPRINTER_HOST)
+static inline address_t syscall4(uint32_t call, address_t a0, address_t a1, address_t a2, address_t a3) {
+    register address_t r0 __asm__("r0") = a0;
+    register address_t r1 __asm__("r1") = a1;
+    register address_t r2 __asm__("r2") = a2;
+    register address_t r3 __asm__("r3") = a3;
+    register uint32_t r12 __asm__("r12") = call;
+    __asm__ volatile ("svc #0" : "+r" (r0) : "r" (r1), "r" (r2), "r" (r3), "r" (r12) : "memory");
+    return r0;
+}
+#else
+static inline address_t syscall4(uint32_t call, address_t a0, address_t a1, address_t a2, address_t a3) {
+    volatile address_t frame[SYSCALL_FRAME_WORDS] = { a0, a1, a2, a3, call, 0, 0, 0 };
+    syscall_dispatch(frame);
+    return frame[0];
+}
+#endif
+
+static inline void sys_yield(void) {
+    (void)syscall4(SYS_YIELD, 0, 0, 0, 0);
+}
+
+static inline tid_t sys_task_id(void) {
+    return (tid_t)syscall4(SYS_TASK_ID, 0, 0, 0, 0);
+}
+
+static inline int sys_task_run(tid_t tid) {
+    return (int)syscall4(SYS_TASK_RUN, tid, 0, 0, 0);
+}
+
+static inline int sys_task_suspend(tid_t tid) {
+    return (int)syscall4(SYS_TASK_SUSPEND, tid, 0, 0, 0);
+}
+
+static inline void sys_sleep(uint32_t ticks) {
+    (void)syscall4(SYS_SLEEP, ticks, 0, 0, 0);
+}
+
+static inline uint32_t sys_ticks(void) {
+    return (uint32_t)syscall4(SYS_TICKS, 0, 0, 0, 0);
+}
+
+/* (address_t)_ERR if it didn't fit, as _malloc */
+static inline address_t sys_malloc(memsize_t size) {
+    return syscall4(SYS_MALLOC, size, 0, 0, 0);
+}
+
+/* _NOP if the block isn't the caller's */
+static inline int sys_free(address_t block) {
+    return (int)syscall4(SYS_FREE, block, 0, 0, 0);
+}
+
+static inline int sys_msgq_send(kobj_t queue, const void* msg) {
+    return (int)syscall4(SYS_MSGQ_SEND, queue, (address_t)msg, 0, 0);
+}
+
+/* never blocks, _NOP if it's empty */
+static inline int sys_msgq_recv(kobj_t queue, void* msg) {
+    return (int)syscall4(SYS_MSGQ_RECV, queue, (address_t)msg, 0, 0);
+}
+
+static inline int sys_msgq_send_block(kobj_t queue, address_t block, tid_t to) {
+    return (int)syscall4(SYS_MSGQ_SEND_BLOCK, queue, block, to, 0);
+}
+
+static inline int sys_sem_give(kobj_t sem) {
+    return (int)syscall4(SYS_SEM_GIVE, sem, 0, 0, 0);
+}
+
+static inline int sys_sem_take(kobj_t sem, uint32_t timeout) {
+    return (syscall4(SYS_SEM_TAKE, sem, timeout, 0, 0) != 0) ? _OK : _NOP;
+}
+
+static inline int sys_event_set(kobj_t event, uint32_t flags) {
+    return (int)syscall4(SYS_EVENT_SET, event, flags, 0, 0);
+}
+
+static inline int sys_event_wait(kobj_t event, uint32_t flags, uint32_t options, uint32_t timeout,
+                                 uint32_t* woken_by) {
+    uint32_t got = (uint32_t)syscall4(SYS_EVENT_WAIT, event, flags, options, timeout);
+    if (got == 0) {
+        return _NOP;
+    }
+    if (woken_by != NULL) {
+        *woken_by = got;
+    }
+    return _OK;
+}
+
+static inline int sys_mutex_lock(kobj_t mutex, uint32_t timeout) {
+    return (syscall4(SYS_MUTEX_LOCK, mutex, timeout, 0, 0) != 0) ? _OK : _NOP;
+}
+
+static inline int sys_mutex_unlock(kobj_t mutex) {
+    return (int)syscall4(SYS_MUTEX_UNLOCK, mutex, 0, 0, 0);
+}
+
+#endif /* __SYSCALL_H__ */
@@ -1,16 +1,82 @@
 #ifndef __TCB_H__
 #define __TCB_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "ktimer.h"
 #include "sprinter_common.h"
 
+/*
+ * earliest deadline first class (see sched.h), all in ticks. period 0 is a fixed priority task
+ */
+typedef struct tcb_edf_t {
+    uint32_t period;
+    uint32_t deadline;             /* relative to each release, no more than period */
+    uint32_t budget;               /* worst case execution time per job */
+    uint32_t util_ppm;             /* budget / deadline as admitted */
+
+    uint32_t release;              /* this job's, or the next one's while waiting */
+    uint32_t abs_deadline;
+    uint32_t budget_left;
+    uint32_t heap_idx;             /* place in the ready or waiting heap */
+
+    uint32_t jobs;
+    uint32_t deadline_misses;      /* jobs finished after their deadline */
+    uint32_t overruns;             /* jobs throttled for running out of budget */
+} tcb_edf_t;
+
+/*
+ * cpu accounting. context_switch.s reads the cycle counter on every switch and adds what the
+ * outgoing task ran to its run_cycles, interrupts included, so root's share is the idle time
+ */
+typedef struct tcb_cpu_t {
+    uint64_t run_cycles;           /* context_switch.s */
+    uint32_t switches;             /* times switched in, context_switch.s */
+    uint32_t preemptions;          /* taken off while it could still run */
+    uint32_t voluntary;            /* gave the cpu up itself, yield, block, sleep */
+    uint64_t top_mark;             /* run_cycles at the last task_cpu_top */
+} tcb_cpu_t;
+
+/*
+ * what a BLOCKED task is blocked on. cancel takes it off obj's waiters when it's suspended,
+ * removed or times out instead of being woken by obj. value is up to obj, what the task waits
+ * for and then what it was woken with, a timeout leaves 0 (see sched_wait)
+ */
+struct tcb_t;
+struct mutex_t;
+
+typedef struct tcb_wait_t {
+    void (*cancel)(volatile struct tcb_t* task);
+    void* obj;
+    uint32_t since;                /* port_cycles when it started waiting, 0 if nobody asked */
+    uint32_t value;
+    uint32_t options;
+} tcb_wait_t;
+
+/* create_task flags */
+#define TASK_UNPRIVILEGED       (1u << 0)      /* thread mode without privilege, see mpu.h */
+
+/* per task mpu regions (see mpu.h), RBAR/RASR pairs PendSV copies straight into the mpu */
+#define TCB_MPU_REGIONS         4
+#define TCB_MPU_WORDS           (2 * TCB_MPU_REGIONS)
+
 typedef struct tcb_t {
+    /* context_switch.s reaches into these, keep them first and in this order */
+    address_t sp;                  /* saved psp while switched out */
+    volatile uint8_t fpu_used;     /* set by context_switch.s the first time it saves fp state */
+    uint8_t unprivileged;          /* runs with CONTROL.nPRIV set, TASK_UNPRIVILEGED */
+    uint32_t mpu[TCB_MPU_WORDS];
+    tcb_cpu_t cpu;
+
     enum Status {
         STATUS_NULL = 0,
         STATUS_READY = 1,
         STATUS_RUNNING = 2,
-        STATUS_SUSPENDED = 3
+        STATUS_SUSPENDED = 3,
+        STATUS_WAITING = 4,        /* blocked until the kernel wakes it (next period) */
+        STATUS_SLEEPING = 5,       /* on the timer wheel until tcb.sleep runs out */
+        STATUS_BLOCKED = 6         /* waiting on an ipc object, see tcb.wait */
     } status;
 
     void (*ptask)(void* args);     /* callback */
@@ -18,8 +84,61 @@ typedef struct tcb_t {
     address_t stack_high;          /* stating address of stack */
     tid_t tid;                     /* task id */
     memsize_t stack_size;          /* stack size */
+    memsize_t stack_peak;          /* deepest it's been seen going, see task_stack_usage */
+
+    /* scheduling, see sched.h */
+    uint8_t priority;              /* 0 lowest (root) to SCHED_PRIORITIES - 1 */
+    uint8_t base_priority;         /* as created, priority is higher while it's inheriting one */
+    uint16_t slice_left;           /* ticks left before round robin moves on */
+    volatile struct tcb_t* ready_next;
+    volatile struct tcb_t* ready_prev;
+    tcb_edf_t edf;
+    ktimer_t sleep;
+    tcb_wait_t wait;
+    struct mutex_t* boosting;      /* held mutexes that have waiters, see mutex.h */
+    uint32_t serial;               /* taskbuff_t.created when it was made, tells a reused tid apart */
+    volatile address_t* syscall_frame;  /* stacked r0 - r3 of the system call it's blocked in */
 } tcb_t;
 
+#if !defined(SPRINTER_HOST)
+#define TCB_FPU_USED_OFFSET     4
+#define TCB_UNPRIV_OFFSET       5
+#define TCB_MPU_OFFSET          8
+#define TCB_CYCLES_OFFSET       40
+#define TCB_SWITCHES_OFFSET     48
+_Static_assert(offsetof(tcb_t, sp) == 0 && offsetof(tcb_t, fpu_used) == TCB_FPU_USED_OFFSET &&
+               offsetof(tcb_t, unprivileged) == TCB_UNPRIV_OFFSET && offsetof(tcb_t, mpu) == TCB_MPU_OFFSET &&
+               offsetof(tcb_t, cpu.run_cycles) == TCB_CYCLES_OFFSET &&
+               offsetof(tcb_t, cpu.switches) == TCB_SWITCHES_OFFSET,
+               "context_switch.s depends on the tcb_t layout");
+#endif
+
+/*
+ * initial stack frame, laid out exactly like a task that was switched out by PendSV:
+ * the hardware frame the exception return pops, and under it what context_switch.s saves
+ *
+ *   stack_high ->  xPSR  PC  LR  R12  R3  R2  R1  R0        (hardware)
+ *                  EXC_RETURN  R11 - R4                     (software)
+ *          sp  ->
+ *
+ * a task that has touched the fpu since it was switched in gets the long frames instead,
+ * EXC_RETURN bit 4 clear. the hardware frame grows by S0 - S15 and FPSCR (lazily, the space is
+ * reserved but only written if someone else uses the fpu), the software one by S16 - S31
+ *
+ *   stack_high ->  (pad) FPSCR  S15 - S0  xPSR ... R0       (hardware)
+ *                  S31 - S16  EXC_RETURN  R11 - R4           (software)
+ *          sp  ->
+ *
+ * new tasks start on the short frame, so tasks that never use the fpu never pay for it
+ */
+#define TCB_HW_FRAME_WORDS      8
+#define TCB_SW_FRAME_WORDS      9
+#define TCB_XPSR_THUMB          0x01000000u
+#define TCB_EXC_RETURN_THREAD   0xFFFFFFFDu     /* thread mode, psp, no fp state */
+#define TCB_EXC_RETURN_NO_FP    (1u << 4)       /* clear when the frame has fp state */
+
+void tcb_init_frame(tcb_t* task, void (*exit)(void));
+
 /* root function callback */
 void root(void *args);
 
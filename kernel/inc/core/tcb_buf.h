@@ -3,20 +3,63 @@
 
 #include <stdint.h>
 
+#include "mem.h"
 #include "sprinter_common.h"
+#include "stack.h"
 #include "tcb.h"
 
 typedef struct taskbuff_t {
 	volatile tcb_t buffer[MAX_TASKS];
 	volatile uint32_t tasks_in_buf;
+	uint32_t free_slots[(MAX_TASKS + 31) / 32];     /* bit set per empty buffer slot */
+	heap_manager* heap_mgr;        /* where tasks' blocks are reclaimed from on removal */
+	stack_arena_t stacks;
+	tid_t scan_next;               /* task_stack_scan_next's place */
+	uint32_t created;              /* tasks made so far, each one's tcb.serial */
 } taskbuff_t; 
 
+typedef struct task_cpu_t {
+	tid_t tid;
+	uint8_t priority;
+	enum Status status;
+	uint64_t cycles;               /* all it's ever run */
+	uint64_t recent;               /* run since the last task_cpu_top */
+	uint32_t util_ppm;             /* recent over every task's recent */
+	uint32_t switches;
+	uint32_t preemptions;
+	uint32_t voluntary;
+} task_cpu_t;
+
+typedef struct task_stack_t {
+	memsize_t size;
+	memsize_t peak;                /* bytes from the top of the stack down to its deepest use */
+} task_stack_t;
+
 /**
  * @brief Task buffer user functionality
  */
-int create_task(taskbuff_t* tasks, void (*callback)(void*), void* args);
+int init_taskbuff(taskbuff_t* tasks, heap_manager* heap_mgr);
+int create_task(taskbuff_t* tasks, void (*callback)(void*), void* args, uint8_t priority,
+                memsize_t stack_size, uint32_t flags);
+int create_rt_task(taskbuff_t* tasks, void (*callback)(void*), void* args, uint32_t period,
+                   uint32_t deadline, uint32_t budget, memsize_t stack_size, uint32_t flags);
 int remove_task(taskbuff_t *tasks, tid_t target_tid);
-int run_task(taskbuff_t *tasks, tid_t target_tid, volatile tcb_t** current_task);
-int suspend_task(taskbuff_t *tasks, tid_t target_tid, volatile tcb_t** current_task);
+int run_task(taskbuff_t *tasks, tid_t target_tid);
+int suspend_task(taskbuff_t *tasks, tid_t target_tid);
+int grant_task(taskbuff_t *tasks, tid_t target_tid, address_t base, memsize_t size);
+
+/*
+ * stack high water marks, stacks are painted on create (see stack.h). task_stack_usage scans
+ * the task's stack right away, task_stack_scan_next scans the next task along on every call
+ * and is what root does while it's idle, so the marks stay roughly current for free
+ */
+int task_stack_usage(taskbuff_t *tasks, tid_t target_tid, task_stack_t* usage);
+void task_stack_scan_next(taskbuff_t *tasks);
+
+/*
+ * top, a line per live task into top (at most max of them, count says how many). the share is
+ * of the cycles run since the previous call, cycle counts are 0 under qemu
+ */
+int task_cpu_top(taskbuff_t *tasks, task_cpu_t* top, uint32_t max, uint32_t* count);
 
 #endif /* __TCB_BUF_H__ */
@@ -0,0 +1,22 @@
+#ifndef __SEMIHOST_H__
+#define __SEMIHOST_H__
+
+#include <stdint.h>
+
+/*
+ * arm semihosting, only for builds that run under a debugger or qemu (-semihosting). on a
+ * board without a debugger attached the bkpt faults, so nothing else may use this
+ */
+#define SEMIHOST_SYS_WRITEC                 0x03
+#define SEMIHOST_SYS_EXIT                   0x18
+#define SEMIHOST_ADP_APPLICATION_EXIT       0x20026     /* exit code 0 */
+#define SEMIHOST_ADP_RUNTIME_ERROR          0x20023     /* exit code 1 */
+
+static inline uint32_t semihost_call(uint32_t op, const void* arg) {
+	register uint32_t r0 __asm__("r0") = op;
+	register const void* r1 __asm__("r1") = arg;
+	__asm__ volatile ("bkpt 0xAB" : "+r" (r0) : "r" (r1) : "memory");
+	return r0;
+}
+
+#endif
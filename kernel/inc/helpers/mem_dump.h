@@ -0,0 +1,10 @@
+#ifndef __MEM_DUMP_H__
+#define __MEM_DUMP_H__
+
+#include "core/kmem.h"
+#include "core/mem.h"
+
+/* dumps the heap counters over uart, either argument can be NULL to skip it */
+void print_mem_stats(heap_manager* heap_mgr, const kmem_arena_t* kernel_mem);
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ ******************************************************************************
+ * @file      context_switch.s
+ * @author    Steven Mu
+ * @summary   PendSV handler, saves the outgoing task's r4-r11 and EXC_RETURN on
+ *            its psp stack and restores the incoming one's (see tcb.h for the
+ *            frame). the hardware already stacked r0-r3, r12, lr, pc, xpsr.
+ *            s16-s31 only go along for tasks whose EXC_RETURN says they have
+ *            fp state, the hardware's lazy stacking does the same for s0-s15.
+ *            the incoming task's mpu regions and privilege go in on the way
+ *            (see mpu.h). the cycles since the last switch are added to the
+ *            outgoing task's run_cycles (see tcb_cpu_t). work ISRs deferred
+ *            runs first (sched_run_deferred), it can wake tasks and change next
+ ******************************************************************************
+ */
+
+  .syntax unified
+  .cpu cortex-m7
+  .fpu fpv5-sp-d16
+  .thumb
+
+.global PendSV_Handler
+
+  .section .text.PendSV_Handler
+  .type PendSV_Handler, %function
+PendSV_Handler:
+  push  {r0, lr}              /* lr is EXC_RETURN, r0 keeps msp 8 byte aligned for the call */
+  bl    sched_run_deferred
+  pop   {r0, lr}
+
+  cpsid i
+  ldr   r2, =scheduler        /* r2 = &scheduler, current at +0 and next at +4 */
+  ldr   r1, [r2]
+  ldr   r3, [r2, #4]
+  cmp   r1, r3
+  beq   done                  /* only deferred work, or a switch that was undone since */
+  ldr   r3, [r2, #12]         /* scheduler.cycle_source */
+  ldr   r3, [r3]
+  ldr   r12, [r2, #8]         /* scheduler.switch_stamp */
+  str   r3, [r2, #8]
+  cbz   r1, restore           /* nothing running yet on the first switch */
+
+  sub   r12, r3, r12          /* what current just ran, into its 64 bit run_cycles */
+  ldrd  r0, r3, [r1, #40]     /* TCB_CYCLES_OFFSET */
+  adds  r0, r0, r12
+  adc   r3, r3, #0
+  strd  r0, r3, [r1, #40]
+
+  mrs   r0, psp
+  tst   lr, #0x10             /* EXC_RETURN bit 4 clear, the task used the fpu */
+  ittt  eq
+  vstmdbeq r0!, {s16-s31}     /* also makes the hardware write out its lazy s0-s15 */
+  moveq r3, #1
+  strbeq r3, [r1, #4]         /* current->fpu_used, TCB_FPU_USED_OFFSET */
+  stmdb r0!, {r4-r11, lr}
+  str   r0, [r1]              /* current->sp */
+
+restore:
+  ldr   r1, [r2, #4]
+  str   r1, [r2]              /* current = next */
+  ldr   r3, [r1, #48]         /* next->cpu.switches, TCB_SWITCHES_OFFSET */
+  add   r3, r3, #1
+  str   r3, [r1, #48]
+
+  /* regions 4-7, stack, grants and guard, as 4 RBAR/RASR pairs through the aliases */
+  add   r3, r1, #8            /* next->mpu, TCB_MPU_OFFSET */
+  ldmia r3, {r4-r11}
+  ldr   r3, =0xE000ED9C       /* MPU->RBAR */
+  stmia r3, {r4-r11}
+
+  /* CONTROL.nPRIV from next->unprivileged, the rest of CONTROL stays */
+  ldrb  r3, [r1, #5]          /* TCB_UNPRIV_OFFSET */
+  mrs   r12, control
+  bic   r12, r12, #1
+  orr   r12, r12, r3
+  msr   control, r12
+  dsb
+  isb
+
+  ldr   r0, [r1]              /* next->sp */
+  ldmia r0!, {r4-r11, lr}
+  tst   lr, #0x10
+  it    eq
+  vldmiaeq r0!, {s16-s31}
+  msr   psp, r0
+done:
+  cpsie i
+  bx    lr
+  .size PendSV_Handler, .-PendSV_Handler
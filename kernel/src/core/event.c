@@ -0,0 +1,150 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/event.h"
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sprinter_common.h"
+#include "core/tcb.h"
+
+static void wake_waiters(void* arg);
+
+int event_init(event_t* event) {
+    if (event == NULL) {
+        return _ERR;
+    }
+
+    event->flags = 0;
+    event->waiters = NULL;
+    event->waiting = 0;
+    event->wake = (sched_deferred_t){ NULL, 0, wake_waiters, event };
+    event->stats = (event_stats_t){ 0 };
+
+    return _OK;
+}
+
+/* the flags that satisfy a wait for want, 0 if they aren't all there yet. EVENT_CLEAR takes them */
+static uint32_t match(event_t* event, uint32_t want, uint32_t options) {
+    uint32_t flags;
+    uint32_t got;
+
+    do {
+        flags = event->flags;
+        got = flags & want;
+        if ((options & EVENT_ALL) ? (got != want) : (got == 0)) {
+            return 0;
+        }
+        if (!(options & EVENT_CLEAR)) {
+            return got;
+        }
+    } while (!port_cas(&event->flags, flags, flags & ~got));
+
+    return got;
+}
+
+/* from PendSV with interrupts masked */
+static void wake_waiters(void* arg) {
+    event_t* event = arg;
+    volatile tcb_t* task = event->waiters;
+
+    while (task != NULL) {
+        volatile tcb_t* next = task->ready_next;
+        uint32_t got = match(event, task->wait.value, task->wait.options);
+        if (got != 0) {
+            sched_waitq_remove(&event->waiters, task);
+            event->waiting--;
+            event->stats.woken++;
+            sched_wake(task, got);
+        }
+        task = next;
+    }
+}
+
+/* timed out, suspended or removed while it waited */
+static void cancel_wait(volatile tcb_t* task) {
+    event_t* event = task->wait.obj;
+
+    sched_waitq_remove(&event->waiters, task);
+    event->waiting--;
+    event->stats.timeouts++;
+}
+
+int event_set(event_t* event, uint32_t flags) {
+    if (event == NULL) {
+        return _ERR;
+    }
+
+    uint32_t was;
+    do {
+        was = event->flags;
+    } while (!port_cas(&event->flags, was, was | flags));
+
+    if (event->waiters != NULL) {
+        sched_defer(&event->wake);
+    }
+    return _OK;
+}
+
+int event_clear(event_t* event, uint32_t flags) {
+    if (event == NULL) {
+        return _ERR;
+    }
+
+    uint32_t was;
+    do {
+        was = event->flags;
+    } while (!port_cas(&event->flags, was, was & ~flags));
+
+    return _OK;
+}
+
+int event_wait(event_t* event, uint32_t flags, uint32_t options, uint32_t timeout, uint32_t* woken_by) {
+    if (event == NULL || flags == 0) {
+        return _ERR;
+    }
+
+    uint32_t got = match(event, flags, options);
+    if (got == 0 && timeout != 0) {
+        /* queued before the last look, a set after it sees the waiter */
+        uint32_t primask = port_irq_save();
+        got = match(event, flags, options);
+        if (got == 0) {
+            volatile tcb_t* self = scheduler.current;
+            sched_waitq_add(&event->waiters, self);
+            self->wait = (tcb_wait_t){ cancel_wait, event, port_cycles(), flags, options };
+            event->waiting++;
+            event->stats.blocked++;
+            if (event->waiting > event->stats.waiters_max) {
+                event->stats.waiters_max = event->waiting;
+            }
+            sched_wait(timeout);
+            port_irq_restore(primask);
+
+            /* back once wake_waiters left the flags that did it, or it stopped waiting */
+            got = self->wait.value;
+        } else {
+            port_irq_restore(primask);
+        }
+    }
+
+    if (got == 0) {
+        return _NOP;
+    }
+    if (woken_by != NULL) {
+        *woken_by = got;
+    }
+    return _OK;
+}
+
+int event_stats(const event_t* event, event_stats_t* stats) {
+    if (event == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    *stats = event->stats;
+    port_irq_restore(primask);
+
+    return _OK;
+}
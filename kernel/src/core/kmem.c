@@ -0,0 +1,178 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sprinter_common.h"
+#include "kmem.h"
+
+static inline address_t align_up(address_t addr) {
+    return (addr + KMEM_ALIGN_B - 1) & ~(address_t)(KMEM_ALIGN_B - 1);
+}
+
+/*
+ * arena
+ */
+void _kminit(kmem_arena_t* arena) {
+    arena->start = align_up(KERNELSPACE_HEAP_START_ADDR);
+    arena->end = KERNELSPACE_HEAP_END_ADDR & ~(address_t)(KMEM_ALIGN_B - 1);
+    arena->top = arena->start;
+    arena->pools = NULL;
+
+    arena->stats = (kmem_stats_t){ 0 };
+    arena->stats.size = (memsize_t)(arena->end - arena->start);
+}
+
+void* _kmalloc(kmem_arena_t* arena, memsize_t size) {
+    if (arena == NULL || size == 0) {
+        return NULL;
+    }
+
+    address_t aligned = align_up(size);
+    if (aligned > arena->end - arena->top) {
+        arena->stats.failures++;
+        return NULL;
+    }
+
+    void* obj = (void*)arena->top;
+    arena->top += aligned;
+
+    arena->stats.allocs++;
+    arena->stats.used = (memsize_t)(arena->top - arena->start);
+    if (arena->stats.used > arena->stats.high_water) {
+        arena->stats.high_water = arena->stats.used;
+    }
+
+    return obj;
+}
+
+address_t _kmark(const kmem_arena_t* arena) {
+    return arena->top;
+}
+
+/* everything bumped off after mark is gone, including objects pools carved in the meantime */
+int _krelease(kmem_arena_t* arena, address_t mark) {
+    if (arena == NULL) {
+        return _ERR;
+    }
+    if (mark < arena->start || mark > arena->top) {
+        return _NOP;
+    }
+
+    arena->top = mark;
+    arena->stats.used = (memsize_t)(arena->top - arena->start);
+
+    return _OK;
+}
+
+/*
+ * pools
+ */
+static int pool_grow(kmem_pool_t* pool, uint32_t count) {
+    uint8_t* chunk = _kmalloc(pool->arena, (memsize_t)(count * pool->obj_size));
+    if (chunk == NULL) {
+        return _ERR;
+    }
+
+    /* thread the new objects onto the free list back to front so they go out in address order */
+    for (uint32_t i = count; i > 0; i--) {
+        void* obj = chunk + ((i - 1) * pool->obj_size);
+        *(void**)obj = pool->free_list;
+        pool->free_list = obj;
+    }
+    pool->stats.capacity += count;
+
+    return _OK;
+}
+
+int _kpool_init(kmem_arena_t* arena, kmem_pool_t* pool, const char* name,
+                memsize_t obj_size, uint32_t prealloc, uint32_t batch) {
+    if (arena == NULL || pool == NULL || obj_size == 0) {
+        return _ERR;
+    }
+
+    /* a free object has to hold the list link */
+    if (obj_size < sizeof(void*)) {
+        obj_size = sizeof(void*);
+    }
+    obj_size = (memsize_t)align_up(obj_size);
+    if (obj_size > UINT16_MAX) {
+        return _ERR;
+    }
+
+    pool->arena = arena;
+    pool->name = name;
+    pool->free_list = NULL;
+    pool->obj_size = (uint16_t)obj_size;
+    pool->batch = (uint16_t)((batch == 0) ? 1 : batch);
+    pool->stats = (kmem_pool_stats_t){ 0 };
+
+    if (prealloc != 0 && pool_grow(pool, prealloc)) {
+        return _ERR;
+    }
+
+    pool->next = arena->pools;
+    arena->pools = pool;
+
+    return _OK;
+}
+
+void* _kpool_alloc(kmem_pool_t* pool) {
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (pool->free_list == NULL && pool_grow(pool, pool->batch)) {
+        pool->stats.failures++;
+        return NULL;
+    }
+
+    void* obj = pool->free_list;
+    pool->free_list = *(void**)obj;
+
+    pool->stats.allocs++;
+    pool->stats.in_use++;
+    if (pool->stats.in_use > pool->stats.high_water) {
+        pool->stats.high_water = pool->stats.in_use;
+    }
+
+    return obj;
+}
+
+int _kpool_free(kmem_pool_t* pool, void* obj) {
+    if (pool == NULL || obj == NULL) {
+        return _ERR;
+    }
+
+    /* has to at least come from this arena and be on an object boundary of some batch */
+    address_t addr = (address_t)obj;
+    if (addr < pool->arena->start || addr >= pool->arena->top ||
+        (addr & (KMEM_ALIGN_B - 1)) != 0 || pool->stats.in_use == 0) {
+        return _NOP;
+    }
+
+    *(void**)obj = pool->free_list;
+    pool->free_list = obj;
+
+    pool->stats.frees++;
+    pool->stats.in_use--;
+
+    return _OK;
+}
+
+int _kmstats(const kmem_arena_t* arena, kmem_stats_t* stats) {
+    if (arena == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    *stats = arena->stats;
+    return _OK;
+}
+
+int _kpool_stats(const kmem_pool_t* pool, kmem_pool_stats_t* stats) {
+    if (pool == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    *stats = pool->stats;
+    return _OK;
+}
@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "core/event.h"
+#include "core/kmem.h"
+#include "core/kobj.h"
+#include "core/ktimer.h"
+#include "core/msgq.h"
+#include "core/mutex.h"
+#include "core/port.h"
+#include "core/sem.h"
+#include "core/sprinter_common.h"
+
+static kobj_table_t kobjs;
+
+static const char* const names[KOBJ_TYPES] = {
+    [KOBJ_MSGQ]  = "msgq",
+    [KOBJ_SEM]   = "sem",
+    [KOBJ_EVENT] = "event",
+    [KOBJ_MUTEX] = "mutex",
+    [KOBJ_TIMER] = "timer",
+};
+
+static const memsize_t sizes[KOBJ_TYPES] = {
+    [KOBJ_MSGQ]  = sizeof(msgq_t),
+    [KOBJ_SEM]   = sizeof(sem_t),
+    [KOBJ_EVENT] = sizeof(event_t),
+    [KOBJ_MUTEX] = sizeof(mutex_t),
+    [KOBJ_TIMER] = sizeof(ktimer_t),
+};
+
+static inline kobj_t handle_of(uint32_t slot) {
+    return ((uint32_t)kobjs.entries[slot].gen << KOBJ_GEN_SHIFT) | (slot + 1);
+}
+
+/* the entry a handle names, NULL if it's out of range, free or from before the slot was reused */
+static kobj_entry_t* entry_of(kobj_t handle) {
+    uint32_t slot = (handle & KOBJ_SLOT_MASK) - 1;
+    if (slot >= KOBJ_MAX) {
+        return NULL;
+    }
+
+    kobj_entry_t* entry = &kobjs.entries[slot];
+    if (entry->obj == NULL || (handle >> KOBJ_GEN_SHIFT) != entry->gen) {
+        return NULL;
+    }
+    return entry;
+}
+
+/* deleting one that's still in use would leave tasks queued on, or a wheel linked to, a free object */
+static bool busy(const kobj_entry_t* entry) {
+    switch (entry->type) {
+        case KOBJ_MSGQ:
+            return ((const msgq_t*)entry->obj)->waiter != NULL;
+        case KOBJ_SEM:
+            return ((const sem_t*)entry->obj)->waiters != NULL;
+        case KOBJ_EVENT:
+            return ((const event_t*)entry->obj)->waiters != NULL;
+        case KOBJ_MUTEX:
+            return ((const mutex_t*)entry->obj)->owner != 0;
+        case KOBJ_TIMER:
+            return _ktimer_pending((const ktimer_t*)entry->obj);
+        default:
+            return false;
+    }
+}
+
+int kobj_init(kmem_arena_t* arena) {
+    if (arena == NULL) {
+        return _ERR;
+    }
+
+    memset(&kobjs, 0, sizeof(kobjs));
+    for (uint32_t w = 0; w < KOBJ_MAX / 32; w++) {
+        kobjs.free_slots[w] = 0xFFFFFFFFu;
+    }
+
+    for (uint32_t type = 0; type < KOBJ_TYPES; type++) {
+        if (_kpool_init(arena, &kobjs.pools[type], names[type], sizes[type], 0, KOBJ_POOL_BATCH)) {
+            return _ERR;
+        }
+    }
+
+    return _OK;
+}
+
+kobj_t kobj_new(enum kobj_type type) {
+    if ((uint32_t)type >= KOBJ_TYPES) {
+        return KOBJ_NULL;
+    }
+
+    kobj_t handle = KOBJ_NULL;
+    uint32_t primask = port_irq_save();
+
+    for (uint32_t w = 0; w < KOBJ_MAX / 32; w++) {
+        if (kobjs.free_slots[w] == 0) {
+            continue;
+        }
+
+        void* obj = _kpool_alloc(&kobjs.pools[type]);
+        if (obj == NULL) {
+            break;
+        }
+        memset(obj, 0, sizes[type]);
+        if (type == KOBJ_TIMER) {
+            _ktimer_setup(obj, NULL, NULL);
+        }
+
+        uint32_t slot = (w * 32) + (uint32_t)__builtin_ctz(kobjs.free_slots[w]);
+        kobjs.free_slots[w] &= ~(1u << (slot % 32));
+        kobjs.entries[slot].obj = obj;
+        kobjs.entries[slot].type = (uint8_t)type;
+        kobjs.live++;
+
+        handle = handle_of(slot);
+        break;
+    }
+
+    port_irq_restore(primask);
+    return handle;
+}
+
+void* kobj_get(kobj_t handle, enum kobj_type type) {
+    void* obj = NULL;
+    uint32_t primask = port_irq_save();
+
+    kobj_entry_t* entry = entry_of(handle);
+    if (entry != NULL && entry->type == (uint8_t)type) {
+        obj = entry->obj;
+    }
+
+    port_irq_restore(primask);
+    return obj;
+}
+
+int kobj_delete(kobj_t handle) {
+    int ret = _OK;
+    uint32_t primask = port_irq_save();
+
+    kobj_entry_t* entry = entry_of(handle);
+    if (entry == NULL) {
+        ret = _ERR;
+    } else if (busy(entry)) {
+        ret = _NOP;
+    } else {
+        uint32_t slot = (handle & KOBJ_SLOT_MASK) - 1;
+        (void)_kpool_free(&kobjs.pools[entry->type], entry->obj);
+        entry->obj = NULL;
+        entry->gen++;
+        kobjs.free_slots[slot / 32] |= 1u << (slot % 32);
+        kobjs.live--;
+    }
+
+    port_irq_restore(primask);
+    return ret;
+}
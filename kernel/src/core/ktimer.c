@@ -0,0 +1,201 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/ktimer.h"
+#include "core/sprinter_common.h"
+
+#define LEVEL_SHIFT(level)      ((level) * KTIMER_SLOT_BITS)
+#define SLOT_MASK               (KTIMER_SLOTS - 1)
+
+void _ktimer_init(ktimer_wheel_t* wheel, uint32_t now) {
+    wheel->now = now;
+    for (uint32_t level = 0; level < KTIMER_LEVELS; level++) {
+        wheel->occupied[level] = 0;
+        for (uint32_t slot = 0; slot < KTIMER_SLOTS; slot++) {
+            wheel->slots[level][slot] = NULL;
+        }
+    }
+    wheel->stats = (ktimer_stats_t){ 0 };
+}
+
+void _ktimer_setup(ktimer_t* timer, void (*callback)(void*), void* arg) {
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->period = 0;
+    timer->slot = KTIMER_IDLE;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+/*
+ * slot lists, NULL terminated both ways so a timer can unlink itself knowing only its slot
+ */
+static void slot_link(ktimer_wheel_t* wheel, ktimer_t* timer, uint32_t level, uint32_t slot) {
+    ktimer_t** head = &wheel->slots[level][slot];
+
+    timer->prev = NULL;
+    timer->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = timer;
+    }
+    *head = timer;
+    timer->slot = (uint16_t)((level * KTIMER_SLOTS) + slot);
+    wheel->occupied[level] |= (1ull << slot);
+}
+
+static void slot_unlink(ktimer_wheel_t* wheel, ktimer_t* timer) {
+    uint32_t level = timer->slot / KTIMER_SLOTS;
+    uint32_t slot = timer->slot % KTIMER_SLOTS;
+
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel->slots[level][slot] = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    if (wheel->slots[level][slot] == NULL) {
+        wheel->occupied[level] &= ~(1ull << slot);
+    }
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->slot = KTIMER_IDLE;
+}
+
+/* onto the lowest level its expiry is within reach of, past the top it goes round again */
+static void file(ktimer_wheel_t* wheel, ktimer_t* timer) {
+    uint32_t delta = timer->expires - wheel->now;
+    uint32_t level = 0;
+
+    while (level < KTIMER_LEVELS - 1 && delta >= (1u << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+    slot_link(wheel, timer, level, (timer->expires >> LEVEL_SHIFT(level)) & SLOT_MASK);
+}
+
+int _ktimer_start(ktimer_wheel_t* wheel, ktimer_t* timer, uint32_t delay, uint32_t period) {
+    if (wheel == NULL || timer == NULL || timer->callback == NULL) {
+        return _ERR;
+    }
+    /* tick counts are compared by their difference, so half the range is as far as it goes */
+    if (delay > INT32_MAX || period > INT32_MAX) {
+        return _NOP;
+    }
+
+    if (timer->slot != KTIMER_IDLE) {
+        slot_unlink(wheel, timer);
+    } else {
+        wheel->stats.pending++;
+    }
+    timer->expires = wheel->now + ((delay == 0) ? 1 : delay);
+    timer->period = period;
+    file(wheel, timer);
+    wheel->stats.started++;
+
+    return _OK;
+}
+
+int _ktimer_cancel(ktimer_wheel_t* wheel, ktimer_t* timer) {
+    if (wheel == NULL || timer == NULL) {
+        return _ERR;
+    }
+    if (timer->slot == KTIMER_IDLE) {
+        return _NOP;
+    }
+
+    slot_unlink(wheel, timer);
+    wheel->stats.cancelled++;
+    wheel->stats.pending--;
+
+    return _OK;
+}
+
+/* a whole slot one level down, nothing is called so it can be taken off in one go */
+static void cascade(ktimer_wheel_t* wheel, uint32_t level, uint32_t slot) {
+    ktimer_t* timer = wheel->slots[level][slot];
+
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ull << slot);
+    while (timer != NULL) {
+        ktimer_t* next = timer->next;
+        file(wheel, timer);
+        wheel->stats.cascaded++;
+        timer = next;
+    }
+}
+
+/*
+ * one tick. a callback can start or cancel any timer, this one included, so the slot is
+ * taken from the head each time rather than walked. nothing started from here lands back in
+ * it, a delay under KTIMER_SLOTS ticks always means a different slot
+ */
+static void run_tick(ktimer_wheel_t* wheel) {
+    uint32_t now = wheel->now;
+
+    for (uint32_t level = 1; level < KTIMER_LEVELS; level++) {
+        if ((now & ((1u << LEVEL_SHIFT(level)) - 1)) != 0) {
+            break;
+        }
+        cascade(wheel, level, (now >> LEVEL_SHIFT(level)) & SLOT_MASK);
+    }
+
+    ktimer_t** head = &wheel->slots[0][now & SLOT_MASK];
+    while (*head != NULL) {
+        ktimer_t* timer = *head;
+        slot_unlink(wheel, timer);
+
+        if (timer->period != 0) {
+            timer->expires += timer->period;
+            file(wheel, timer);
+        } else {
+            wheel->stats.pending--;
+        }
+        wheel->stats.fired++;
+        timer->callback(timer->arg);
+    }
+}
+
+void _ktimer_advance(ktimer_wheel_t* wheel, uint32_t now) {
+    while (wheel->now != now) {
+        wheel->now++;
+        run_tick(wheel);
+    }
+}
+
+/* next set bit after bit from, going round, as a distance 1 - KTIMER_SLOTS. map isn't 0 */
+static inline uint32_t next_occupied(uint64_t map, uint32_t from) {
+    uint32_t shift = (from + 1) & SLOT_MASK;
+    if (shift != 0) {
+        map = (map >> shift) | (map << (KTIMER_SLOTS - shift));
+    }
+    return (uint32_t)__builtin_ctzll(map) + 1;
+}
+
+uint32_t _ktimer_idle_ticks(const ktimer_wheel_t* wheel, uint32_t max) {
+    uint32_t ticks = max;
+
+    /* a slot at level n is next looked at when the ticks below level n next roll over into it */
+    for (uint32_t level = 0; level < KTIMER_LEVELS; level++) {
+        if (wheel->occupied[level] == 0) {
+            continue;
+        }
+        uint32_t base = wheel->now >> LEVEL_SHIFT(level);
+        uint32_t due = (base + next_occupied(wheel->occupied[level], base & SLOT_MASK)) << LEVEL_SHIFT(level);
+        if (due - wheel->now < ticks) {
+            ticks = due - wheel->now;
+        }
+    }
+    return ticks;
+}
+
+int _ktimer_stats(const ktimer_wheel_t* wheel, ktimer_stats_t* stats) {
+    if (wheel == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    *stats = wheel->stats;
+    return _OK;
+}
@@ -2,52 +2,193 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "port.h"
 #include "sprinter_common.h"
 #include "mem.h"
 
-static void recursively_mark(heap_manager* heap_mgr, int i, node_state_t state) {
-    if (i >= MEM_BUDDY_MAX_BLOCKS) {
+/*
+ * packed node state helpers, 16 states per word
+ */
+static inline node_state_t get_state(const heap_manager* heap_mgr, uint32_t i) {
+    uint32_t shift = (i & 15) * MEM_BUDDY_STATE_BITS;
+    return (node_state_t)((heap_mgr->node_states[i >> 4] >> shift) & 0x3);
+}
+
+static inline void set_state(heap_manager* heap_mgr, uint32_t i, node_state_t state) {
+    uint32_t shift = (i & 15) * MEM_BUDDY_STATE_BITS;
+    heap_mgr->node_states[i >> 4] = (heap_mgr->node_states[i >> 4] & ~(0x3u << shift)) |
+                                    ((uint32_t)state << shift);
+}
+
+/*
+ * free bitmap helpers
+ * node i lives at bit (i + 1) so every layer from 5 down is word aligned, see mem.h
+ */
+static inline uint32_t node_layer(uint32_t i) {
+    return (uint32_t)(31 - __builtin_clz(i + 1));
+}
+
+static void set_free(heap_manager* heap_mgr, uint32_t i) {
+    uint32_t n = i + 1;
+    uint32_t layer = node_layer(i);
+
+    heap_mgr->free_map[n >> 5] |= (1u << (n & 31));
+    heap_mgr->free_summary[n >> 10] |= (1u << ((n >> 5) & 31));
+    heap_mgr->free_count[layer]++;
+    heap_mgr->layer_mask |= (1u << layer);
+}
+
+static void clear_free(heap_manager* heap_mgr, uint32_t i) {
+    uint32_t n = i + 1;
+    uint32_t layer = node_layer(i);
+
+    heap_mgr->free_map[n >> 5] &= ~(1u << (n & 31));
+    if (heap_mgr->free_map[n >> 5] == 0) {
+        heap_mgr->free_summary[n >> 10] &= ~(1u << ((n >> 5) & 31));
+    }
+    if (--heap_mgr->free_count[layer] == 0) {
+        heap_mgr->layer_mask &= ~(1u << layer);
+    }
+}
+
+/* lowest free node in a layer, caller guarantees the layer has one (layer_mask) */
+static uint32_t first_free_in_layer(heap_manager* heap_mgr, uint32_t layer) {
+    uint32_t first = 1u << layer;
+
+    /* layers 0-4 all share word 0 */
+    if (first < 32) {
+        uint32_t bits = heap_mgr->free_map[0] & (((1u << first) - 1) << first);
+        return (uint32_t)__builtin_ctz(bits) - 1;
+    }
+
+    /* otherwise the layer owns words [first/32, first/16), find a word with a free bit in it */
+    uint32_t w = first >> 5;
+    uint32_t words_left = w;
+    while (1) {
+        uint32_t summary = heap_mgr->free_summary[w >> 5] >> (w & 31);
+        if (words_left < 32) {
+            summary &= (1u << words_left) - 1;
+        }
+        if (summary != 0) {
+            w += (uint32_t)__builtin_ctz(summary);
+            break;
+        }
+        w += 32;
+        words_left -= 32;
+    }
+
+    return (w << 5) + (uint32_t)__builtin_ctz(heap_mgr->free_map[w]) - 1;
+}
+
+/*
+ * owner index helpers, slot is the min block a USED block starts at. only those slots ever
+ * hold an owner, the rest of a block's are MEM_OWNER_NONE
+ */
+static uint32_t owned_slot(const heap_manager* heap_mgr, uint32_t page, tid_t owner) {
+    uint32_t slot = page * MEM_OWNER_PAGE_SLOTS;
+    for (uint32_t s = 0; s < MEM_OWNER_PAGE_SLOTS; s++) {
+        if (heap_mgr->owners[slot + s] == owner) {
+            return slot + s;
+        }
+    }
+    return MEM_BUDDY_MIN_BLOCKS;
+}
+
+static void clear_page(heap_manager* heap_mgr, uint32_t page, tid_t owner) {
+    uint32_t w = page >> 5;
+    heap_mgr->owned_map[owner][w] &= ~(1u << (page & 31));
+    if (heap_mgr->owned_map[owner][w] == 0) {
+        heap_mgr->owned_summary[owner] &= ~(1u << w);
+    }
+}
+
+static void set_owner(heap_manager* heap_mgr, uint32_t slot, tid_t owner) {
+    heap_mgr->owners[slot] = (uint8_t)owner;
+    if (owner >= MAX_TASKS) {
         return;
+    }
+
+    uint32_t page = slot / MEM_OWNER_PAGE_SLOTS;
+    uint32_t w = page >> 5;
+    if ((heap_mgr->owned_summary[owner] & (1u << w)) == 0) {
+        heap_mgr->owned_map[owner][w] = 1u << (page & 31);
+        heap_mgr->owned_summary[owner] |= (1u << w);
     } else {
-        heap_mgr->mem_nodes[i].state = state;
+        heap_mgr->owned_map[owner][w] |= 1u << (page & 31);
+    }
+}
+
+static void clear_owner(heap_manager* heap_mgr, uint32_t slot) {
+    uint32_t owner = heap_mgr->owners[slot];
+    heap_mgr->owners[slot] = MEM_OWNER_NONE;
+    if (owner >= MAX_TASKS) {
+        return;
+    }
+    mem_released(&heap_mgr->release, owner, USERSPACE_HEAP_START_ADDR + ((address_t)slot * MEM_BUDDY_MIN_BLOCK_SIZE_B));
 
-        recursively_mark(heap_mgr, (2 * i) + 1, state);
-        recursively_mark(heap_mgr, (2 * i) + 2, state);
+    /* the page stays in the index while another of its blocks is the owner's */
+    uint32_t page = slot / MEM_OWNER_PAGE_SLOTS;
+    if (owned_slot(heap_mgr, page, owner) == MEM_BUDDY_MIN_BLOCKS) {
+        clear_page(heap_mgr, page, owner);
     }
 }
 
 void _minit(heap_manager* heap_mgr) {
-    heap_mgr->mem_nodes[0].state = NODE_FREE;
-    recursively_mark(heap_mgr, 1, NODE_INVALID);
-    recursively_mark(heap_mgr, 2, NODE_INVALID);
+    for (uint32_t w = 0; w < MEM_BUDDY_MAP_WORDS; w++) {
+        heap_mgr->free_map[w] = 0;
+    }
+    for (uint32_t w = 0; w < MEM_BUDDY_SUMMARY_WORDS; w++) {
+        heap_mgr->free_summary[w] = 0;
+    }
+    for (uint32_t l = 0; l < MEM_BUDDY_LAYERS; l++) {
+        heap_mgr->free_count[l] = 0;
+    }
+    heap_mgr->layer_mask = 0;
+    for (uint32_t slot = 0; slot < MEM_BUDDY_MIN_BLOCKS; slot++) {
+        heap_mgr->owners[slot] = MEM_OWNER_NONE;
+    }
+    for (uint32_t t = 0; t < MAX_TASKS; t++) {
+        heap_mgr->owned_summary[t] = 0;
+    }
+    heap_mgr->counters = (mem_counters_t){ 0 };
+    heap_mgr->release = (mem_release_t){ 0 };
+
+    /* nothing below a FREE or USED node is ever looked at, so only the root needs a state */
+    set_state(heap_mgr, 0, NODE_FREE);
+    set_free(heap_mgr, 0);
+
+    _slab_init(heap_mgr);
 }
 
 /*
  * malloc and helper functions
- * basically the algorithm is check for free spots at layer
- * - if so, allocate and ensure all children are recursively invalid
- * - if not then recursively go up layers. If FREE, then split down however many times needed
+ * basically the algorithm is take the smallest free block that fits off the free bitmaps
+ * - if it's at the target layer, allocate it
+ * - if not then it's in a layer above. split down however many times needed
+ * the state of a node only means something while its parent is SPLIT, so a USED or FREE node
+ * implies the state of its whole subtree and nothing below it is ever touched
  */
-static address_t allocate(heap_manager* heap_mgr, tid_t requestor, int i, int layer) {
-    /* recusively mark children as invalid */
-    heap_mgr->mem_nodes[i].state = NODE_USED;
-    heap_mgr->mem_nodes[i].owner_tid = requestor;
-    recursively_mark(heap_mgr, (2 * i) + 1, NODE_INVALID);
-    recursively_mark(heap_mgr, (2 * i) + 2, NODE_INVALID);
-
-    /* return the address of the block allocated */
-    uint32_t start_index = (1 << layer) - 1;
+static address_t allocate(heap_manager* heap_mgr, tid_t requestor, uint32_t i, uint32_t layer) {
+    uint32_t start_index = (1u << layer) - 1;
     uint32_t offset_in_layer = i - start_index;
     memsize_t layer_block_size = USERSPACE_HEAP_SIZE >> layer;
 
+    set_state(heap_mgr, i, NODE_USED);
+    set_owner(heap_mgr, offset_in_layer << (MEM_BUDDY_MAX_LAYER_ID - layer), requestor);
+    mem_charge(&heap_mgr->counters, requestor, layer_block_size);
+
+    /* return the address of the block allocated */
     return (address_t)(USERSPACE_HEAP_START_ADDR + layer_block_size * offset_in_layer);
 }
 
-static uint32_t split(heap_manager* heap_mgr, memsize_t req_size, uint32_t i, uint32_t layer, uint32_t target_layer) {
+static uint32_t split(heap_manager* heap_mgr, uint32_t i, uint32_t layer, uint32_t target_layer) {
     while (layer < target_layer) {
-        heap_mgr->mem_nodes[i].state = NODE_SPLIT;
-        heap_mgr->mem_nodes[(2 * i) + 1].state = NODE_FREE;
-        heap_mgr->mem_nodes[(2 * i) + 2].state = NODE_FREE;
+        set_state(heap_mgr, i, NODE_SPLIT);
+        set_state(heap_mgr, (2 * i) + 1, NODE_FREE);
+        set_state(heap_mgr, (2 * i) + 2, NODE_FREE);
+
+        /* we keep walking down the left child, the right one goes on the free map */
+        set_free(heap_mgr, (2 * i) + 2);
 
         i = (2 * i) + 1;
         layer++;
@@ -56,9 +197,10 @@ static uint32_t split(heap_manager* heap_mgr, memsize_t req_size, uint32_t i, ui
     return i;
 }
 
-address_t _malloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
+/* straight to the buddy tree, the slab layer gets its pages through here */
+address_t _mblock_alloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
     if ((req_size == 0) || (req_size > USERSPACE_HEAP_SIZE)) {
-        return _ERR;
+        return (address_t)_ERR;
     }
 
     /* allocated block size is nearest rounded up power of 2 */
@@ -66,37 +208,54 @@ address_t _malloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
     if (block_size_needed <= MEM_BUDDY_MIN_BLOCK_SIZE_B) {
         block_size_needed = MEM_BUDDY_MIN_BLOCK_SIZE_B;
     }
-    uint32_t layer = __builtin_clz(block_size_needed) - __builtin_clz(USERSPACE_HEAP_SIZE);
-    uint32_t start_index = (1 << layer) - 1;
-    uint32_t end_index = ((1 << (layer+1)) - 1);
+    uint32_t target_layer = (uint32_t)(__builtin_clz(block_size_needed) - __builtin_clz(USERSPACE_HEAP_SIZE));
 
-    /* check for any free spots at layer, if so allocate and ensure all children are recursively invalid */
-    for (uint32_t i = start_index; i < end_index; i++) {
-        if (heap_mgr->mem_nodes[i].state == NODE_FREE) {
-            return allocate(heap_mgr, requestor, i, layer);
-        }
+    /* deepest layer at or above the target with a free block, i.e. the smallest block that fits */
+    uint32_t candidates = heap_mgr->layer_mask & ((2u << target_layer) - 1);
+    if (candidates == 0) {
+        return (address_t)_ERR;
     }
+    uint32_t layer = 31 - (uint32_t)__builtin_clz(candidates);
 
-    /* go up to find the first free block and split down to the right size */
-    uint32_t target_layer = layer;
-    while (layer > 0) {
-        layer--;
-        start_index = (1 << layer) - 1;
-        end_index = (1 << (layer+1)) - 1;
-        for (uint32_t i = start_index; i < end_index; i++) {
-            if (heap_mgr->mem_nodes[i].state == NODE_FREE) {
-                uint32_t final_i = split(heap_mgr, req_size, i, layer, target_layer);
-                return allocate(heap_mgr, requestor, final_i, target_layer);
-            }
-        }
+    uint32_t i = first_free_in_layer(heap_mgr, layer);
+    clear_free(heap_mgr, i);
+    i = split(heap_mgr, i, layer, target_layer);
+
+    return allocate(heap_mgr, requestor, i, target_layer);
+}
+
+/*
+ * the entry points below are the heap's only lock, each runs masked (nesting, so a caller
+ * that's already masked can chain them into one step). the _mblock_ ones and the slab layer
+ * are only ever reached from inside one
+ */
+address_t _malloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
+    address_t addr = (address_t)_ERR;
+    uint32_t primask = port_irq_save();
+
+    /* small objects come out of the slab caches, only fall back on a min block if that fails */
+    if ((req_size != 0) && (req_size <= SLAB_MAX_OBJ_SIZE_B)) {
+        addr = _slab_alloc(heap_mgr, req_size, requestor);
+    }
+    if (addr == (address_t)_ERR) {
+        addr = _mblock_alloc(heap_mgr, req_size, requestor);
+    }
+
+    if (addr == (address_t)_ERR) {
+        heap_mgr->counters.failures++;
+    } else {
+        heap_mgr->counters.allocs++;
+        MEM_TRACE_ALLOC(addr, req_size, requestor);
     }
 
-    return _ERR;
+    port_irq_restore(primask);
+    return addr;
 }
 
 /*
  * free and helper functions
- * free the block that is allocated and then coalesce above recursively if possible
+ * free the block that is allocated and then coalesce upwards while the buddy is free. the
+ * children of a coalesced node are left as they are, they're stale until the next split
  */
 static void coalesce(heap_manager* heap_mgr, uint32_t i) {
     while (i != 0) {
@@ -109,31 +268,27 @@ static void coalesce(heap_manager* heap_mgr, uint32_t i) {
         }
 
         /* if sibling is allocated then can't coalesce */
-        if (heap_mgr->mem_nodes[sibling].state != NODE_FREE) {
+        if (get_state(heap_mgr, sibling) != NODE_FREE) {
             break;
         }
 
-        heap_mgr->mem_nodes[i].state = NODE_INVALID;
-        heap_mgr->mem_nodes[sibling].state = NODE_INVALID;
-        heap_mgr->mem_nodes[parent].state = NODE_FREE;
+        clear_free(heap_mgr, i);
+        clear_free(heap_mgr, sibling);
+        set_free(heap_mgr, parent);
+        set_state(heap_mgr, parent, NODE_FREE);
         i = parent;
     }
 }
 
-int _free(heap_manager* heap_mgr, address_t target) {
-    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
-        return _ERR;
-    }
-
-    /*
-     * find the node to remove (must walk, since malloc(256) and malloc(1024) could technically
-     * give the same address)
-     */
-    address_t offset = target - USERSPACE_HEAP_START_ADDR;
+/*
+ * find the USED node a block starts at, offset is relative to the start of the heap
+ * (must walk, since malloc(256) and malloc(1024) could technically give the same address)
+ */
+static int find_used(heap_manager* heap_mgr, address_t offset, uint32_t* node) {
     memsize_t size = USERSPACE_HEAP_SIZE;
     uint32_t i = 0;
 
-    while (heap_mgr->mem_nodes[i].state == NODE_SPLIT) {
+    while (get_state(heap_mgr, i) == NODE_SPLIT) {
         size /= 2;
         if (offset < size) {
             i = (2 * i) + 1;
@@ -143,13 +298,240 @@ int _free(heap_manager* heap_mgr, address_t target) {
         }
     }
 
-    if ((heap_mgr->mem_nodes[i].state != NODE_USED) || (offset != 0)) {
+    if ((get_state(heap_mgr, i) != NODE_USED) || (offset != 0)) {
+        return _ERR;
+    }
+
+    *node = i;
+    return _OK;
+}
+
+static int free_block(heap_manager* heap_mgr, address_t offset) {
+    uint32_t slot = (uint32_t)(offset / MEM_BUDDY_MIN_BLOCK_SIZE_B);
+    uint32_t i = 0;
+
+    if (find_used(heap_mgr, offset, &i) != _OK) {
         return _ERR;
     }
 
-    heap_mgr->mem_nodes[i].state = NODE_FREE;
-    heap_mgr->mem_nodes[i].owner_tid = 0;
+    set_state(heap_mgr, i, NODE_FREE);
+    mem_uncharge(&heap_mgr->counters, heap_mgr->owners[slot], USERSPACE_HEAP_SIZE >> node_layer(i));
+    clear_owner(heap_mgr, slot);
+    set_free(heap_mgr, i);
     coalesce(heap_mgr, i);
 
     return _OK;
 }
+
+int _mblock_free(heap_manager* heap_mgr, address_t target) {
+    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
+        return _ERR;
+    }
+
+    return free_block(heap_mgr, target - USERSPACE_HEAP_START_ADDR);
+}
+
+int _free(heap_manager* heap_mgr, address_t target) {
+    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
+        return _ERR;
+    }
+
+    int err;
+    uint32_t primask = port_irq_save();
+    if (_slab_owns(heap_mgr, target)) {
+        err = _slab_free(heap_mgr, target);
+    } else {
+        err = free_block(heap_mgr, target - USERSPACE_HEAP_START_ADDR);
+    }
+
+    if (err == _OK) {
+        heap_mgr->counters.frees++;
+        MEM_TRACE_FREE(target);
+    }
+    port_irq_restore(primask);
+    return err;
+}
+
+/*
+ * bulk reclaim, walks the owner's index so the cost is the number of blocks it holds
+ * (each an O(depth) free), not the size of the tree
+ */
+int _free_all_owned(heap_manager* heap_mgr, tid_t owner) {
+    if (owner >= MAX_TASKS) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    while (heap_mgr->owned_summary[owner] != 0) {
+        uint32_t w = (uint32_t)__builtin_ctz(heap_mgr->owned_summary[owner]);
+        uint32_t page = (w << 5) + (uint32_t)__builtin_ctz(heap_mgr->owned_map[owner][w]);
+        uint32_t slot = owned_slot(heap_mgr, page, owner);
+        if (slot == MEM_BUDDY_MIN_BLOCKS) {
+            clear_page(heap_mgr, page, owner);
+            continue;
+        }
+        address_t offset = (address_t)slot * MEM_BUDDY_MIN_BLOCK_SIZE_B;
+
+        /* slabs have to come off their cache's lists first */
+        if (_slab_owns(heap_mgr, USERSPACE_HEAP_START_ADDR + offset)) {
+            _slab_reclaim(heap_mgr, USERSPACE_HEAP_START_ADDR + offset);
+            continue;
+        }
+
+        /* free_block clears the slot out of the index, if the tree disagrees drop it anyway */
+        if (free_block(heap_mgr, offset) != _OK) {
+            clear_owner(heap_mgr, slot);
+        }
+    }
+
+    port_irq_restore(primask);
+    return _OK;
+}
+
+static void reown(heap_manager* heap_mgr, uint32_t slot, uint32_t node, tid_t new_owner) {
+    memsize_t size = USERSPACE_HEAP_SIZE >> node_layer(node);
+    mem_uncharge(&heap_mgr->counters, heap_mgr->owners[slot], size);
+    clear_owner(heap_mgr, slot);
+    set_owner(heap_mgr, slot, new_owner);
+    mem_charge(&heap_mgr->counters, new_owner, size);
+}
+
+static int transfer(heap_manager* heap_mgr, address_t target, tid_t new_owner) {
+    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
+        return _ERR;
+    }
+
+    address_t offset = target - USERSPACE_HEAP_START_ADDR;
+    uint32_t i = 0;
+
+    if (find_used(heap_mgr, offset, &i) != _OK) {
+        return _ERR;
+    }
+
+    reown(heap_mgr, (uint32_t)(offset / MEM_BUDDY_MIN_BLOCK_SIZE_B), i, new_owner);
+    return _OK;
+}
+
+static tid_t owner_of(heap_manager* heap_mgr, address_t target) {
+    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
+        return MEM_OWNER_NONE;
+    }
+    if (_slab_owns(heap_mgr, target)) {
+        return _slab_owner(heap_mgr, target);
+    }
+
+    address_t offset = target - USERSPACE_HEAP_START_ADDR;
+    uint32_t i = 0;
+    if (find_used(heap_mgr, offset, &i) != _OK) {
+        return MEM_OWNER_NONE;
+    }
+    return heap_mgr->owners[offset / MEM_BUDDY_MIN_BLOCK_SIZE_B];
+}
+
+static int give(heap_manager* heap_mgr, address_t target, tid_t from, tid_t to) {
+    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
+        return _ERR;
+    }
+
+    /* a slab object shares its page, and so its owner, with the rest of the page */
+    if (_slab_owns(heap_mgr, target)) {
+        return _NOP;
+    }
+
+    address_t offset = target - USERSPACE_HEAP_START_ADDR;
+    uint32_t slot = (uint32_t)(offset / MEM_BUDDY_MIN_BLOCK_SIZE_B);
+    uint32_t i = 0;
+
+    if (find_used(heap_mgr, offset, &i) != _OK) {
+        return _ERR;
+    }
+    if (heap_mgr->owners[slot] != from) {
+        return _NOP;
+    }
+
+    reown(heap_mgr, slot, i, to);
+    return _OK;
+}
+
+static memsize_t size_of(heap_manager* heap_mgr, address_t target) {
+    if ((target < USERSPACE_HEAP_START_ADDR) || (target >= USERSPACE_HEAP_END_ADDR)) {
+        return 0;
+    }
+
+    if (_slab_owns(heap_mgr, target)) {
+        return _slab_obj_size(heap_mgr, target);
+    }
+
+    uint32_t i = 0;
+    if (find_used(heap_mgr, target - USERSPACE_HEAP_START_ADDR, &i) != _OK) {
+        return 0;
+    }
+
+    return USERSPACE_HEAP_SIZE >> node_layer(i);
+}
+
+int _mtransfer(heap_manager* heap_mgr, address_t target, tid_t new_owner) {
+    uint32_t primask = port_irq_save();
+    int err = transfer(heap_mgr, target, new_owner);
+    port_irq_restore(primask);
+    return err;
+}
+
+tid_t _mowner(heap_manager* heap_mgr, address_t target) {
+    uint32_t primask = port_irq_save();
+    tid_t owner = owner_of(heap_mgr, target);
+    port_irq_restore(primask);
+    return owner;
+}
+
+int _mgive(heap_manager* heap_mgr, address_t target, tid_t from, tid_t to) {
+    uint32_t primask = port_irq_save();
+    int err = give(heap_mgr, target, from, to);
+    port_irq_restore(primask);
+    return err;
+}
+
+memsize_t _msize(heap_manager* heap_mgr, address_t target) {
+    uint32_t primask = port_irq_save();
+    memsize_t size = size_of(heap_mgr, target);
+    port_irq_restore(primask);
+    return size;
+}
+
+/*
+ * introspection
+ * the smallest layer number with a free block is the biggest free block
+ */
+memsize_t _mlargest_free(heap_manager* heap_mgr) {
+    uint32_t layer_mask = heap_mgr->layer_mask;
+    if (layer_mask == 0) {
+        return 0;
+    }
+
+    return USERSPACE_HEAP_SIZE >> __builtin_ctz(layer_mask);
+}
+
+int _mstats(heap_manager* heap_mgr, mem_stats_t* stats) {
+    if (heap_mgr == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    const mem_counters_t* counters = &heap_mgr->counters;
+    stats->bytes_used = counters->bytes_used;
+    stats->bytes_free = USERSPACE_HEAP_SIZE - counters->bytes_used;
+    stats->largest_free = _mlargest_free(heap_mgr);
+    for (uint32_t t = 0; t < MAX_TASKS; t++) {
+        stats->owner_bytes[t] = counters->owner_bytes[t];
+    }
+    stats->kernel_bytes = counters->kernel_bytes;
+    stats->allocs = counters->allocs;
+    stats->frees = counters->frees;
+    stats->failures = counters->failures;
+    for (uint32_t l = 0; l < MEM_BUDDY_LAYERS; l++) {
+        stats->free_blocks[l] = heap_mgr->free_count[l];
+    }
+
+    port_irq_restore(primask);
+    return _OK;
+}
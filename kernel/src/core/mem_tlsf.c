@@ -0,0 +1,470 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "port.h"
+#include "sprinter_common.h"
+#include "mem.h"
+
+#define HDR     ((memsize_t)MEM_BLOCK_OVERHEAD_B)
+
+/*
+ * block helpers
+ */
+static inline memsize_t block_size(const tlsf_block_t* block) {
+    return block->info & TLSF_BLOCK_SIZE_MASK;
+}
+
+static inline void set_size(tlsf_block_t* block, memsize_t size) {
+    block->info = (block->info & ~TLSF_BLOCK_SIZE_MASK) | size;
+}
+
+static inline uint32_t block_owner(const tlsf_block_t* block) {
+    return block->info >> TLSF_BLOCK_OWNER_SHIFT;
+}
+
+static inline void set_owner(tlsf_block_t* block, tid_t owner) {
+    block->info = (block->info & ~(0xFFu << TLSF_BLOCK_OWNER_SHIFT)) |
+                  ((uint32_t)(owner & 0xFF) << TLSF_BLOCK_OWNER_SHIFT);
+}
+
+static inline tlsf_block_t* next_phys(const tlsf_block_t* block) {
+    return (tlsf_block_t*)((address_t)block + HDR + block_size(block));
+}
+
+static inline address_t payload_of(const tlsf_block_t* block) {
+    return (address_t)block + HDR;
+}
+
+static inline tlsf_block_t* block_of(address_t payload) {
+    return (tlsf_block_t*)(payload - HDR);
+}
+
+static inline uint32_t fls32(uint32_t val) {
+    return (uint32_t)(31 - __builtin_clz(val));
+}
+
+/*
+ * size class mapping
+ * mapping_insert is the class a block of this size lives in, mapping_search rounds up to the
+ * next class first so that any block found there is guaranteed to be big enough
+ */
+static void mapping_insert(memsize_t size, uint32_t* fl, uint32_t* sl) {
+    if (size < TLSF_SMALL_BLOCK_B) {
+        *fl = 0;
+        *sl = size / (TLSF_SMALL_BLOCK_B / TLSF_SL_COUNT);
+    } else {
+        uint32_t f = fls32(size);
+        *sl = (size >> (f - TLSF_SL_COUNT_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = f - (TLSF_FL_SHIFT - 1);
+    }
+}
+
+static void mapping_search(memsize_t size, uint32_t* fl, uint32_t* sl) {
+    if (size >= TLSF_SMALL_BLOCK_B) {
+        size += (1u << (fls32(size) - TLSF_SL_COUNT_LOG2)) - 1;
+    }
+    mapping_insert(size, fl, sl);
+}
+
+/*
+ * free list helpers
+ */
+static void insert_free(heap_manager* heap_mgr, tlsf_block_t* block) {
+    uint32_t fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    tlsf_block_t* head = heap_mgr->free_lists[fl][sl];
+    block->prev = NULL;
+    block->next = head;
+    if (head != NULL) {
+        head->prev = block;
+    }
+    heap_mgr->free_lists[fl][sl] = block;
+    heap_mgr->free_count[fl]++;
+    heap_mgr->sl_bitmap[fl] |= (1u << sl);
+    heap_mgr->fl_bitmap |= (1u << fl);
+}
+
+static void remove_free(heap_manager* heap_mgr, tlsf_block_t* block) {
+    uint32_t fl, sl;
+    mapping_insert(block_size(block), &fl, &sl);
+
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        heap_mgr->free_lists[fl][sl] = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    heap_mgr->free_count[fl]--;
+
+    if (heap_mgr->free_lists[fl][sl] == NULL) {
+        heap_mgr->sl_bitmap[fl] &= ~(1u << sl);
+        if (heap_mgr->sl_bitmap[fl] == 0) {
+            heap_mgr->fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+/*
+ * owner list helpers, only tasks get a list. kernel owned blocks just carry MEM_OWNER_NONE.
+ * a block is charged to its owner in the counters for as long as it's linked
+ */
+static void link_owner(heap_manager* heap_mgr, tlsf_block_t* block, tid_t owner) {
+    set_owner(block, (owner < MAX_TASKS) ? owner : MEM_OWNER_NONE);
+    mem_charge(&heap_mgr->counters, block_owner(block), HDR + block_size(block));
+    block->prev = NULL;
+    block->next = NULL;
+    if (owner >= MAX_TASKS) {
+        return;
+    }
+
+    block->next = heap_mgr->owned[owner];
+    if (block->next != NULL) {
+        block->next->prev = block;
+    }
+    heap_mgr->owned[owner] = block;
+}
+
+static void unlink_owner(heap_manager* heap_mgr, tlsf_block_t* block) {
+    uint32_t owner = block_owner(block);
+    mem_uncharge(&heap_mgr->counters, owner, HDR + block_size(block));
+    if (owner >= MAX_TASKS) {
+        return;
+    }
+    mem_released(&heap_mgr->release, owner, payload_of(block));
+
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        heap_mgr->owned[owner] = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+}
+
+/*
+ * a payload pointer is only taken seriously if it's aligned, inside the heap and its header
+ * says used. not bulletproof against garbage, but catches double frees
+ */
+static tlsf_block_t* used_block(address_t target) {
+    if ((target < USERSPACE_HEAP_START_ADDR + HDR) || (target >= USERSPACE_HEAP_END_ADDR) ||
+        ((target & (TLSF_ALIGN_B - 1)) != 0)) {
+        return NULL;
+    }
+
+    tlsf_block_t* block = block_of(target);
+    if ((block->info & TLSF_BLOCK_FREE) || (block_size(block) == 0)) {
+        return NULL;
+    }
+
+    return block;
+}
+
+/*
+ * the heap starts out as one free block followed by a zero sized used block at the very end,
+ * so every real block has a next neighbour and merging never runs off the heap
+ */
+void _minit(heap_manager* heap_mgr) {
+    heap_mgr->fl_bitmap = 0;
+    for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        heap_mgr->sl_bitmap[fl] = 0;
+        heap_mgr->free_count[fl] = 0;
+        for (uint32_t sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            heap_mgr->free_lists[fl][sl] = NULL;
+        }
+    }
+    for (uint32_t t = 0; t < MAX_TASKS; t++) {
+        heap_mgr->owned[t] = NULL;
+    }
+    heap_mgr->counters = (mem_counters_t){ 0 };
+    heap_mgr->release = (mem_release_t){ 0 };
+
+    tlsf_block_t* block = (tlsf_block_t*)USERSPACE_HEAP_START_ADDR;
+    block->prev_phys = NULL;
+    block->info = TLSF_BLOCK_FREE;
+    set_size(block, USERSPACE_HEAP_SIZE - (2 * HDR));
+
+    tlsf_block_t* sentinel = next_phys(block);
+    sentinel->prev_phys = block;
+    sentinel->info = TLSF_BLOCK_PREV_FREE | ((uint32_t)MEM_OWNER_NONE << TLSF_BLOCK_OWNER_SHIFT);
+
+    insert_free(heap_mgr, block);
+}
+
+/*
+ * malloc: find a class with a big enough block with two ffs, split the tail off if it's worth it
+ */
+static tlsf_block_t* find_free(heap_manager* heap_mgr, memsize_t size) {
+    uint32_t fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT) {
+        return NULL;
+    }
+
+    /* this second level range or above, otherwise the next non-empty first level */
+    uint32_t sl_map = heap_mgr->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = (fl + 1 < 32) ? (heap_mgr->fl_bitmap & (~0u << (fl + 1))) : 0;
+        if (fl_map == 0) {
+            return NULL;
+        }
+        fl = (uint32_t)__builtin_ctz(fl_map);
+        sl_map = heap_mgr->sl_bitmap[fl];
+    }
+    sl = (uint32_t)__builtin_ctz(sl_map);
+
+    return heap_mgr->free_lists[fl][sl];
+}
+
+static address_t alloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
+    if ((req_size == 0) || (req_size > USERSPACE_HEAP_SIZE - (2 * HDR))) {
+        heap_mgr->counters.failures++;
+        return (address_t)_ERR;
+    }
+
+    memsize_t size = (req_size + TLSF_ALIGN_B - 1) & ~(memsize_t)(TLSF_ALIGN_B - 1);
+    if (size < TLSF_MIN_BLOCK_B) {
+        size = TLSF_MIN_BLOCK_B;
+    }
+
+    tlsf_block_t* block = find_free(heap_mgr, size);
+    if (block == NULL) {
+        heap_mgr->counters.failures++;
+        return (address_t)_ERR;
+    }
+    remove_free(heap_mgr, block);
+
+    tlsf_block_t* next = next_phys(block);
+    if (block_size(block) >= size + HDR + TLSF_MIN_BLOCK_B) {
+        /* the tail becomes a free block of its own, next keeps its PREV_FREE flag */
+        tlsf_block_t* rest = (tlsf_block_t*)(payload_of(block) + size);
+        rest->prev_phys = block;
+        rest->info = TLSF_BLOCK_FREE;
+        set_size(rest, block_size(block) - size - HDR);
+        next->prev_phys = rest;
+        set_size(block, size);
+        insert_free(heap_mgr, rest);
+    } else {
+        next->info &= ~TLSF_BLOCK_PREV_FREE;
+    }
+
+    block->info &= ~TLSF_BLOCK_FREE;
+    link_owner(heap_mgr, block, requestor);
+    heap_mgr->counters.allocs++;
+
+    MEM_TRACE_ALLOC(payload_of(block), req_size, requestor);
+    return payload_of(block);
+}
+
+/*
+ * free: merge with whichever physical neighbours are free and put the result on its list
+ */
+static void free_block(heap_manager* heap_mgr, tlsf_block_t* block) {
+    unlink_owner(heap_mgr, block);
+    block->info |= TLSF_BLOCK_FREE;
+
+    if (block->info & TLSF_BLOCK_PREV_FREE) {
+        tlsf_block_t* prev = block->prev_phys;
+        remove_free(heap_mgr, prev);
+        set_size(prev, block_size(prev) + HDR + block_size(block));
+        block = prev;
+    }
+
+    tlsf_block_t* next = next_phys(block);
+    if (next->info & TLSF_BLOCK_FREE) {
+        remove_free(heap_mgr, next);
+        set_size(block, block_size(block) + HDR + block_size(next));
+        next = next_phys(block);
+    }
+
+    next->prev_phys = block;
+    next->info |= TLSF_BLOCK_PREV_FREE;
+    insert_free(heap_mgr, block);
+}
+
+static int free_target(heap_manager* heap_mgr, address_t target) {
+    tlsf_block_t* block = used_block(target);
+    if (block == NULL) {
+        return _ERR;
+    }
+
+    MEM_TRACE_FREE(target);
+    free_block(heap_mgr, block);
+    heap_mgr->counters.frees++;
+
+    return _OK;
+}
+
+/* bulk reclaim, straight down the owner's list */
+int _free_all_owned(heap_manager* heap_mgr, tid_t owner) {
+    if (owner >= MAX_TASKS) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    while (heap_mgr->owned[owner] != NULL) {
+        free_block(heap_mgr, heap_mgr->owned[owner]);
+    }
+
+    port_irq_restore(primask);
+    return _OK;
+}
+
+static int transfer(heap_manager* heap_mgr, address_t target, tid_t new_owner) {
+    tlsf_block_t* block = used_block(target);
+    if (block == NULL) {
+        return _ERR;
+    }
+
+    unlink_owner(heap_mgr, block);
+    link_owner(heap_mgr, block, new_owner);
+
+    return _OK;
+}
+
+/*
+ * used_block takes whatever is in front of target for a header, and inside a block that's the
+ * owner's own data. only a block that's on its owner's list really is one
+ */
+static tid_t owner_of(heap_manager* heap_mgr, address_t target) {
+    tlsf_block_t* block = used_block(target);
+    if (block == NULL) {
+        return MEM_OWNER_NONE;
+    }
+
+    tid_t owner = block_owner(block);
+    if (owner >= MAX_TASKS) {
+        return owner;
+    }
+    for (tlsf_block_t* at = heap_mgr->owned[owner]; at != NULL; at = at->next) {
+        if (at == block) {
+            return owner;
+        }
+    }
+    return MEM_OWNER_NONE;
+}
+
+static int give(heap_manager* heap_mgr, address_t target, tid_t from, tid_t to) {
+    tlsf_block_t* block = used_block(target);
+    if (block == NULL) {
+        return _ERR;
+    }
+    if (block_owner(block) != from) {
+        return _NOP;
+    }
+
+    unlink_owner(heap_mgr, block);
+    link_owner(heap_mgr, block, to);
+
+    return _OK;
+}
+
+static memsize_t size_of(heap_manager* heap_mgr, address_t target) {
+    (void)heap_mgr;
+
+    tlsf_block_t* block = used_block(target);
+    if (block == NULL) {
+        return 0;
+    }
+
+    return block_size(block);
+}
+
+/*
+ * the entry points are the heap's only lock, each runs masked (nesting, so a caller that's
+ * already masked can chain them into one step)
+ */
+address_t _malloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
+    uint32_t primask = port_irq_save();
+    address_t addr = alloc(heap_mgr, req_size, requestor);
+    port_irq_restore(primask);
+    return addr;
+}
+
+int _free(heap_manager* heap_mgr, address_t target) {
+    uint32_t primask = port_irq_save();
+    int err = free_target(heap_mgr, target);
+    port_irq_restore(primask);
+    return err;
+}
+
+int _mtransfer(heap_manager* heap_mgr, address_t target, tid_t new_owner) {
+    uint32_t primask = port_irq_save();
+    int err = transfer(heap_mgr, target, new_owner);
+    port_irq_restore(primask);
+    return err;
+}
+
+tid_t _mowner(heap_manager* heap_mgr, address_t target) {
+    uint32_t primask = port_irq_save();
+    tid_t owner = owner_of(heap_mgr, target);
+    port_irq_restore(primask);
+    return owner;
+}
+
+int _mgive(heap_manager* heap_mgr, address_t target, tid_t from, tid_t to) {
+    uint32_t primask = port_irq_save();
+    int err = give(heap_mgr, target, from, to);
+    port_irq_restore(primask);
+    return err;
+}
+
+memsize_t _msize(heap_manager* heap_mgr, address_t target) {
+    uint32_t primask = port_irq_save();
+    memsize_t size = size_of(heap_mgr, target);
+    port_irq_restore(primask);
+    return size;
+}
+
+/*
+ * introspection
+ * the biggest block is somewhere in the highest non-empty class. finding it exactly means
+ * walking that list, its lower bound is what any request up to it is guaranteed to find
+ */
+memsize_t _mlargest_free(heap_manager* heap_mgr) {
+    memsize_t largest = 0;
+    uint32_t primask = port_irq_save();
+
+    if (heap_mgr->fl_bitmap != 0) {
+        uint32_t fl = fls32(heap_mgr->fl_bitmap);
+        uint32_t sl = fls32(heap_mgr->sl_bitmap[fl]);
+        if (fl == 0) {
+            largest = sl * (TLSF_SMALL_BLOCK_B / TLSF_SL_COUNT);
+        } else {
+            uint32_t base = 1u << (fl + TLSF_FL_SHIFT - 1);
+            largest = base + (sl * (base / TLSF_SL_COUNT));
+        }
+    }
+
+    port_irq_restore(primask);
+    return largest;
+}
+
+int _mstats(heap_manager* heap_mgr, mem_stats_t* stats) {
+    if (heap_mgr == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    const mem_counters_t* counters = &heap_mgr->counters;
+    stats->bytes_used = counters->bytes_used;
+    stats->bytes_free = USERSPACE_HEAP_SIZE - HDR - counters->bytes_used;
+    stats->largest_free = _mlargest_free(heap_mgr);
+    for (uint32_t t = 0; t < MAX_TASKS; t++) {
+        stats->owner_bytes[t] = counters->owner_bytes[t];
+    }
+    stats->kernel_bytes = counters->kernel_bytes;
+    stats->allocs = counters->allocs;
+    stats->frees = counters->frees;
+    stats->failures = counters->failures;
+    for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        stats->free_blocks[fl] = heap_mgr->free_count[fl];
+    }
+
+    port_irq_restore(primask);
+    return _OK;
+}
@@ -0,0 +1,195 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/cortex.h"
+#include "core/mem.h"
+#include "core/mpu.h"
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sprinter_common.h"
+#include "core/tcb.h"
+#include "core/tcb_buf.h"
+#include "drivers/uart.h"
+
+static mpu_fault_t last_fault;
+
+static inline uint32_t region_rbar(uint32_t region, address_t base) {
+    return (uint32_t)base | MPU_RBAR_VALID | region;
+}
+
+static inline uint32_t region_size(memsize_t size) {
+    return MPU_RASR_SIZE(__builtin_ctz(size));
+}
+
+void mpu_task_init(tcb_t* task) {
+    address_t stack_low = task->stack_high - task->stack_size;
+    uint32_t* mpu = task->mpu;
+
+    mpu[0] = region_rbar(MPU_REGION_STACK, stack_low);
+    mpu[1] = MPU_RASR_XN | MPU_RASR_AP_FULL | MPU_RASR_MEM_WBWA | region_size(task->stack_size) | MPU_RASR_ENABLE;
+    for (uint32_t slot = 0; slot < MPU_GRANTS; slot++) {
+        mpu[2 + (2 * slot)] = region_rbar(MPU_REGION_GRANT + slot, 0);
+        mpu[3 + (2 * slot)] = 0;
+    }
+    mpu[6] = region_rbar(MPU_REGION_GUARD, stack_low);
+    mpu[7] = MPU_RASR_XN | MPU_RASR_AP_NONE | MPU_RASR_MEM_WBWA | region_size(MPU_GUARD_B) | MPU_RASR_ENABLE;
+}
+
+int mpu_grant(volatile tcb_t* task, uint32_t slot, address_t base, memsize_t size) {
+    if (task == NULL || slot >= MPU_GRANTS) {
+        return _ERR;
+    }
+    if (size < 32 || (size & (size - 1)) != 0 || (base & (size - 1)) != 0) {
+        return _NOP;
+    }
+
+    task->mpu[2 + (2 * slot)] = region_rbar(MPU_REGION_GRANT + slot, base);
+    task->mpu[3 + (2 * slot)] = MPU_RASR_XN | MPU_RASR_AP_FULL | MPU_RASR_MEM_WBWA | region_size(size) | MPU_RASR_ENABLE;
+
+    return _OK;
+}
+
+static inline bool granted(const volatile tcb_t* task, uint32_t slot, address_t base) {
+    return task->mpu[3 + (2 * slot)] != 0 && (task->mpu[2 + (2 * slot)] & MPU_RBAR_ADDR_MASK) == (uint32_t)base;
+}
+
+uint32_t mpu_grant_slot(const volatile tcb_t* task, address_t base) {
+    uint32_t free_slot = MPU_GRANTS;
+    for (uint32_t slot = 0; slot < MPU_GRANTS; slot++) {
+        if (granted(task, slot, base)) {
+            return slot;
+        }
+        if (free_slot == MPU_GRANTS && task->mpu[3 + (2 * slot)] == 0) {
+            free_slot = slot;
+        }
+    }
+    return free_slot;
+}
+
+int mpu_revoke(volatile tcb_t* task, address_t base) {
+    if (task == NULL) {
+        return _ERR;
+    }
+
+    int err = _NOP;
+    for (uint32_t slot = 0; slot < MPU_GRANTS; slot++) {
+        if (granted(task, slot, base)) {
+            task->mpu[2 + (2 * slot)] = region_rbar(MPU_REGION_GRANT + slot, 0);
+            task->mpu[3 + (2 * slot)] = 0;
+            err = _OK;
+        }
+    }
+
+    return err;
+}
+
+int mpu_fault_stats(mpu_fault_t* stats) {
+    if (stats == NULL) {
+        return _ERR;
+    }
+
+    *stats = last_fault;
+    return _OK;
+}
+
+/* the teardown a fault leaves for PendSV, it runs before the switch away from the task */
+static void reap_faulted(void* arg) {
+    volatile tcb_t* task = arg;
+
+#if !defined(SPRINTER_HOST)
+    uart_out("[fault] tid %d %s at %h", (int)task->tid,
+             last_fault.overflow ? "stack overflow" : "mpu violation", last_fault.addr);
+#endif
+    remove_task(scheduler.tasks, task->tid);
+}
+
+static sched_deferred_t reap = { NULL, 0, reap_faulted, NULL };
+
+void mpu_fault(volatile tcb_t* task, uint32_t cfsr, address_t addr) {
+    /* a stacking fault is the hardware frame not fitting, so that's running out too */
+    address_t stack_low = task->stack_high - task->stack_size;
+    last_fault.overflow = (cfsr & SCB_CFSR_MSTKERR) ||
+                          (addr >= stack_low && addr < stack_low + MPU_GUARD_B);
+    last_fault.tid = task->tid;
+    last_fault.addr = addr;
+    last_fault.cfsr = cfsr;
+    last_fault.faults++;
+
+    /* it can't run again before PendSV, so there's only ever the one */
+    reap.arg = (void*)task;
+    sched_defer(&reap);
+}
+
+#if !defined(SPRINTER_HOST)
+void mpu_init(void) {
+    MPU->CTRL = 0;
+
+    /* smallest power of two from the start of dtcm that reaches the end of userspace */
+    address_t sram_end = USERSPACE_END_ADDR;
+    memsize_t sram_size = (memsize_t)1 << (32 - __builtin_clz((uint32_t)(sram_end - KERNELSPACE_START_ADDR) - 1));
+    address_t sram_base = KERNELSPACE_START_ADDR & ~(address_t)(sram_size - 1);
+    while (sram_base + sram_size < sram_end) {
+        sram_size <<= 1;
+        sram_base &= ~(address_t)(sram_size - 1);
+    }
+    MPU->RBAR = region_rbar(MPU_REGION_SRAM, sram_base);
+    MPU->RASR = MPU_RASR_XN | MPU_RASR_AP_PRIV | MPU_RASR_MEM_WBWA | region_size(sram_size) | MPU_RASR_ENABLE;
+
+    _Static_assert((KERNEL_IMG_SIZE_B & (KERNEL_IMG_SIZE_B - 1)) == 0 &&
+                   (KERNEL_IMG_ORIGIN & (KERNEL_IMG_SIZE_B - 1)) == 0, "kernel image has to be one mpu region");
+    MPU->RBAR = region_rbar(MPU_REGION_IMAGE, KERNEL_IMG_ORIGIN);
+    MPU->RASR = MPU_RASR_AP_URO | MPU_RASR_MEM_WT | region_size(KERNEL_IMG_SIZE_B) | MPU_RASR_ENABLE;
+
+    /* the rest stay off until the first switch loads a task's */
+    for (uint32_t region = MPU_REGION_IMAGE + 1; region <= MPU_REGION_GUARD; region++) {
+        MPU->RBAR = region_rbar(region, 0);
+        MPU->RASR = 0;
+    }
+
+    SCB->SHCSR |= SCB_SHCSR_MEMFAULTENA;
+    MPU->CTRL = MPU_CTRL_ENABLE | MPU_CTRL_PRIVDEFENA;
+    __asm__ volatile ("dsb\n\tisb" ::: "memory");
+}
+
+void MemManage_Handler(void) {
+    uint32_t cfsr = SCB->CFSR & SCB_CFSR_MMFSR_MASK;
+    address_t addr = (cfsr & SCB_CFSR_MMARVALID) ? SCB->MMFAR : 0;
+    SCB->CFSR = cfsr;
+
+    /*
+     * only a task's own code, with nothing masked. a fault with primask set never gets here,
+     * it's escalated to HardFault_Handler
+     */
+    volatile tcb_t* task = scheduler.current;
+    bool from_task = (SCB->ICSR & SCB_ICSR_RETTOBASE) && task != NULL;
+
+    /* root keeps the watchdog fed and the kernel has nothing to fall back on */
+    if (!from_task || task->tid == 0) {
+        uart_out("[fault] memmanage in the kernel, cfsr %h at %h, halting", cfsr, addr);
+        while (1) {
+        }
+    }
+
+    /*
+     * the task is removed by deferred work in PendSV, straight after this returns. PendSV
+     * mustn't save anything onto the stack that just faulted, no current task means it goes
+     * straight to loading the next one. if the task had fp state, lazy stacking still has space
+     * reserved for it on that stack, and the first fp instruction anyone runs next would write
+     * it there. dropping LSPACT gives that up
+     */
+    FPCCR &= ~FPCCR_LSPACT;
+    scheduler.current = NULL;
+    mpu_fault(task, cfsr, addr);
+}
+
+/*
+ * anything that couldn't be taken as itself, a memmanage fault inside a masked kernel section
+ * included. the kernel's state is half updated, so it stops
+ */
+void HardFault_Handler(void) {
+    uart_out("[fault] hardfault, hfsr %h cfsr %h at %h, halting", SCB->HFSR, SCB->CFSR, SCB->MMFAR);
+    while (1) {
+    }
+}
+#endif
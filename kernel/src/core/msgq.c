@@ -0,0 +1,155 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "core/msgq.h"
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sprinter_common.h"
+#include "core/tcb.h"
+
+static void wake_receiver(void* arg);
+
+int msgq_init(msgq_t* queue, void* buffer, memsize_t msg_size, uint32_t slots) {
+    if (queue == NULL || buffer == NULL || msg_size == 0 || slots == 0 || (slots & (slots - 1)) != 0) {
+        return _ERR;
+    }
+
+    queue->head = 0;
+    queue->tail = 0;
+    queue->mask = slots - 1;
+    queue->msg_size = msg_size;
+    queue->buffer = buffer;
+    queue->waiter = NULL;
+    queue->wake = (sched_deferred_t){ NULL, 0, wake_receiver, queue };
+    queue->stats = (msgq_stats_t){ 0 };
+
+    return _OK;
+}
+
+/* from PendSV with interrupts masked, the receiver parked when the send looked */
+static void wake_receiver(void* arg) {
+    msgq_t* queue = arg;
+    volatile tcb_t* waiter = queue->waiter;
+
+    queue->waiter = NULL;
+    if (waiter != NULL) {
+        sched_wake(waiter, 1);
+    }
+}
+
+/* a receiver suspended or removed while it waited */
+static void cancel_recv(volatile tcb_t* task) {
+    msgq_t* queue = task->wait.obj;
+
+    if (queue->waiter == task) {
+        queue->waiter = NULL;
+    }
+}
+
+int msgq_send(msgq_t* queue, const void* msg) {
+    if (queue == NULL || msg == NULL) {
+        return _ERR;
+    }
+
+    uint32_t tail = queue->tail;
+    uint32_t queued = tail - queue->head;
+    if (queued > queue->mask) {
+        queue->stats.full++;
+        return _NOP;
+    }
+
+    /* the receiver is done reading the slot once it moved head past it */
+    port_dmb();
+    memcpy(queue->buffer + ((tail & queue->mask) * queue->msg_size), msg, queue->msg_size);
+    port_dmb();
+    queue->tail = tail + 1;
+
+    queue->stats.sent++;
+    if (queued + 1 > queue->stats.high_water) {
+        queue->stats.high_water = queued + 1;
+    }
+
+    /* tail has to be out before waiter is looked at, or a receiver parking now could be missed */
+    port_dmb();
+    if (queue->waiter != NULL) {
+        sched_defer(&queue->wake);
+    }
+
+    return _OK;
+}
+
+int msgq_recv(msgq_t* queue, void* msg, bool block) {
+    if (queue == NULL || msg == NULL) {
+        return _ERR;
+    }
+
+    uint32_t head = queue->head;
+    while (queue->tail == head) {
+        if (!block) {
+            return _NOP;
+        }
+
+        /* parked before the last look, a send after this sees waiter and wakes it */
+        uint32_t primask = port_irq_save();
+        volatile tcb_t* self = scheduler.current;
+        queue->waiter = self;
+        port_dmb();
+        if (queue->tail == head) {
+            self->wait = (tcb_wait_t){ cancel_recv, queue, port_cycles(), 0, 0 };
+            queue->stats.blocked++;
+            sched_block(self, STATUS_BLOCKED);
+        } else {
+            queue->waiter = NULL;
+        }
+        port_irq_restore(primask);
+    }
+
+    /* the sender's copy into the slot is visible once its tail is */
+    port_dmb();
+    memcpy(msg, queue->buffer + ((head & queue->mask) * queue->msg_size), queue->msg_size);
+    port_dmb();
+    queue->head = head + 1;
+    queue->stats.received++;
+
+    return _OK;
+}
+
+int msgq_send_block(msgq_t* queue, heap_manager* heap_mgr, address_t block, tid_t to) {
+    if (queue == NULL || heap_mgr == NULL || queue->msg_size != MSGQ_BLOCK_B) {
+        return _ERR;
+    }
+
+    /* only this side fills the queue, if there's room now there still is after the give */
+    if (msgq_count(queue) > queue->mask) {
+        queue->stats.full++;
+        return _NOP;
+    }
+
+    uint32_t primask = port_irq_save();
+    int err = _mgive(heap_mgr, block, scheduler.current->tid, to);
+    port_irq_restore(primask);
+    if (err != _OK) {
+        return err;
+    }
+
+    return msgq_send(queue, &block);
+}
+
+int msgq_recv_block(msgq_t* queue, address_t* block, bool wait) {
+    if (queue == NULL || block == NULL || queue->msg_size != MSGQ_BLOCK_B) {
+        return _ERR;
+    }
+
+    return msgq_recv(queue, block, wait);
+}
+
+int msgq_stats(const msgq_t* queue, msgq_stats_t* stats) {
+    if (queue == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    *stats = queue->stats;
+    return _OK;
+}
@@ -0,0 +1,280 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/mutex.h"
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sprinter_common.h"
+#include "core/tcb.h"
+
+int mutex_init(mutex_t* mutex) {
+    if (mutex == NULL) {
+        return _ERR;
+    }
+
+    mutex->owner = 0;
+    mutex->waiters = NULL;
+    mutex->waiting = 0;
+    mutex->boosting_next = NULL;
+    mutex->stats = (mutex_stats_t){ 0 };
+
+    return _OK;
+}
+
+/* what owner is while task holds it */
+static inline uint32_t owner_id(volatile tcb_t* task) {
+    return ((task->serial << MUTEX_TID_BITS) | (task->tid + 1)) & MUTEX_OWNER_MASK;
+}
+
+/* NULL while it's free, or once the task that took it has been removed */
+static inline volatile tcb_t* holder(const mutex_t* mutex) {
+    uint32_t owner = mutex->owner & MUTEX_OWNER_MASK;
+    if (owner == 0) {
+        return NULL;
+    }
+
+    volatile tcb_t* task = &scheduler.tasks->buffer[(owner & MUTEX_TID_MASK) - 1];
+    return (task->status != STATUS_NULL && owner_id(task) == owner) ? task : NULL;
+}
+
+/*
+ * wait queue and boosting list helpers, all called with interrupts masked
+ */
+static void queue_waiter(mutex_t* mutex, volatile tcb_t* task) {
+    sched_waitq_add(&mutex->waiters, task);
+    mutex->waiting++;
+}
+
+static void unqueue_waiter(mutex_t* mutex, volatile tcb_t* task) {
+    sched_waitq_remove(&mutex->waiters, task);
+    mutex->waiting--;
+}
+
+static void boost_link(volatile tcb_t* task, mutex_t* mutex) {
+    mutex->boosting_next = task->boosting;
+    task->boosting = mutex;
+}
+
+static void boost_unlink(volatile tcb_t* task, mutex_t* mutex) {
+    mutex_t** at = (mutex_t**)&task->boosting;
+
+    while (*at != NULL && *at != mutex) {
+        at = &(*at)->boosting_next;
+    }
+    if (*at != NULL) {
+        *at = mutex->boosting_next;
+    }
+    mutex->boosting_next = NULL;
+}
+
+/* base priority, or the best first waiter on anything it holds */
+static uint8_t inherited(volatile tcb_t* task) {
+    uint8_t prio = task->base_priority;
+
+    for (mutex_t* mutex = task->boosting; mutex != NULL; mutex = mutex->boosting_next) {
+        if (sched_rank(mutex->waiters) > prio) {
+            prio = sched_rank(mutex->waiters);
+        }
+    }
+    return prio;
+}
+
+static void cancel_lock(volatile tcb_t* task);
+
+/*
+ * task's priority worked out again, then the holder of whatever it's waiting on and so on down
+ * the chain, up to the first task that doesn't change. a waiter keeps its place in the queue
+ * by its new priority. a deadlocked ring settles inside a lap, MAX_TASKS hops bounds it anyway
+ */
+static void update_chain(volatile tcb_t* task) {
+    for (uint32_t hops = 0; task != NULL && hops < MAX_TASKS; hops++) {
+        uint8_t prio = inherited(task);
+        if (prio == task->priority) {
+            return;
+        }
+        sched_set_priority(task, prio);
+
+        if (task->status != STATUS_BLOCKED || task->wait.cancel != cancel_lock) {
+            return;
+        }
+        mutex_t* mutex = task->wait.obj;
+        unqueue_waiter(mutex, task);
+        queue_waiter(mutex, task);
+        task = holder(mutex);
+    }
+}
+
+/* a waiter timed out, suspended or removed, the holder gives back what it lent */
+static void cancel_lock(volatile tcb_t* task) {
+    mutex_t* mutex = task->wait.obj;
+    volatile tcb_t* owner = holder(mutex);
+
+    unqueue_waiter(mutex, task);
+    mutex->stats.timeouts++;
+    if (mutex->waiters == NULL) {
+        mutex->owner &= MUTEX_OWNER_MASK;
+        if (owner != NULL) {
+            boost_unlink(owner, mutex);
+        }
+    }
+    update_chain(owner);
+}
+
+/* straight to the first waiter, it can't be beaten to it */
+static void hand_over(volatile tcb_t* self, mutex_t* mutex) {
+    volatile tcb_t* next = mutex->waiters;
+    boost_unlink(self, mutex);
+    unqueue_waiter(mutex, next);
+    mutex->owner = owner_id(next) | ((mutex->waiters != NULL) ? MUTEX_WAITERS : 0);
+    if (mutex->waiters != NULL) {
+        boost_link(next, mutex);
+    }
+
+    uint32_t waited = port_cycles() - next->wait.since;
+    mutex->stats.locks++;
+    mutex->stats.wait_cycles_last = waited;
+    mutex->stats.wait_cycles_total += waited;
+    if (waited > mutex->stats.wait_cycles_max) {
+        mutex->stats.wait_cycles_max = waited;
+    }
+
+    /* value 1 is what a mutex_lock system call returns once it's handed the mutex */
+    sched_wake(next, 1);
+    update_chain(self);
+}
+
+int mutex_lock(mutex_t* mutex, uint32_t timeout) {
+    if (mutex == NULL) {
+        return _ERR;
+    }
+
+    volatile tcb_t* self = scheduler.current;
+    uint32_t me = owner_id(self);
+
+    /* only the holder touches locks */
+    if (port_cas(&mutex->owner, 0, me)) {
+        mutex->stats.locks++;
+        return _OK;
+    }
+    if ((mutex->owner & MUTEX_OWNER_MASK) == me) {
+        return _ERR;
+    }
+    if (timeout == 0) {
+        return mutex_trylock(mutex);
+    }
+
+    uint32_t primask = port_irq_save();
+
+    /*
+     * let go of since the cas, or its holder was removed with nobody waiting. nothing else gets
+     * in with interrupts masked
+     */
+    volatile tcb_t* owner = holder(mutex);
+    if (owner == NULL) {
+        mutex->owner = me;
+        mutex->stats.locks++;
+        port_irq_restore(primask);
+        return _OK;
+    }
+
+    /* from here the holder's fast unlock fails and it comes round to hand it over */
+    if (mutex->waiters == NULL) {
+        mutex->owner |= MUTEX_WAITERS;
+        boost_link(owner, mutex);
+    }
+    queue_waiter(mutex, self);
+    self->wait = (tcb_wait_t){ cancel_lock, mutex, port_cycles(), 0, 0 };
+
+    mutex->stats.contended++;
+    if (mutex->waiting > mutex->stats.waiters_max) {
+        mutex->stats.waiters_max = mutex->waiting;
+    }
+    uint8_t was = owner->priority;
+    update_chain(owner);
+    if (owner->priority != was) {
+        mutex->stats.inherited++;
+    }
+
+    sched_wait(timeout);
+    port_irq_restore(primask);
+
+    /* back here once it's been handed the mutex, or its wait timed out or was cancelled */
+    return ((mutex->owner & MUTEX_OWNER_MASK) == me) ? _OK : _NOP;
+}
+
+int mutex_trylock(mutex_t* mutex) {
+    if (mutex == NULL) {
+        return _ERR;
+    }
+
+    uint32_t me = owner_id(scheduler.current);
+    if (port_cas(&mutex->owner, 0, me)) {
+        mutex->stats.locks++;
+        return _OK;
+    }
+
+    /* one a removed task left behind is as good as free */
+    int err = _NOP;
+    uint32_t primask = port_irq_save();
+    if (holder(mutex) == NULL) {
+        mutex->owner = me;
+        mutex->stats.locks++;
+        err = _OK;
+    }
+    port_irq_restore(primask);
+
+    return err;
+}
+
+int mutex_unlock(mutex_t* mutex) {
+    if (mutex == NULL) {
+        return _ERR;
+    }
+
+    volatile tcb_t* self = scheduler.current;
+    uint32_t me = owner_id(self);
+
+    /* only fails with MUTEX_WAITERS set, or when it isn't ours to give back */
+    if (port_cas(&mutex->owner, me, 0)) {
+        return _OK;
+    }
+    if ((mutex->owner & MUTEX_OWNER_MASK) != me) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+
+    /* the last waiter can have been cancelled since the cas, then it's just given back */
+    if (mutex->waiters == NULL) {
+        mutex->owner = 0;
+    } else {
+        hand_over(self, mutex);
+    }
+
+    port_irq_restore(primask);
+    return _OK;
+}
+
+/* only the ones with waiters are on tcb.boosting, those go to their first waiter */
+void mutex_abandon(volatile tcb_t* task) {
+    uint32_t primask = port_irq_save();
+
+    while (task->boosting != NULL) {
+        hand_over(task, task->boosting);
+    }
+
+    port_irq_restore(primask);
+}
+
+int mutex_stats(const mutex_t* mutex, mutex_stats_t* stats) {
+    if (mutex == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    *stats = mutex->stats;
+    port_irq_restore(primask);
+
+    return _OK;
+}
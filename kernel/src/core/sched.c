@@ -0,0 +1,771 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/cortex.h"
+#include "core/ktimer.h"
+#include "core/mpu.h"
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sprinter_common.h"
+#include "core/tcb.h"
+#include "core/tcb_buf.h"
+
+sched_t scheduler;
+
+int sched_init(taskbuff_t* tasks) {
+    if (tasks == NULL) {
+        return _ERR;
+    }
+
+    scheduler.current = NULL;
+    scheduler.next = NULL;
+    scheduler.switch_stamp = 0;
+    scheduler.cycle_source = port_cycle_source();
+    scheduler.tasks = tasks;
+    scheduler.deferred = NULL;
+    scheduler.ready_map = 0;
+    for (uint32_t p = 0; p < SCHED_PRIORITIES; p++) {
+        scheduler.ready_head[p] = NULL;
+        scheduler.ready_tail[p] = NULL;
+    }
+    scheduler.edf_ready = (sched_heap_t){ .count = 0, .by_release = false };
+    scheduler.edf_waiting = (sched_heap_t){ .count = 0, .by_release = true };
+    scheduler.edf_util_ppm = 0;
+    _ktimer_init(&scheduler.timers, 0);
+    scheduler.ticks = 0;
+    scheduler.tick_wraps = 0;
+    scheduler.switches = 0;
+    scheduler.idle = (sched_idle_stats_t){ 0 };
+    scheduler.started = false;
+
+    return _OK;
+}
+
+/*
+ * ready queue helpers, all called with interrupts masked
+ */
+static void enqueue(volatile tcb_t* task, bool at_head) {
+    uint32_t prio = task->priority;
+
+    if (scheduler.ready_head[prio] == NULL) {
+        task->ready_next = NULL;
+        task->ready_prev = NULL;
+        scheduler.ready_head[prio] = task;
+        scheduler.ready_tail[prio] = task;
+        scheduler.ready_map |= (1u << prio);
+    } else if (at_head) {
+        task->ready_prev = NULL;
+        task->ready_next = scheduler.ready_head[prio];
+        scheduler.ready_head[prio]->ready_prev = task;
+        scheduler.ready_head[prio] = task;
+    } else {
+        task->ready_next = NULL;
+        task->ready_prev = scheduler.ready_tail[prio];
+        scheduler.ready_tail[prio]->ready_next = task;
+        scheduler.ready_tail[prio] = task;
+    }
+}
+
+static void dequeue(volatile tcb_t* task) {
+    uint32_t prio = task->priority;
+
+    if (task->ready_prev != NULL) {
+        task->ready_prev->ready_next = task->ready_next;
+    } else {
+        scheduler.ready_head[prio] = task->ready_next;
+    }
+    if (task->ready_next != NULL) {
+        task->ready_next->ready_prev = task->ready_prev;
+    } else {
+        scheduler.ready_tail[prio] = task->ready_prev;
+    }
+    task->ready_next = NULL;
+    task->ready_prev = NULL;
+
+    if (scheduler.ready_head[prio] == NULL) {
+        scheduler.ready_map &= ~(1u << prio);
+    }
+}
+
+/*
+ * EDF heaps, binary min heaps over tcb pointers. every task knows its own slot so it can be
+ * taken out from the middle. tick counts wrap, so keys are compared by their difference
+ */
+static inline bool before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+static inline uint32_t heap_key(const sched_heap_t* heap, volatile tcb_t* task) {
+    return heap->by_release ? task->edf.release : task->edf.abs_deadline;
+}
+
+static inline void heap_place(sched_heap_t* heap, uint32_t idx, volatile tcb_t* task) {
+    heap->items[idx] = task;
+    task->edf.heap_idx = idx;
+}
+
+static void heap_sift(sched_heap_t* heap, uint32_t idx) {
+    volatile tcb_t* task = heap->items[idx];
+    uint32_t key = heap_key(heap, task);
+
+    /* up while it's earlier than its parent */
+    while (idx > 0 && before(key, heap_key(heap, heap->items[(idx - 1) / 2]))) {
+        heap_place(heap, idx, heap->items[(idx - 1) / 2]);
+        idx = (idx - 1) / 2;
+    }
+
+    /* down while a child is earlier */
+    while (1) {
+        uint32_t child = (2 * idx) + 1;
+        if (child >= heap->count) {
+            break;
+        }
+        if (child + 1 < heap->count &&
+            before(heap_key(heap, heap->items[child + 1]), heap_key(heap, heap->items[child]))) {
+            child++;
+        }
+        if (!before(heap_key(heap, heap->items[child]), key)) {
+            break;
+        }
+        heap_place(heap, idx, heap->items[child]);
+        idx = child;
+    }
+
+    heap_place(heap, idx, task);
+}
+
+static void heap_push(sched_heap_t* heap, volatile tcb_t* task) {
+    heap_place(heap, heap->count++, task);
+    heap_sift(heap, heap->count - 1);
+}
+
+static void heap_remove(sched_heap_t* heap, volatile tcb_t* task) {
+    uint32_t idx = task->edf.heap_idx;
+    volatile tcb_t* last = heap->items[--heap->count];
+
+    if (idx != heap->count) {
+        heap_place(heap, idx, last);
+        heap_sift(heap, idx);
+    }
+}
+
+/*
+ * the two classes behind one interface, a task is either on its priority's queue or in the
+ * EDF ready heap
+ */
+static inline bool is_edf(volatile tcb_t* task) {
+    return task->edf.period != 0;
+}
+
+static void make_ready(volatile tcb_t* task, bool at_head) {
+    task->status = STATUS_READY;
+    if (is_edf(task)) {
+        heap_push(&scheduler.edf_ready, task);
+    } else {
+        enqueue(task, at_head);
+    }
+}
+
+static void unready(volatile tcb_t* task) {
+    if (is_edf(task)) {
+        heap_remove(&scheduler.edf_ready, task);
+    } else {
+        dequeue(task);
+    }
+}
+
+static volatile tcb_t* best_ready(void) {
+    if (scheduler.edf_ready.count != 0) {
+        return scheduler.edf_ready.items[0];
+    }
+    if (scheduler.ready_map != 0) {
+        return scheduler.ready_head[31 - __builtin_clz(scheduler.ready_map)];
+    }
+    return NULL;
+}
+
+/* whether a should have the cpu instead of b, a tie only goes to a when rotating */
+static bool outranks(volatile tcb_t* a, volatile tcb_t* b, bool rotate) {
+    if (is_edf(a) != is_edf(b)) {
+        return is_edf(a);
+    }
+
+    int32_t diff = is_edf(a) ? (int32_t)(b->edf.abs_deadline - a->edf.abs_deadline) :
+                               (int32_t)a->priority - (int32_t)b->priority;
+    return (diff > 0) || (diff == 0 && rotate);
+}
+
+/* a new job released at release */
+static void start_job(volatile tcb_t* task, uint32_t release) {
+    task->edf.release = release;
+    task->edf.abs_deadline = release + task->edf.deadline;
+    task->edf.budget_left = task->edf.budget;
+    task->edf.jobs++;
+}
+
+/* off the cpu until the period after the current job's release */
+static void wait_next_period(volatile tcb_t* task) {
+    task->status = STATUS_WAITING;
+    task->edf.release += task->edf.period;
+    heap_push(&scheduler.edf_waiting, task);
+}
+
+/*
+ * switch to the best READY task if it should run instead of the running one. a slice running
+ * out or a yield lets an equal priority task in, the running task then goes to the back of its
+ * queue. a preempted task goes back to the front, it didn't get to finish its slice. the
+ * running task is next rather than current, next is the one that runs once a pending switch
+ * is done
+ */
+enum resched {
+    RESCHED_OUTRANK,            /* only something that outranks the running task */
+    RESCHED_SLICE,
+    RESCHED_YIELD
+};
+
+static void reschedule(enum resched why) {
+    if (!scheduler.started) {
+        return;
+    }
+
+    volatile tcb_t* best = best_ready();
+    if (best == NULL) {
+        return;
+    }
+
+    bool rotate = (why != RESCHED_OUTRANK);
+    volatile tcb_t* running = scheduler.next;
+    if (running != NULL && running->status == STATUS_RUNNING) {
+        if (!outranks(best, running, rotate)) {
+            return;
+        }
+        make_ready(running, !rotate);
+        if (why == RESCHED_YIELD) {
+            running->cpu.voluntary++;
+        } else {
+            running->cpu.preemptions++;
+        }
+    } else if (running != NULL) {
+        /* blocked, asleep or done with its job */
+        running->cpu.voluntary++;
+    }
+
+    unready(best);
+    best->status = STATUS_RUNNING;
+    best->slice_left = SCHED_TIMESLICE_TICKS;
+    scheduler.next = best;
+    scheduler.switches++;
+    port_pend_switch();
+}
+
+int sched_admit(tcb_t* task) {
+    /* without a tick nothing would ever be released */
+    if (SCHED_TICK_HZ == 0) {
+        return _ERR;
+    }
+    if (task->edf.budget == 0 || task->edf.budget > task->edf.deadline ||
+        task->edf.deadline > task->edf.period) {
+        return _ERR;
+    }
+
+    /* rounded up, a set that only fits thanks to rounding doesn't */
+    uint32_t util = (uint32_t)((((uint64_t)task->edf.budget * 1000000u) + task->edf.deadline - 1) /
+                               task->edf.deadline);
+
+    uint32_t primask = port_irq_save();
+    if (util > SCHED_EDF_UTIL_PPM - scheduler.edf_util_ppm) {
+        port_irq_restore(primask);
+        return _NOP;
+    }
+    scheduler.edf_util_ppm += util;
+    port_irq_restore(primask);
+
+    task->edf.util_ppm = util;
+    return _OK;
+}
+
+void sched_unadmit(volatile tcb_t* task) {
+    uint32_t primask = port_irq_save();
+    scheduler.edf_util_ppm -= task->edf.util_ppm;
+    task->edf.util_ppm = 0;
+    port_irq_restore(primask);
+}
+
+void sched_ready(volatile tcb_t* task) {
+    uint32_t primask = port_irq_save();
+
+    /* whatever it was blocked on is done with it */
+    task->wait.cancel = NULL;
+
+    /* a system call that blocked returns what the task was woken with (see syscall.h) */
+    if (task->syscall_frame != NULL) {
+        task->syscall_frame[0] = task->wait.value;
+        task->syscall_frame = NULL;
+    }
+
+    /*
+     * an EDF task gets a fresh job when it's new or run again after a suspend. woken from a
+     * sleep or a wait it carries on with the job it had, deadline and budget left included
+     */
+    if (is_edf(task) && (task->status == STATUS_NULL || task->status == STATUS_SUSPENDED)) {
+        start_job(task, scheduler.ticks);
+    }
+    make_ready(task, false);
+    reschedule(RESCHED_OUTRANK);
+
+    port_irq_restore(primask);
+}
+
+void sched_block(volatile tcb_t* task, enum Status status) {
+    uint32_t primask = port_irq_save();
+
+    if (task->status == STATUS_READY) {
+        unready(task);
+        task->status = status;
+    } else if (task->status == STATUS_WAITING) {
+        heap_remove(&scheduler.edf_waiting, task);
+        task->status = status;
+    } else if (task->status == STATUS_SLEEPING) {
+        _ktimer_cancel(&scheduler.timers, (ktimer_t*)&task->sleep);
+        task->status = status;
+    } else if (task->status == STATUS_BLOCKED) {
+        _ktimer_cancel(&scheduler.timers, (ktimer_t*)&task->sleep);
+        if (task->wait.cancel != NULL) {
+            task->wait.cancel(task);
+        }
+        task->wait.cancel = NULL;
+        task->wait.value = 0;
+        task->status = status;
+    } else if (task->status == STATUS_RUNNING) {
+        task->status = status;
+        reschedule(RESCHED_OUTRANK);
+    } else {
+        task->status = status;
+    }
+
+    port_irq_restore(primask);
+}
+
+void sched_set_priority(volatile tcb_t* task, uint8_t priority) {
+    uint32_t primask = port_irq_save();
+
+    if (task->priority != priority) {
+        bool lowered = priority < task->priority;
+        if (task->status == STATUS_READY && !is_edf(task)) {
+            dequeue(task);
+            task->priority = priority;
+            enqueue(task, false);
+            reschedule(RESCHED_OUTRANK);
+        } else {
+            task->priority = priority;
+            if (task->status == STATUS_RUNNING && lowered) {
+                reschedule(RESCHED_OUTRANK);
+            }
+        }
+    }
+
+    port_irq_restore(primask);
+}
+
+/*
+ * blocking on kernel objects
+ */
+static void wait_timeout(void* arg) {
+    volatile tcb_t* task = arg;
+
+    if (task->status == STATUS_BLOCKED) {
+        if (task->wait.cancel != NULL) {
+            task->wait.cancel(task);
+        }
+        task->wait.value = 0;
+        sched_ready(task);
+    }
+}
+
+void sched_wait(uint32_t timeout) {
+    uint32_t primask = port_irq_save();
+
+    volatile tcb_t* task = scheduler.current;
+    if (timeout != SCHED_WAIT_FOREVER) {
+        ktimer_t* timer = (ktimer_t*)&task->sleep;
+        _ktimer_setup(timer, wait_timeout, (void*)task);
+        _ktimer_start(&scheduler.timers, timer, timeout, 0);
+    }
+    sched_block(task, STATUS_BLOCKED);
+
+    port_irq_restore(primask);
+}
+
+void sched_wake(volatile tcb_t* task, uint32_t value) {
+    uint32_t primask = port_irq_save();
+
+    if (task->status == STATUS_BLOCKED) {
+        _ktimer_cancel(&scheduler.timers, (ktimer_t*)&task->sleep);
+        task->wait.value = value;
+        sched_ready(task);
+    }
+
+    port_irq_restore(primask);
+}
+
+void sched_waitq_add(volatile tcb_t** head, volatile tcb_t* task) {
+    volatile tcb_t* prev = NULL;
+    volatile tcb_t* at = *head;
+
+    while (at != NULL && sched_rank(at) >= sched_rank(task)) {
+        prev = at;
+        at = at->ready_next;
+    }
+    task->ready_prev = prev;
+    task->ready_next = at;
+    if (prev != NULL) {
+        prev->ready_next = task;
+    } else {
+        *head = task;
+    }
+    if (at != NULL) {
+        at->ready_prev = task;
+    }
+}
+
+void sched_waitq_remove(volatile tcb_t** head, volatile tcb_t* task) {
+    if (task->ready_prev != NULL) {
+        task->ready_prev->ready_next = task->ready_next;
+    } else {
+        *head = task->ready_next;
+    }
+    if (task->ready_next != NULL) {
+        task->ready_next->ready_prev = task->ready_prev;
+    }
+    task->ready_next = NULL;
+    task->ready_prev = NULL;
+}
+
+/*
+ * deferred work, a lock free stack. an ISR can push while another one it interrupted is half
+ * way through pushing, the loser's strex fails and it goes again. queued keeps each item on it
+ * once, PendSV takes the whole stack in one go
+ */
+void sched_defer(sched_deferred_t* work) {
+    if (!port_cas(&work->queued, 0, 1)) {
+        return;
+    }
+
+    sched_deferred_t* head;
+    do {
+        head = scheduler.deferred;
+        work->next = head;
+    } while (!port_cas_ptr((void* volatile*)&scheduler.deferred, head, work));
+    port_pend_switch();
+}
+
+void sched_run_deferred(void) {
+    sched_deferred_t* work;
+    do {
+        work = scheduler.deferred;
+    } while (work != NULL && !port_cas_ptr((void* volatile*)&scheduler.deferred, work, NULL));
+
+    while (work != NULL) {
+        sched_deferred_t* next = work->next;
+
+        /* cleared first, anything deferred from here on gets it run again */
+        work->queued = 0;
+        port_dmb();
+        uint32_t primask = port_irq_save();
+        work->run(work->arg);
+        port_irq_restore(primask);
+        work = next;
+    }
+}
+
+/*
+ * clock and timers
+ */
+static inline void count_ticks(uint32_t ticks) {
+    uint32_t was = scheduler.ticks;
+
+    scheduler.ticks = was + ticks;
+    if (scheduler.ticks < was) {
+        scheduler.tick_wraps++;
+    }
+}
+
+uint64_t sched_clock_us(void) {
+#if SCHED_TICK_HZ > 0
+    uint32_t primask = port_irq_save();
+    uint64_t ticks = ((uint64_t)scheduler.tick_wraps << 32) | scheduler.ticks;
+    uint32_t into_tick = 0;
+
+#if !defined(SPRINTER_HOST)
+    /* a reload that's happened but hasn't been counted yet is a whole tick more */
+    uint32_t val = SYSTICK->VAL;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET) {
+        ticks++;
+        val = SYSTICK->VAL;
+    }
+    into_tick = (CPU_CLOCK_HZ / SCHED_TICK_HZ) - 1 - val;
+#endif
+    port_irq_restore(primask);
+
+    return ((ticks * 1000000u) / SCHED_TICK_HZ) + (into_tick / (CPU_CLOCK_HZ / 1000000u));
+#else
+    return 0;
+#endif
+}
+
+int sched_timer_start(ktimer_t* timer, uint32_t delay, uint32_t period) {
+    uint32_t primask = port_irq_save();
+    int err = _ktimer_start(&scheduler.timers, timer, delay, period);
+    port_irq_restore(primask);
+
+    return err;
+}
+
+int sched_timer_cancel(ktimer_t* timer) {
+    uint32_t primask = port_irq_save();
+    int err = _ktimer_cancel(&scheduler.timers, timer);
+    port_irq_restore(primask);
+
+    return err;
+}
+
+static void wake(void* arg) {
+    volatile tcb_t* task = arg;
+
+    if (task->status == STATUS_SLEEPING) {
+        sched_ready(task);
+    }
+}
+
+void sched_sleep_until(uint32_t tick) {
+    uint32_t primask = port_irq_save();
+
+    volatile tcb_t* task = scheduler.current;
+    uint32_t delay = tick - scheduler.timers.now;
+    if (task != NULL && task->status == STATUS_RUNNING && (int32_t)delay > 0) {
+        ktimer_t* timer = (ktimer_t*)&task->sleep;
+        _ktimer_setup(timer, wake, (void*)task);
+        _ktimer_start(&scheduler.timers, timer, delay, 0);
+        task->status = STATUS_SLEEPING;
+        reschedule(RESCHED_OUTRANK);
+    }
+
+    port_irq_restore(primask);
+}
+
+void sched_sleep(uint32_t ticks) {
+    sched_sleep_until(scheduler.ticks + ticks);
+}
+
+void sched_yield(void) {
+    uint32_t primask = port_irq_save();
+    reschedule(RESCHED_YIELD);
+    port_irq_restore(primask);
+}
+
+/* the current job is done, the task sleeps until its next release */
+void sched_wait_period(void) {
+    uint32_t primask = port_irq_save();
+
+    volatile tcb_t* task = scheduler.current;
+    if (task != NULL && is_edf(task) && task->status == STATUS_RUNNING) {
+        /* done some time in this tick, so the tick the deadline falls on is already too late */
+        if (!before(scheduler.ticks, task->edf.abs_deadline)) {
+            task->edf.deadline_misses++;
+        }
+        wait_next_period(task);
+        reschedule(RESCHED_OUTRANK);
+    }
+
+    port_irq_restore(primask);
+}
+
+void sched_exit(void) {
+    uint32_t primask = port_irq_save();
+    remove_task(scheduler.tasks, scheduler.current->tid);
+    port_irq_restore(primask);
+
+    /* root can't be removed, so there's always something to switch to */
+    while (1) {
+    }
+}
+
+#if SCHED_TICK_HZ > 0 && !defined(SPRINTER_HOST)
+#define SCHED_TICK_CYCLES       (CPU_CLOCK_HZ / SCHED_TICK_HZ)
+
+/* ticks root can sleep through, bounded by how far SysTick can count, timers and EDF releases */
+static uint32_t idle_ticks_allowed(void) {
+    uint32_t ticks = _ktimer_idle_ticks(&scheduler.timers, SYSTICK_MAX_RELOAD / SCHED_TICK_CYCLES);
+
+    if (scheduler.edf_waiting.count != 0) {
+        uint32_t until = scheduler.edf_waiting.items[0]->edf.release - scheduler.ticks;
+        if ((int32_t)until < (int32_t)ticks) {
+            ticks = ((int32_t)until > 0) ? until : 0;
+        }
+    }
+    return ticks;
+}
+
+/*
+ * one SysTick period stretched over ticks, returns how many whole ticks went by. called with
+ * interrupts masked, whatever woke the core is taken once they're back on
+ */
+static uint32_t idle_sleep(uint32_t ticks, uint32_t* woke) {
+    /* the part of the current tick that's already gone counts towards the first one */
+    SYSTICK->CTRL &= ~SYSTICK_CTRL_ENABLE;
+    SYSTICK->LOAD = SYSTICK->VAL + ((ticks - 1) * SCHED_TICK_CYCLES);
+    SYSTICK->VAL = 0;
+    SYSTICK->CTRL |= SYSTICK_CTRL_ENABLE;
+
+    port_wait_for_interrupt();
+    *woke = port_cycles();
+
+    /* reading CTRL clears COUNTFLAG, so only once */
+    uint32_t ctrl = SYSTICK->CTRL;
+    SYSTICK->CTRL = ctrl & ~SYSTICK_CTRL_ENABLE;
+
+    uint32_t slept;
+    if (ctrl & SYSTICK_CTRL_COUNTFLAG) {
+        /* slept the whole way, the pending SysTick_Handler counts the last tick */
+        slept = ticks - 1;
+        SYSTICK->LOAD = SCHED_TICK_CYCLES - 1;
+    } else {
+        /* woken early, finish the tick we're in and go back to the normal period after it */
+        uint32_t done = (ticks * SCHED_TICK_CYCLES) - SYSTICK->VAL;
+        slept = done / SCHED_TICK_CYCLES;
+        SYSTICK->LOAD = ((slept + 1) * SCHED_TICK_CYCLES) - done;
+    }
+    SYSTICK->VAL = 0;
+    SYSTICK->CTRL |= SYSTICK_CTRL_ENABLE;
+
+    count_ticks(slept);
+    SYSTICK->LOAD = SCHED_TICK_CYCLES - 1;      /* picked up at the next reload */
+
+    return slept;
+}
+#endif
+
+void sched_idle(void) {
+    uint32_t primask = port_irq_save();
+
+    /* checked with interrupts masked so a wakeup can't slip in between the check and the wfi */
+    if (scheduler.ready_map != 0 || scheduler.edf_ready.count != 0 ||
+        scheduler.next != scheduler.current) {
+        port_irq_restore(primask);
+        return;
+    }
+    scheduler.idle.sleeps++;
+
+    uint32_t woke;
+#if SCHED_TICK_HZ > 0 && !defined(SPRINTER_HOST)
+    uint32_t ticks = idle_ticks_allowed();
+    if (ticks >= SCHED_IDLE_MIN_TICKS) {
+        scheduler.idle.idle_ticks += idle_sleep(ticks, &woke);
+    } else {
+        port_wait_for_interrupt();
+        woke = port_cycles();
+    }
+#else
+    port_wait_for_interrupt();
+    woke = port_cycles();
+#endif
+
+    scheduler.idle.wake_cycles_last = port_cycles() - woke;
+    if (scheduler.idle.wake_cycles_last > scheduler.idle.wake_cycles_max) {
+        scheduler.idle.wake_cycles_max = scheduler.idle.wake_cycles_last;
+    }
+    port_irq_restore(primask);
+}
+
+int sched_idle_stats(sched_idle_stats_t* stats) {
+    if (stats == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    *stats = scheduler.idle;
+    stats->ticks = scheduler.ticks;
+    port_irq_restore(primask);
+
+    return _OK;
+}
+
+void SysTick_Handler(void) {
+    /* interrupts above the tick can wake tasks and start timers too */
+    uint32_t primask = port_irq_save();
+    count_ticks(1);
+    bool rotate = false;
+    bool resched = false;
+
+    /* charged to whoever had the tick that just ended, before any release preempts it */
+    volatile tcb_t* running = scheduler.next;
+
+    /* periods that have come round, each one a new job */
+    sched_heap_t* waiting = &scheduler.edf_waiting;
+    while (waiting->count != 0 && !before(scheduler.ticks, waiting->items[0]->edf.release)) {
+        volatile tcb_t* task = waiting->items[0];
+        heap_remove(waiting, task);
+        start_job(task, task->edf.release);
+        make_ready(task, false);
+        resched = true;
+    }
+
+    if (running != NULL && running->status == STATUS_RUNNING && is_edf(running)) {
+        /* a job that runs through its budget is throttled to its next period */
+        if (--running->edf.budget_left == 0) {
+            running->edf.overruns++;
+            wait_next_period(running);
+            resched = true;
+        }
+    }
+#if SCHED_TIMESLICE_TICKS > 0
+    else if (running != NULL && running->slice_left != 0 && --running->slice_left == 0) {
+        running->slice_left = SCHED_TIMESLICE_TICKS;
+        rotate = true;
+        resched = true;
+    }
+#endif
+
+    if (resched) {
+        reschedule(rotate ? RESCHED_SLICE : RESCHED_OUTRANK);
+    }
+
+    /* last, so a task woken here can't be charged for the tick that just ended */
+    _ktimer_advance(&scheduler.timers, scheduler.ticks);
+    port_irq_restore(primask);
+}
+
+void sched_start(void) {
+#if !defined(SPRINTER_HOST)
+    /* switching happens below everything else, the tick and system calls just above it */
+    SCB->SHPR3 = (SCB->SHPR3 & ~((0xFFu << SCB_SHPR3_PENDSV_SHIFT) | (0xFFu << SCB_SHPR3_SYSTICK_SHIFT))) |
+                 (PRIO_LOWEST << SCB_SHPR3_PENDSV_SHIFT) | (PRIO_KERNEL_TICK << SCB_SHPR3_SYSTICK_SHIFT);
+    SCB->SHPR2 = (SCB->SHPR2 & ~(0xFFu << SCB_SHPR2_SVCALL_SHIFT)) | (PRIO_KERNEL_TICK << SCB_SHPR2_SVCALL_SHIFT);
+    port_cycle_counter_init();
+    port_fpu_lazy_init();
+    mpu_init();
+#endif
+
+    uint32_t primask = port_irq_save();
+    scheduler.current = NULL;
+    scheduler.next = NULL;
+    scheduler.started = true;
+    reschedule(RESCHED_OUTRANK);
+
+#if !defined(SPRINTER_HOST)
+#if SCHED_TICK_HZ > 0
+    SYSTICK->LOAD = (CPU_CLOCK_HZ / SCHED_TICK_HZ) - 1;
+    SYSTICK->VAL = 0;
+    SYSTICK->CTRL = SYSTICK_CTRL_CLKSOURCE | SYSTICK_CTRL_TICKINT | SYSTICK_CTRL_ENABLE;
+#endif
+    (void)primask;
+    port_irq_restore(0);
+
+    /* PendSV is taken as soon as interrupts are back on and doesn't come back here */
+    while (1) {
+    }
+#else
+    port_irq_restore(primask);
+#endif
+}
@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sem.h"
+#include "core/sprinter_common.h"
+#include "core/tcb.h"
+
+static void hand_out(void* arg);
+
+int sem_init(sem_t* sem, uint32_t count, uint32_t max) {
+    if (sem == NULL || max == 0 || count > max) {
+        return _ERR;
+    }
+
+    sem->count = count;
+    sem->max = max;
+    sem->waiters = NULL;
+    sem->waiting = 0;
+    sem->wake = (sched_deferred_t){ NULL, 0, hand_out, sem };
+    sem->stats = (sem_stats_t){ 0 };
+
+    return _OK;
+}
+
+static bool take_one(sem_t* sem) {
+    uint32_t count;
+
+    do {
+        count = sem->count;
+        if (count == 0) {
+            return false;
+        }
+    } while (!port_cas(&sem->count, count, count - 1));
+
+    return true;
+}
+
+/* from PendSV with interrupts masked, whatever's been given since goes to the waiters in order */
+static void hand_out(void* arg) {
+    sem_t* sem = arg;
+
+    while (sem->waiters != NULL && take_one(sem)) {
+        volatile tcb_t* task = sem->waiters;
+        sched_waitq_remove(&sem->waiters, task);
+        sem->waiting--;
+        sem->stats.woken++;
+        sched_wake(task, 1);
+    }
+}
+
+/* timed out, suspended or removed while it waited */
+static void cancel_take(volatile tcb_t* task) {
+    sem_t* sem = task->wait.obj;
+
+    sched_waitq_remove(&sem->waiters, task);
+    sem->waiting--;
+    sem->stats.timeouts++;
+}
+
+int sem_give(sem_t* sem) {
+    if (sem == NULL) {
+        return _ERR;
+    }
+
+    uint32_t count;
+    do {
+        count = sem->count;
+        if (count >= sem->max) {
+            return _NOP;
+        }
+    } while (!port_cas(&sem->count, count, count + 1));
+
+    /* a task that queued before the cas is seen here, one that queues after it sees the count */
+    if (sem->waiters != NULL) {
+        sched_defer(&sem->wake);
+    }
+    return _OK;
+}
+
+int sem_take(sem_t* sem, uint32_t timeout) {
+    if (sem == NULL) {
+        return _ERR;
+    }
+
+    if (take_one(sem)) {
+        return _OK;
+    }
+    if (timeout == 0) {
+        return _NOP;
+    }
+
+    uint32_t primask = port_irq_save();
+    if (take_one(sem)) {
+        port_irq_restore(primask);
+        return _OK;
+    }
+
+    volatile tcb_t* self = scheduler.current;
+    sched_waitq_add(&sem->waiters, self);
+    self->wait = (tcb_wait_t){ cancel_take, sem, port_cycles(), 0, 0 };
+    sem->waiting++;
+    sem->stats.blocked++;
+    if (sem->waiting > sem->stats.waiters_max) {
+        sem->stats.waiters_max = sem->waiting;
+    }
+    sched_wait(timeout);
+    port_irq_restore(primask);
+
+    /* back once hand_out gave it a count, or it stopped waiting */
+    return (self->wait.value != 0) ? _OK : _NOP;
+}
+
+int sem_stats(const sem_t* sem, sem_stats_t* stats) {
+    if (sem == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    *stats = sem->stats;
+    port_irq_restore(primask);
+
+    return _OK;
+}
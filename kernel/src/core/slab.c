@@ -0,0 +1,276 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sprinter_common.h"
+#include "mem.h"
+#include "slab.h"
+
+/*
+ * page map and list helpers
+ */
+static inline uint32_t page_of(address_t target) {
+    return (uint32_t)((target - USERSPACE_HEAP_START_ADDR) / SLAB_PAGE_SIZE_B);
+}
+
+static inline slab_t* slab_of(address_t target) {
+    return (slab_t*)(USERSPACE_HEAP_START_ADDR + ((address_t)page_of(target) * SLAB_PAGE_SIZE_B));
+}
+
+static inline uint32_t owner_list(tid_t owner) {
+    return (owner < MAX_TASKS) ? owner : MAX_TASKS;
+}
+
+static void list_push(slab_t** head, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void list_remove(slab_t** head, slab_t* slab) {
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+/* a slab is on its owner's partial list while it has objects in use and room for more */
+static inline bool on_partial(const slab_cache_t* cache, const slab_t* slab) {
+    return (slab->in_use != 0) && (slab->in_use < cache->objs_per_slab);
+}
+
+/* give a slab's page back to the buddy heap */
+static void release_page(heap_manager* heap_mgr, slab_cache_t* cache, slab_t* slab) {
+    uint32_t page = page_of((address_t)slab);
+
+    heap_mgr->slab_map[page >> 5] &= ~(1u << (page & 31));
+    cache->stats.slabs--;
+    _mblock_free(heap_mgr, (address_t)slab);
+}
+
+void _slab_init(heap_manager* heap_mgr) {
+    for (uint32_t c = 0; c < SLAB_CLASSES; c++) {
+        slab_cache_t* cache = &heap_mgr->slab_caches[c];
+
+        for (uint32_t o = 0; o < SLAB_OWNER_LISTS; o++) {
+            cache->partial[o] = NULL;
+        }
+        cache->empty = NULL;
+        cache->obj_size = (uint16_t)(SLAB_MIN_OBJ_SIZE_B << c);
+        cache->objs_per_slab = (uint16_t)((SLAB_PAGE_SIZE_B - SLAB_HEADER_SIZE_B) / cache->obj_size);
+        cache->stats = (slab_stats_t){ 0 };
+    }
+
+    for (uint32_t w = 0; w < MEM_SLAB_MAP_WORDS; w++) {
+        heap_mgr->slab_map[w] = 0;
+    }
+}
+
+int _slab_owns(const heap_manager* heap_mgr, address_t target) {
+    uint32_t page = page_of(target);
+    return (heap_mgr->slab_map[page >> 5] >> (page & 31)) & 1u;
+}
+
+/*
+ * alloc: first partial slab of the requestor, else the cached empty slab, else a new page
+ */
+static slab_t* new_slab(heap_manager* heap_mgr, slab_cache_t* cache, uint32_t class_id, tid_t owner) {
+    slab_t* slab = cache->empty;
+
+    if (slab != NULL) {
+        cache->empty = NULL;
+        _mtransfer(heap_mgr, (address_t)slab, owner);
+    } else {
+        address_t page = _mblock_alloc(heap_mgr, SLAB_PAGE_SIZE_B, owner);
+        if (page == (address_t)_ERR) {
+            return NULL;
+        }
+
+        uint32_t p = page_of(page);
+        heap_mgr->slab_map[p >> 5] |= (1u << (p & 31));
+        cache->stats.slabs++;
+        slab = (slab_t*)page;
+    }
+
+    /* bits past the last object read as taken, so the lowest clear bit is always a real object */
+    uint32_t objs = cache->objs_per_slab;
+    for (uint32_t w = 0; w < SLAB_USED_WORDS; w++) {
+        if (objs >= (w + 1) * 32) {
+            slab->used[w] = 0;
+        } else if (objs <= w * 32) {
+            slab->used[w] = ~0u;
+        } else {
+            slab->used[w] = ~0u << (objs - (w * 32));
+        }
+    }
+
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->in_use = 0;
+    slab->class_id = (uint8_t)class_id;
+    slab->owner = (uint8_t)owner;
+
+    return slab;
+}
+
+address_t _slab_alloc(heap_manager* heap_mgr, memsize_t req_size, tid_t requestor) {
+    if ((req_size == 0) || (req_size > SLAB_MAX_OBJ_SIZE_B)) {
+        return (address_t)_ERR;
+    }
+
+    uint32_t obj_size = round_up_to_power_of_2(req_size);
+    if (obj_size < SLAB_MIN_OBJ_SIZE_B) {
+        obj_size = SLAB_MIN_OBJ_SIZE_B;
+    }
+    uint32_t class_id = (uint32_t)(__builtin_ctz(obj_size) - __builtin_ctz(SLAB_MIN_OBJ_SIZE_B));
+    slab_cache_t* cache = &heap_mgr->slab_caches[class_id];
+    slab_t** partial = &cache->partial[owner_list(requestor)];
+
+    slab_t* slab = *partial;
+    if (slab == NULL) {
+        slab = new_slab(heap_mgr, cache, class_id, requestor);
+        if (slab == NULL) {
+            cache->stats.failures++;
+            return (address_t)_ERR;
+        }
+        list_push(partial, slab);
+    }
+
+    /* lowest free object, a slab on a partial list always has one */
+    uint32_t w = (slab->used[0] != ~0u) ? 0 : 1;
+    uint32_t i = (w * 32) + (uint32_t)__builtin_ctz(~slab->used[w]);
+    slab->used[w] |= 1u << (i & 31);
+    slab->in_use++;
+    address_t obj = (address_t)slab + SLAB_HEADER_SIZE_B + ((address_t)i * cache->obj_size);
+
+    /* full slabs aren't on any list, free puts them back */
+    if (slab->in_use == cache->objs_per_slab) {
+        list_remove(partial, slab);
+    }
+
+    cache->stats.allocs++;
+    cache->stats.objs_in_use++;
+
+    return obj;
+}
+
+/* target's object number in its slab, or -1 if it isn't the start of one that's handed out */
+static int32_t live_obj(const heap_manager* heap_mgr, const slab_t* slab, address_t target) {
+    if (slab->class_id >= SLAB_CLASSES) {
+        return -1;
+    }
+
+    const slab_cache_t* cache = &heap_mgr->slab_caches[slab->class_id];
+    address_t offset = target - (address_t)slab;
+    if ((offset < SLAB_HEADER_SIZE_B) || (((offset - SLAB_HEADER_SIZE_B) % cache->obj_size) != 0)) {
+        return -1;
+    }
+
+    uint32_t i = (uint32_t)((offset - SLAB_HEADER_SIZE_B) / cache->obj_size);
+    if ((i >= cache->objs_per_slab) || ((slab->used[i >> 5] & (1u << (i & 31))) == 0)) {
+        return -1;
+    }
+    return (int32_t)i;
+}
+
+/* the object's page is its slab, and everything on it has the same owner */
+tid_t _slab_owner(const heap_manager* heap_mgr, address_t target) {
+    const slab_t* slab = slab_of(target);
+    return (live_obj(heap_mgr, slab, target) < 0) ? MEM_OWNER_NONE : slab->owner;
+}
+
+/*
+ * free: clear the object's bit, empty slabs are cached once and then go back to the heap
+ */
+int _slab_free(heap_manager* heap_mgr, address_t target) {
+    slab_t* slab = slab_of(target);
+    int32_t i = live_obj(heap_mgr, slab, target);
+    if (i < 0) {
+        return _ERR;
+    }
+
+    slab_cache_t* cache = &heap_mgr->slab_caches[slab->class_id];
+    slab_t** partial = &cache->partial[owner_list(slab->owner)];
+    bool was_partial = on_partial(cache, slab);
+
+    slab->used[(uint32_t)i >> 5] &= ~(1u << ((uint32_t)i & 31));
+    slab->in_use--;
+    mem_released(&heap_mgr->release, slab->owner, target);
+    cache->stats.frees++;
+    cache->stats.objs_in_use--;
+
+    if (slab->in_use == 0) {
+        if (was_partial) {
+            list_remove(partial, slab);
+        }
+
+        /* keep one empty slab per cache, owned by nobody so a task's reclaim can't take it */
+        if (cache->empty == NULL) {
+            _mtransfer(heap_mgr, (address_t)slab, (tid_t)TID_NULL);
+            slab->owner = MEM_OWNER_NONE;
+            cache->empty = slab;
+        } else {
+            release_page(heap_mgr, cache, slab);
+        }
+    } else if (!was_partial) {
+        list_push(partial, slab);
+    }
+
+    return _OK;
+}
+
+/* the owner of this slab is going away, drop it and everything in it */
+void _slab_reclaim(heap_manager* heap_mgr, address_t target) {
+    slab_t* slab = slab_of(target);
+    slab_cache_t* cache = &heap_mgr->slab_caches[slab->class_id];
+
+    if (on_partial(cache, slab)) {
+        list_remove(&cache->partial[owner_list(slab->owner)], slab);
+    }
+    if (cache->empty == slab) {
+        cache->empty = NULL;
+    }
+
+    cache->stats.frees += slab->in_use;
+    cache->stats.objs_in_use -= slab->in_use;
+    release_page(heap_mgr, cache, slab);
+}
+
+memsize_t _slab_obj_size(heap_manager* heap_mgr, address_t target) {
+    slab_t* slab = slab_of(target);
+    if (slab->class_id >= SLAB_CLASSES) {
+        return 0;
+    }
+
+    return heap_mgr->slab_caches[slab->class_id].obj_size;
+}
+
+void _slab_shrink(heap_manager* heap_mgr) {
+    for (uint32_t c = 0; c < SLAB_CLASSES; c++) {
+        slab_cache_t* cache = &heap_mgr->slab_caches[c];
+
+        if (cache->empty != NULL) {
+            slab_t* slab = cache->empty;
+            cache->empty = NULL;
+            release_page(heap_mgr, cache, slab);
+        }
+    }
+}
+
+int _slab_stats(heap_manager* heap_mgr, uint32_t class_id, slab_stats_t* stats) {
+    if (heap_mgr == NULL || stats == NULL || class_id >= SLAB_CLASSES) {
+        return _ERR;
+    }
+
+    *stats = heap_mgr->slab_caches[class_id].stats;
+    return _OK;
+}
@@ -0,0 +1,140 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sprinter_common.h"
+#include "mem.h"
+#include "stack.h"
+
+/*
+ * chunk bitmap helpers, runs can straddle words when the arena isn't aligned to the stack size
+ */
+/* whether every chunk in the run is used (or free) */
+static bool run_is(const stack_arena_t* arena, uint32_t first, uint32_t count, bool used) {
+    while (count > 0) {
+        uint32_t bit = first % 32;
+        uint32_t len = (count < 32 - bit) ? count : 32 - bit;
+        uint32_t mask = (len == 32) ? ~0u : (((1u << len) - 1) << bit);
+
+        if ((arena->used_map[first / 32] & mask) != (used ? mask : 0)) {
+            return false;
+        }
+        first += len;
+        count -= len;
+    }
+    return true;
+}
+
+static void run_mark(stack_arena_t* arena, uint32_t first, uint32_t count, bool used) {
+    while (count > 0) {
+        uint32_t bit = first % 32;
+        uint32_t len = (count < 32 - bit) ? count : 32 - bit;
+        uint32_t mask = (len == 32) ? ~0u : (((1u << len) - 1) << bit);
+
+        if (used) {
+            arena->used_map[first / 32] |= mask;
+        } else {
+            arena->used_map[first / 32] &= ~mask;
+        }
+        first += len;
+        count -= len;
+    }
+}
+
+void _stack_init(stack_arena_t* arena) {
+    arena->start = USERSPACE_STACKS_START_ADDR;
+    for (uint32_t w = 0; w < STACK_MAP_WORDS; w++) {
+        arena->used_map[w] = 0;
+    }
+
+    /* the tail of the last word is past the arena, never free */
+    if (STACK_CHUNKS % 32 != 0) {
+        arena->used_map[STACK_MAP_WORDS - 1] = ~0u << (STACK_CHUNKS % 32);
+    }
+
+    arena->stats = (stack_stats_t){ 0 };
+    arena->stats.size = USERSPACE_STACKS_SIZE_B;
+}
+
+address_t _stack_alloc(stack_arena_t* arena, memsize_t* size) {
+    if (arena == NULL || size == NULL || *size == 0 || *size > USERSPACE_STACKS_SIZE_B) {
+        return (address_t)_ERR;
+    }
+
+    memsize_t stack_size = (*size <= STACK_CHUNK_B) ? STACK_CHUNK_B :
+                           (memsize_t)1 << (32 - __builtin_clz((uint32_t)*size - 1));
+    uint32_t count = (uint32_t)(stack_size / STACK_CHUNK_B);
+
+    /* first chunk that sits on a stack_size boundary, then every count chunks after it */
+    address_t aligned = (arena->start + stack_size - 1) & ~(address_t)(stack_size - 1);
+    for (uint32_t first = (uint32_t)((aligned - arena->start) / STACK_CHUNK_B);
+         first + count <= STACK_CHUNKS; first += count) {
+        if (!run_is(arena, first, count, false)) {
+            continue;
+        }
+
+        run_mark(arena, first, count, true);
+        arena->stats.stacks++;
+        arena->stats.used += stack_size;
+        if (arena->stats.used > arena->stats.high_water) {
+            arena->stats.high_water = arena->stats.used;
+        }
+
+        *size = stack_size;
+        return arena->start + ((address_t)first * STACK_CHUNK_B);
+    }
+
+    arena->stats.failures++;
+    return (address_t)_ERR;
+}
+
+int _stack_free(stack_arena_t* arena, address_t bottom, memsize_t size) {
+    if (arena == NULL) {
+        return _ERR;
+    }
+
+    /* has to be a whole stack this arena handed out */
+    if (bottom < arena->start || size < STACK_CHUNK_B || (size & (size - 1)) != 0 ||
+        (bottom & (size - 1)) != 0 || bottom + size > arena->start + USERSPACE_STACKS_SIZE_B) {
+        return _NOP;
+    }
+    uint32_t first = (uint32_t)((bottom - arena->start) / STACK_CHUNK_B);
+    uint32_t count = (uint32_t)(size / STACK_CHUNK_B);
+    if (!run_is(arena, first, count, true)) {
+        return _NOP;
+    }
+
+    run_mark(arena, first, count, false);
+    arena->stats.stacks--;
+    arena->stats.used -= size;
+
+    return _OK;
+}
+
+void _stack_paint(address_t bottom, memsize_t size) {
+    volatile uint32_t* word = (volatile uint32_t*)bottom;
+    volatile uint32_t* top = (volatile uint32_t*)(bottom + size);
+
+    while (word < top) {
+        *word++ = STACK_PAINT_WORD;
+    }
+}
+
+memsize_t _stack_used(address_t bottom, memsize_t size, memsize_t known) {
+    const volatile uint32_t* word = (const volatile uint32_t*)bottom;
+    const volatile uint32_t* limit = (const volatile uint32_t*)(bottom + size - known);
+
+    while (word < limit && *word == STACK_PAINT_WORD) {
+        word++;
+    }
+    return (memsize_t)(bottom + size - (address_t)word);
+}
+
+int _stack_stats(const stack_arena_t* arena, stack_stats_t* stats) {
+    if (arena == NULL || stats == NULL) {
+        return _ERR;
+    }
+
+    *stats = arena->stats;
+    return _OK;
+}
@@ -0,0 +1,250 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/event.h"
+#include "core/kobj.h"
+#include "core/mem.h"
+#include "core/mpu.h"
+#include "core/msgq.h"
+#include "core/mutex.h"
+#include "core/port.h"
+#include "core/sched.h"
+#include "core/sem.h"
+#include "core/sprinter_common.h"
+#include "core/syscall.h"
+#include "core/tcb.h"
+#include "core/tcb_buf.h"
+
+typedef address_t (*syscall_fn)(volatile address_t* args);
+
+/* only ever written from the svc, which can't preempt itself */
+static syscall_stats_t stats[SYS_COUNT];
+
+static inline heap_manager* heap(void) {
+    return scheduler.tasks->heap_mgr;
+}
+
+/*
+ * an unprivileged caller's buffer has to be on its own stack above the guard (the kernel would
+ * fault on it there, and a fault in the kernel halts), or be a heap block or slab object of its
+ * own from the start
+ */
+static bool user_buffer(volatile tcb_t* task, address_t base, memsize_t size) {
+    if (!task->unprivileged) {
+        return true;
+    }
+
+    address_t low = task->stack_high - task->stack_size + MPU_GUARD_B;
+    if (base >= low && base < task->stack_high && size <= task->stack_high - base) {
+        return true;
+    }
+
+    uint32_t primask = port_irq_save();
+    bool owned = (_mowner(heap(), base) == task->tid) && (size <= _msize(heap(), base));
+    port_irq_restore(primask);
+    return owned;
+}
+
+/* an unprivileged caller only gets to run or suspend itself */
+static bool user_task(volatile tcb_t* task, tid_t target) {
+    return !task->unprivileged || target == task->tid;
+}
+
+/*
+ * the calls, args is the caller's stacked r0 - r3
+ */
+static address_t svc_exit(volatile address_t* args) {
+    (void)args;
+    /* switched away on the way out, the stack it's still on stays put until then */
+    return (address_t)remove_task(scheduler.tasks, scheduler.current->tid);
+}
+
+static address_t svc_yield(volatile address_t* args) {
+    (void)args;
+    sched_yield();
+    return _OK;
+}
+
+static address_t svc_task_id(volatile address_t* args) {
+    (void)args;
+    return scheduler.current->tid;
+}
+
+static address_t svc_task_run(volatile address_t* args) {
+    if (!user_task(scheduler.current, (tid_t)args[0])) {
+        return (address_t)_ERR;
+    }
+    return (address_t)run_task(scheduler.tasks, (tid_t)args[0]);
+}
+
+static address_t svc_task_suspend(volatile address_t* args) {
+    if (!user_task(scheduler.current, (tid_t)args[0])) {
+        return (address_t)_ERR;
+    }
+    return (address_t)suspend_task(scheduler.tasks, (tid_t)args[0]);
+}
+
+static address_t svc_sleep(volatile address_t* args) {
+    sched_sleep((uint32_t)args[0]);
+    return _OK;
+}
+
+static address_t svc_ticks(volatile address_t* args) {
+    (void)args;
+    return scheduler.ticks;
+}
+
+static address_t svc_malloc(volatile address_t* args) {
+    return _malloc(heap(), (memsize_t)args[0], scheduler.current->tid);
+}
+
+/* masked across both, or the block could change hands between the check and the free */
+static address_t svc_free(volatile address_t* args) {
+    address_t ret = _NOP;
+    uint32_t primask = port_irq_save();
+
+    if (_mowner(heap(), args[0]) == scheduler.current->tid) {
+        ret = (address_t)_free(heap(), args[0]);
+    }
+
+    port_irq_restore(primask);
+    return ret;
+}
+
+/*
+ * objects are by handle (kobj.h), one that doesn't name a live object of the right type is
+ * _ERR, or 0 from the calls that block
+ */
+static address_t svc_msgq_send(volatile address_t* args) {
+    msgq_t* queue = kobj_get((kobj_t)args[0], KOBJ_MSGQ);
+    if (queue == NULL || !user_buffer(scheduler.current, args[1], queue->msg_size)) {
+        return (address_t)_ERR;
+    }
+    return (address_t)msgq_send(queue, (const void*)args[1]);
+}
+
+static address_t svc_msgq_recv(volatile address_t* args) {
+    msgq_t* queue = kobj_get((kobj_t)args[0], KOBJ_MSGQ);
+    if (queue == NULL || !user_buffer(scheduler.current, args[1], queue->msg_size)) {
+        return (address_t)_ERR;
+    }
+    return (address_t)msgq_recv(queue, (void*)args[1], false);
+}
+
+/* _mgive trusts the block is one, _mowner is what checks that */
+static address_t svc_msgq_send_block(volatile address_t* args) {
+    msgq_t* queue = kobj_get((kobj_t)args[0], KOBJ_MSGQ);
+    if (queue == NULL || (tid_t)args[2] >= MAX_TASKS) {
+        return (address_t)_ERR;
+    }
+    if (_mowner(heap(), args[1]) != scheduler.current->tid) {
+        return _NOP;
+    }
+    return (address_t)msgq_send_block(queue, heap(), args[1], (tid_t)args[2]);
+}
+
+static address_t svc_sem_give(volatile address_t* args) {
+    return (address_t)sem_give(kobj_get((kobj_t)args[0], KOBJ_SEM));
+}
+
+static address_t svc_sem_take(volatile address_t* args) {
+    return (sem_take(kobj_get((kobj_t)args[0], KOBJ_SEM), (uint32_t)args[1]) == _OK) ? 1 : 0;
+}
+
+static address_t svc_event_set(volatile address_t* args) {
+    return (address_t)event_set(kobj_get((kobj_t)args[0], KOBJ_EVENT), (uint32_t)args[1]);
+}
+
+static address_t svc_event_wait(volatile address_t* args) {
+    uint32_t got = 0;
+    if (event_wait(kobj_get((kobj_t)args[0], KOBJ_EVENT), (uint32_t)args[1], (uint32_t)args[2],
+                   (uint32_t)args[3], &got) != _OK) {
+        return 0;
+    }
+    return got;
+}
+
+static address_t svc_mutex_lock(volatile address_t* args) {
+    return (mutex_lock(kobj_get((kobj_t)args[0], KOBJ_MUTEX), (uint32_t)args[1]) == _OK) ? 1 : 0;
+}
+
+static address_t svc_mutex_unlock(volatile address_t* args) {
+    return (address_t)mutex_unlock(kobj_get((kobj_t)args[0], KOBJ_MUTEX));
+}
+
+static const syscall_fn calls[SYS_COUNT] = {
+    [SYS_EXIT]            = svc_exit,
+    [SYS_YIELD]           = svc_yield,
+    [SYS_TASK_ID]         = svc_task_id,
+    [SYS_TASK_RUN]        = svc_task_run,
+    [SYS_TASK_SUSPEND]    = svc_task_suspend,
+    [SYS_SLEEP]           = svc_sleep,
+    [SYS_TICKS]           = svc_ticks,
+    [SYS_MALLOC]          = svc_malloc,
+    [SYS_FREE]            = svc_free,
+    [SYS_MSGQ_SEND]       = svc_msgq_send,
+    [SYS_MSGQ_RECV]       = svc_msgq_recv,
+    [SYS_MSGQ_SEND_BLOCK] = svc_msgq_send_block,
+    [SYS_SEM_GIVE]        = svc_sem_give,
+    [SYS_SEM_TAKE]        = svc_sem_take,
+    [SYS_EVENT_SET]       = svc_event_set,
+    [SYS_EVENT_WAIT]      = svc_event_wait,
+    [SYS_MUTEX_LOCK]      = svc_mutex_lock,
+    [SYS_MUTEX_UNLOCK]    = svc_mutex_unlock,
+};
+
+/*
+ * the frame goes on tcb.syscall_frame before the call rather than after, so a wake that gets
+ * in before dispatch is done can't be missed. if the task isn't blocked when the call returns
+ * it's taken off again and the call's own result goes in r0, if a wake already used it the
+ * value it left there stands
+ */
+void syscall_dispatch(volatile address_t* frame) {
+    uint32_t call = (uint32_t)frame[SYSCALL_FRAME_CALL];
+    if (call >= SYS_COUNT) {
+        frame[0] = (address_t)_ERR;
+        return;
+    }
+
+    uint32_t start = port_cycles();
+    volatile tcb_t* self = scheduler.current;
+    self->syscall_frame = frame;
+
+    address_t ret = calls[call](frame);
+
+    uint32_t primask = port_irq_save();
+    if (self->syscall_frame == frame && self->status != STATUS_BLOCKED) {
+        self->syscall_frame = NULL;
+        frame[0] = ret;
+    }
+    port_irq_restore(primask);
+
+    uint32_t cycles = port_cycles() - start;
+    syscall_stats_t* s = &stats[call];
+    s->calls++;
+    s->cycles_total += cycles;
+    if (cycles > s->cycles_max) {
+        s->cycles_max = cycles;
+    }
+}
+
+int syscall_stats(uint32_t call, syscall_stats_t* out) {
+    if (call >= SYS_COUNT || out == NULL) {
+        return _ERR;
+    }
+
+    uint32_t primask = port_irq_save();
+    *out = stats[call];
+    port_irq_restore(primask);
+
+    return _OK;
+}
+
+void sys_exit(void) {
+    (void)syscall4(SYS_EXIT, 0, 0, 0, 0);
+
+    /* root can't be removed, so there's always something to switch to */
+    while (1) {
+    }
+}
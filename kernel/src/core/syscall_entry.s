@@ -0,0 +1,28 @@
+/**
+ ******************************************************************************
+ * @file      syscall_entry.s
+ * @author    Steven Mu
+ * @summary   SVC handler, the way into the kernel for unprivileged tasks (see
+ *            syscall.h). the hardware stacked the caller's r0-r3 and r12 on
+ *            whichever stack it was on, EXC_RETURN bit 2 says which. that
+ *            frame goes to syscall_dispatch as it is, which reads the call
+ *            and its arguments from it and leaves the result in its r0 for
+ *            the exception return to pop
+ ******************************************************************************
+ */
+
+  .syntax unified
+  .cpu cortex-m7
+  .thumb
+
+.global SVC_Handler
+
+  .section .text.SVC_Handler
+  .type SVC_Handler, %function
+SVC_Handler:
+  tst   lr, #0x4              /* EXC_RETURN bit 2 set, the caller was on psp */
+  ite   eq
+  mrseq r0, msp
+  mrsne r0, psp
+  b     syscall_dispatch      /* lr is still EXC_RETURN, dispatch returns out of the exception */
+  .size SVC_Handler, .-SVC_Handler
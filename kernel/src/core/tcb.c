@@ -1,12 +1,45 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/sched.h"
 #include "core/tcb.h"
+#include "core/tcb_buf.h"
+#include "drivers/iwdg.h"
+
+/*
+ * build the frame the first switch to this task pops, r0 gets the args and returning from
+ * ptask lands in exit
+ */
+void tcb_init_frame(tcb_t* task, void (*exit)(void)) {
+    uint32_t* frame = (uint32_t*)(task->stack_high & ~(address_t)0x7);
+
+    *(--frame) = TCB_XPSR_THUMB;
+    *(--frame) = (uint32_t)(address_t)task->ptask & ~1u;    /* exception return wants bit 0 clear */
+    *(--frame) = (uint32_t)(address_t)exit;
+    *(--frame) = 0;                                         /* r12 */
+    *(--frame) = 0;                                         /* r3 */
+    *(--frame) = 0;                                         /* r2 */
+    *(--frame) = 0;                                         /* r1 */
+    *(--frame) = (uint32_t)(address_t)task->args;           /* r0 */
+
+    *(--frame) = TCB_EXC_RETURN_THREAD;
+    for (uint32_t i = 0; i < TCB_SW_FRAME_WORDS - 1; i++) {
+        *(--frame) = 0;                                     /* r11 - r4 */
+    }
+
+    task->sp = (address_t)frame;
+}
 
 /* 
- * root function basically a nulltask right now
+ * root function basically a nulltask right now, runs whenever nothing else wants to so it's
+ * also what keeps the watchdog fed and the stack high water marks current. sleeps in between
+ * rather than spinning
  */
 void root(void *args) {
     (void)args;
-    while(1);
+    while(1) {
+        iwdg_reset();
+        task_stack_scan_next(scheduler.tasks);
+        sched_idle();
+    }
 }
@@ -1,41 +1,114 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/ktimer.h"
 #include "core/mem.h"
+#include "core/mpu.h"
+#include "core/mutex.h"
+#include "core/port.h"
+#include "core/sched.h"
 #include "core/sprinter_common.h"
+#include "core/stack.h"
+#include "core/syscall.h"
 #include "core/tcb.h"
 #include "core/tcb_buf.h"
 
+/* the heap's release hook, a block the task no longer owns can't stay granted to it */
+static void release_grants(void* ctx, tid_t owner, address_t base) {
+    volatile tcb_t* task = &((taskbuff_t*)ctx)->buffer[owner];
+
+    uint32_t primask = port_irq_save();
+    if (mpu_revoke(task, base) == _OK && task == scheduler.current) {
+#if !defined(SPRINTER_HOST)
+        mpu_load(task);
+#endif
+    }
+    port_irq_restore(primask);
+}
+
+int init_taskbuff(taskbuff_t* tasks, heap_manager* heap_mgr) {
+    if (tasks == NULL || heap_mgr == NULL) {
+        return _ERR;
+    }
+
+    for (uint32_t i = 0; i < MAX_TASKS; i++) {
+        tasks->buffer[i].status = STATUS_NULL;
+    }
+    for (uint32_t w = 0; w < (MAX_TASKS + 31) / 32; w++) {
+        tasks->free_slots[w] = 0;
+    }
+    for (uint32_t i = 0; i < MAX_TASKS; i++) {
+        tasks->free_slots[i / 32] |= (1u << (i % 32));
+    }
+    tasks->tasks_in_buf = 0;
+    tasks->heap_mgr = heap_mgr;
+    heap_mgr->release = (mem_release_t){ release_grants, tasks };
+    _stack_init(&tasks->stacks);
+    tasks->scan_next = 0;
+    tasks->created = 0;
+
+    return _OK;
+}
+
 /* create task and helpers */
 static int add_task(taskbuff_t *tasks, tcb_t new_task) {
     if (tasks == NULL) {
         return _ERR;
     }
+
+    uint32_t primask = port_irq_save();
     if (tasks->tasks_in_buf >= MAX_TASKS) {
+        port_irq_restore(primask);
+        return _NOP;
+    }
+
+    /* stack first, a task that doesn't fit shouldn't use up a tid */
+    address_t stack_low = _stack_alloc(&tasks->stacks, &new_task.stack_size);
+    if (stack_low == (address_t)_ERR) {
+        port_irq_restore(primask);
         return _NOP;
     }
 
     /*
-     * find the next free spot and set its tid and insert the task
+     * lowest free slot from the bitmap, that's its tid. a word per 32 tasks to look at rather
+     * than every tcb
      */
-    for (uint32_t i = 0; i < MAX_TASKS; i++) {
-        if (tasks->buffer[i].status == STATUS_NULL) {
-            new_task.tid = i;
-            new_task.status = STATUS_READY;
-            new_task.stack_high = USERSPACE_END_ADDR - (i * STACK_SIZE);
-            new_task.stack_size = STACK_SIZE;
-            tasks->buffer[i] = new_task;
-            tasks->tasks_in_buf++;
-            return _OK;
-        }
+    uint32_t w = 0;
+    while (tasks->free_slots[w] == 0) {
+        w++;
     }
+    uint32_t i = (w * 32) + (uint32_t)__builtin_ctz(tasks->free_slots[w]);
+    tasks->free_slots[w] &= ~(1u << (i % 32));
+    tasks->tasks_in_buf++;
+    new_task.serial = ++tasks->created;
+    port_irq_restore(primask);
 
-    /* this should never return this */
-    return _ERR;
+    new_task.tid = i;
+    new_task.status = STATUS_NULL;
+    new_task.stack_high = stack_low + new_task.stack_size;
+    new_task.stack_peak = 0;
+    new_task.cpu = (tcb_cpu_t){ 0 };
+    mpu_task_init(&new_task);
+    new_task.ready_next = NULL;
+    new_task.ready_prev = NULL;
+    _ktimer_setup(&new_task.sleep, NULL, NULL);
+    new_task.wait = (tcb_wait_t){ NULL, NULL, 0, 0, 0 };
+    new_task.boosting = NULL;
+    new_task.syscall_frame = NULL;
+    _stack_paint(stack_low, new_task.stack_size);
+    /* an unprivileged task can't call sched_exit, it returns into the system call instead */
+    tcb_init_frame(&new_task, new_task.unprivileged ? sys_exit : sched_exit);
+    tasks->buffer[i] = new_task;
+
+    /* only visible to the scheduler once the whole tcb is in place */
+    sched_ready(&tasks->buffer[i]);
+    return _OK;
 }
 
-int create_task(taskbuff_t* tasks, void (*callback)(void*), void* args) {
-    if (tasks == NULL || callback == NULL) {
+/* stack_size gets rounded up to a power of two, at least STACK_CHUNK_B */
+int create_task(taskbuff_t* tasks, void (*callback)(void*), void* args, uint8_t priority,
+                memsize_t stack_size, uint32_t flags) {
+    if (tasks == NULL || callback == NULL || priority >= SCHED_PRIORITIES) {
         return _ERR;
     }
     if (tasks->tasks_in_buf >= MAX_TASKS) {
@@ -45,10 +118,54 @@ int create_task(taskbuff_t* tasks, void (*callback)(void*), void* args) {
     tcb_t task;
     task.ptask = callback;
     task.args = args;
+    task.priority = priority;
+    task.base_priority = priority;
+    task.fpu_used = 0;
+    task.unprivileged = (flags & TASK_UNPRIVILEGED) ? 1 : 0;
+    task.slice_left = SCHED_TIMESLICE_TICKS;
+    task.stack_size = stack_size;
+    task.edf = (tcb_edf_t){ 0 };
 
     return(add_task(tasks, task));
 }
 
+/*
+ * periodic task under EDF, all in ticks. a job is released every period, must finish within
+ * deadline of its release and gets budget ticks of cpu to do it in. _NOP when the task would
+ * take the EDF class past SCHED_EDF_UTIL_PPM
+ */
+int create_rt_task(taskbuff_t* tasks, void (*callback)(void*), void* args, uint32_t period,
+                   uint32_t deadline, uint32_t budget, memsize_t stack_size, uint32_t flags) {
+    if (tasks == NULL || callback == NULL) {
+        return _ERR;
+    }
+    if (tasks->tasks_in_buf >= MAX_TASKS) {
+        return _NOP;
+    }
+
+    tcb_t task;
+    task.ptask = callback;
+    task.args = args;
+    task.priority = 0;
+    task.base_priority = 0;
+    task.fpu_used = 0;
+    task.unprivileged = (flags & TASK_UNPRIVILEGED) ? 1 : 0;
+    task.slice_left = SCHED_TIMESLICE_TICKS;
+    task.stack_size = stack_size;
+    task.edf = (tcb_edf_t){ .period = period, .deadline = deadline, .budget = budget };
+
+    int err = sched_admit(&task);
+    if (err) {
+        return err;
+    }
+
+    err = add_task(tasks, task);
+    if (err) {
+        sched_unadmit(&task);
+    }
+    return err;
+}
+
 /* remove a task from the buffer */
 int remove_task(taskbuff_t *tasks, tid_t target_tid) {
     if (tasks == NULL) {
@@ -60,17 +177,41 @@ int remove_task(taskbuff_t *tasks, tid_t target_tid) {
         return _NOP;
     }
 
-    if (tasks->buffer[target_tid].status == STATUS_NULL) {
+    volatile tcb_t* target_task = &(tasks->buffer[target_tid]);
+    uint32_t primask = port_irq_save();
+    if (target_task->status == STATUS_NULL) {
+        port_irq_restore(primask);
         return _NOP;
     }
-    tasks->buffer[target_tid].status = STATUS_NULL;
+    sched_block(target_task, STATUS_NULL);
+    if (target_task->edf.period != 0) {
+        sched_unadmit(target_task);
+    }
+    mutex_abandon(target_task);
+
+    /*
+     * anything the task still had on the heap goes back with it. still masked, a task removing
+     * itself is switched away for good as soon as they're back on and would never get to it
+     */
+    if (tasks->heap_mgr != NULL) {
+        _free_all_owned(tasks->heap_mgr, target_tid);
+    }
+
+    /*
+     * a task removing itself is still on this stack until the switch away, nothing can be
+     * handed it before then since only task code creates tasks
+     */
+    _stack_free(&tasks->stacks, target_task->stack_high - target_task->stack_size, target_task->stack_size);
+    tasks->free_slots[target_tid / 32] |= (1u << (target_tid % 32));
     tasks->tasks_in_buf--;
+    port_irq_restore(primask);
 
     return _OK;
 }
 
-int run_task(taskbuff_t *tasks, tid_t target_tid, volatile tcb_t** current_task) {
-    if (tasks == NULL || current_task == NULL) {
+/* back on the ready queue if it was suspended */
+int run_task(taskbuff_t *tasks, tid_t target_tid) {
+    if (tasks == NULL) {
         return _ERR;
     }
 
@@ -79,18 +220,37 @@ int run_task(taskbuff_t *tasks, tid_t target_tid, volatile tcb_t** current_task)
     }
 
     volatile tcb_t* target_task = &(tasks->buffer[target_tid]);
-    if (target_task->status == STATUS_NULL) {
+    if (target_task->status != STATUS_SUSPENDED) {
+        return _NOP;
+    }
+
+    sched_ready(target_task);
+    return _OK;
+}
+
+/* off the cpu or its ready queue until run_task, suspending yourself switches away */
+int suspend_task(taskbuff_t *tasks, tid_t target_tid) {
+    if (tasks == NULL) {
+        return _ERR;
+    }
+
+    /* root is what reschedule falls back on, it always has to be runnable */
+    if (target_tid == 0 || target_tid >= MAX_TASKS) {
         return _NOP;
     }
 
-    /* set task to running */
-    target_task->status = STATUS_RUNNING;
-    *current_task = target_task;
+    volatile tcb_t* target_task = &(tasks->buffer[target_tid]);
+    if (target_task->status == STATUS_NULL || target_task->status == STATUS_SUSPENDED) {
+        return _NOP;
+    }
+
+    sched_block(target_task, STATUS_SUSPENDED);
     return _OK;
 }
 
-int suspend_task(taskbuff_t *tasks, tid_t target_tid, volatile tcb_t** current_task) {
-    if (tasks == NULL || current_task == NULL) {
+/* lets an unprivileged task at one more block, a task has MPU_GRANTS of them */
+int grant_task(taskbuff_t *tasks, tid_t target_tid, address_t base, memsize_t size) {
+    if (tasks == NULL) {
         return _ERR;
     }
 
@@ -99,12 +259,139 @@ int suspend_task(taskbuff_t *tasks, tid_t target_tid, volatile tcb_t** current_t
     }
 
     volatile tcb_t* target_task = &(tasks->buffer[target_tid]);
+    uint32_t primask = port_irq_save();
+    int err = _NOP;
+
+    /* only the task's own blocks, the heap takes the grant back when it stops owning it */
+    if (target_task->status != STATUS_NULL && _mowner(tasks->heap_mgr, base) == target_tid &&
+        size <= _msize(tasks->heap_mgr, base)) {
+        uint32_t slot = mpu_grant_slot(target_task, base);
+        if (slot < MPU_GRANTS) {
+            err = mpu_grant(target_task, slot, base, size);
+        }
+    }
+
+#if !defined(SPRINTER_HOST)
+    /* everyone else picks theirs up on the next switch */
+    if (err == _OK && target_task == scheduler.current) {
+        mpu_load(target_task);
+    }
+#endif
+    port_irq_restore(primask);
+
+    return err;
+}
+
+/*
+ * the scan runs with interrupts on, it can take a while on a big stack. the stack is only
+ * looked up and the result only stored with them off, and only if the task is still the one
+ * that stack belonged to
+ */
+static int scan_stack(taskbuff_t *tasks, tid_t target_tid) {
+    volatile tcb_t* target_task = &(tasks->buffer[target_tid]);
+
+    uint32_t primask = port_irq_save();
     if (target_task->status == STATUS_NULL) {
+        port_irq_restore(primask);
+        return _NOP;
+    }
+    address_t stack_high = target_task->stack_high;
+    memsize_t stack_size = target_task->stack_size;
+    memsize_t known = target_task->stack_peak;
+    port_irq_restore(primask);
+
+    /* the guard at the bottom is never written, a task that got there has already faulted */
+    memsize_t peak = _stack_used(stack_high - stack_size + MPU_GUARD_B, stack_size - MPU_GUARD_B, known);
+
+    primask = port_irq_save();
+    if (target_task->status != STATUS_NULL && target_task->stack_high == stack_high &&
+        peak > target_task->stack_peak) {
+        target_task->stack_peak = peak;
+    }
+    port_irq_restore(primask);
+
+    return _OK;
+}
+
+int task_stack_usage(taskbuff_t *tasks, tid_t target_tid, task_stack_t* usage) {
+    if (tasks == NULL || usage == NULL) {
+        return _ERR;
+    }
+
+    if (target_tid >= MAX_TASKS) {
         return _NOP;
     }
 
-    /* set task to suspended */
-    target_task->status = STATUS_SUSPENDED;
-    *current_task = NULL;
+    int err = scan_stack(tasks, target_tid);
+    if (err != _OK) {
+        return err;
+    }
+    usage->size = tasks->buffer[target_tid].stack_size;
+    usage->peak = tasks->buffer[target_tid].stack_peak;
+
+    return _OK;
+}
+
+void task_stack_scan_next(taskbuff_t *tasks) {
+    if (tasks == NULL) {
+        return;
+    }
+
+    /* an empty slot just costs a look at its status, the next call moves on */
+    scan_stack(tasks, tasks->scan_next);
+    tasks->scan_next = (tasks->scan_next + 1) % MAX_TASKS;
+}
+
+/*
+ * cycles the task has run, the one on the cpu is credited up to now. called with interrupts
+ * masked
+ */
+static uint64_t cpu_cycles(volatile tcb_t* task) {
+    uint64_t cycles = task->cpu.run_cycles;
+
+    if (task == scheduler.current) {
+        cycles += (uint32_t)(*scheduler.cycle_source - scheduler.switch_stamp);
+    }
+    return cycles;
+}
+
+int task_cpu_top(taskbuff_t *tasks, task_cpu_t* top, uint32_t max, uint32_t* count) {
+    if (tasks == NULL || top == NULL || count == NULL) {
+        return _ERR;
+    }
+
+    /* every cycle is charged to some task, so together they're the window */
+    uint64_t window = 0;
+    uint32_t n = 0;
+    for (tid_t t = 0; t < MAX_TASKS && n < max; t++) {
+        volatile tcb_t* task = &tasks->buffer[t];
+
+        uint32_t primask = port_irq_save();
+        if (task->status == STATUS_NULL) {
+            port_irq_restore(primask);
+            continue;
+        }
+        uint64_t cycles = cpu_cycles(task);
+        top[n].tid = task->tid;
+        top[n].priority = task->priority;
+        top[n].status = task->status;
+        top[n].cycles = cycles;
+        top[n].recent = cycles - task->cpu.top_mark;
+        top[n].switches = task->cpu.switches;
+        top[n].preemptions = task->cpu.preemptions;
+        top[n].voluntary = task->cpu.voluntary;
+        task->cpu.top_mark = cycles;
+        port_irq_restore(primask);
+
+        window += top[n].recent;
+        n++;
+    }
+
+    /* exact as long as calls are less than a day or so of cycles apart */
+    for (uint32_t i = 0; i < n; i++) {
+        top[i].util_ppm = (window == 0) ? 0 : (uint32_t)((top[i].recent * 1000000u) / window);
+    }
+    *count = n;
+
     return _OK;
 }
@@ -6,6 +6,16 @@
 #include "drivers/uart.h"
 #include "stm32f7.h"
 
+#if defined(SPRINTER_QEMU)
+#include "drivers/semihost.h"
+
+/* qemu's mps2 boards have no usart, characters go out over semihosting instead */
+static int uart_write_char(char data) {
+	semihost_call(SEMIHOST_SYS_WRITEC, &data);
+
+	return 0;
+}
+#else
 static int uart_write_char(char data) {
 	while (READ_BIT(UART_1->ISR, 7) == 0);			/* check TXE till high */
 	UART_1->TDR = (data & 0xFF);					/* write data into TDR */
@@ -13,6 +23,7 @@ static int uart_write_char(char data) {
 
 	return 0;
 }
+#endif
 
 /**
  * support various output formats
@@ -29,9 +40,9 @@ static int uart_output_hex(int input) {
 	for (int i = 28; i >= 0; i-=4) {
 		value = (input >> i) & 0x0F;				/* get value of the 4 bits we're on */
 		if (value < 10) {							/* depends on value, print hex char */
-			hex_char = '0' + value;
+			hex_char = (char)('0' + value);
 		} else {
-			hex_char = 'A' + (value - 10);
+			hex_char = (char)('A' + (value - 10));
 		}
 		uart_write_char(hex_char);
 	}
@@ -97,7 +108,9 @@ int uart_out(char* string, ...) {
 	uart_write_char(new_line);
 
 	/* to indicate end of transmission, TC bit is pulled high. Poll until done */
+#if !defined(SPRINTER_QEMU)
 	while ((READ_BIT(UART_1->ISR, 6) == 0));
+#endif
 
 	return 0;
 }
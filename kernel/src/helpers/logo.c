@@ -1,6 +1,7 @@
 #include "helpers/logo.h"
 
 #include "core/mem.h"
+#include "core/stack.h"
 #include "drivers/uart.h"
 
 #define SPRINTER_VERSION "0.1.0"
@@ -33,7 +34,7 @@ void print_logo(void) {
              USERSPACE_HEAP_START_ADDR, USERSPACE_HEAP_END_ADDR,
              USERSPACE_HEAP_SIZE / 1024);
     uart_out("[0.000000]   task stacks   %h - %h  %d KB",
-             USERSPACE_END_ADDR - USERSPACE_STACKS_SIZE_B, USERSPACE_END_ADDR,
+             USERSPACE_STACKS_START_ADDR, USERSPACE_END_ADDR,
              USERSPACE_STACKS_SIZE_B / 1024);
     uart_out("[0.000000]   kernel image  %h - %h  %d KB",
              KERNEL_IMG_ORIGIN, KERNEL_IMG_ORIGIN + KERNEL_IMG_SIZE_B,
@@ -41,6 +42,6 @@ void print_logo(void) {
     uart_out("[0.000000]");
     uart_out("[0.000000] Buddy allocator: %d KB pool, %d B min block, %d nodes",
              USERSPACE_HEAP_SIZE / 1024, MEM_BUDDY_MIN_BLOCK_SIZE_B, MEM_BUDDY_MAX_BLOCKS);
-    uart_out("[0.000000] Tasks: %d max, %d KB stack each", MAX_TASKS, STACK_SIZE / 1024);
+    uart_out("[0.000000] Tasks: %d max, stacks from %d B, %d KB default", MAX_TASKS, STACK_CHUNK_B, STACK_SIZE / 1024);
     uart_out("[0.000000]");
 }
@@ -0,0 +1,59 @@
+#include "helpers/mem_dump.h"
+
+#include "core/kmem.h"
+#include "core/mem.h"
+#include "drivers/uart.h"
+
+static void print_user_heap(heap_manager* heap_mgr) {
+    mem_stats_t stats;
+    if (_mstats(heap_mgr, &stats) != _OK) {
+        return;
+    }
+
+    uart_out("user heap: %d B used, %d B free, largest free %d B",
+             (int)stats.bytes_used, (int)stats.bytes_free, (int)stats.largest_free);
+    uart_out("  allocs %d  frees %d  failures %d",
+             (int)stats.allocs, (int)stats.frees, (int)stats.failures);
+
+    /* buddy layers go from the whole heap down, tlsf first levels from small up */
+    for (uint32_t c = 0; c < MEM_FREE_CLASSES; c++) {
+        if (stats.free_blocks[c] != 0) {
+            uart_out("  class %d: %d free", (int)c, (int)stats.free_blocks[c]);
+        }
+    }
+
+    for (uint32_t t = 0; t < MAX_TASKS; t++) {
+        if (stats.owner_bytes[t] != 0) {
+            uart_out("  tid %d: %d B", (int)t, (int)stats.owner_bytes[t]);
+        }
+    }
+    if (stats.kernel_bytes != 0) {
+        uart_out("  kernel: %d B", (int)stats.kernel_bytes);
+    }
+}
+
+static void print_kernel_heap(const kmem_arena_t* kernel_mem) {
+    kmem_stats_t stats;
+    if (_kmstats(kernel_mem, &stats) != _OK) {
+        return;
+    }
+
+    uart_out("kernel heap: %d / %d B used, high water %d B, failures %d",
+             (int)stats.used, (int)stats.size, (int)stats.high_water, (int)stats.failures);
+
+    for (const kmem_pool_t* pool = kernel_mem->pools; pool != NULL; pool = pool->next) {
+        uart_out("  %s: %d in use of %d, high water %d, failures %d",
+                 (pool->name != NULL) ? (char*)pool->name : "pool",
+                 (int)pool->stats.in_use, (int)pool->stats.capacity,
+                 (int)pool->stats.high_water, (int)pool->stats.failures);
+    }
+}
+
+void print_mem_stats(heap_manager* heap_mgr, const kmem_arena_t* kernel_mem) {
+    if (heap_mgr != NULL) {
+        print_user_heap(heap_mgr);
+    }
+    if (kernel_mem != NULL) {
+        print_kernel_heap(kernel_mem);
+    }
+}
@@ -3,43 +3,73 @@
 #include <stdarg.h>
 
 #include "stm32f7.h"
+#include "core/kmem.h"
+#include "core/kobj.h"
 #include "core/mem.h"
+#include "core/sched.h"
 #include "core/tcb.h"
 #include "core/tcb_buf.h"
 #include "drivers/iwdg.h"
 #include "drivers/uart.h"
 #include "helpers/logo.h"
+#include "helpers/mem_dump.h"
+
+#if defined(SPRINTER_BENCH)
+#include "qemu_bench.h"
+#endif
 
 /* kernel globals */
+static kmem_arena_t kernel_mem;
 static heap_manager userspace_heap_mgr;
 
-/* tasks */
-static taskbuff_t tasks;
-static volatile tcb_t *active_task;
+/* tasks, the buffer itself lives in the kernel heap */
+static taskbuff_t *tasks;
 
 /*
  * SPRINTEROS KERNEL MAIN FUNCTION
  */
 int _main(void) {
+#if defined(SPRINTER_BENCH)
+    bench_boot_mark();
+#endif
     print_logo();
 
+    _kminit(&kernel_mem);
+    uart_out("[0.000000] SprinterOS kernel heap initialized, %d B in dtcm", (int)kernel_mem.stats.size);
+    if (kobj_init(&kernel_mem)) {
+        goto err_state;
+    }
+
     _minit(&userspace_heap_mgr);
-    /* no timer yet so stamp is just temp */
+    /* the clock starts with the scheduler, everything before it really is at 0 */
     uart_out("[0.000000] SprinterOS heap manager initialized");
 
+    tasks = _kmalloc(&kernel_mem, sizeof(taskbuff_t));
+    if (init_taskbuff(tasks, &userspace_heap_mgr)) {
+        goto err_state;
+    }
+    if (sched_init(tasks)) {
+        goto err_state;
+    }
+    print_mem_stats(&userspace_heap_mgr, &kernel_mem);
+
+#if defined(SPRINTER_BENCH)
+    /* benchmark image, measures and exits instead of starting root */
+    kernel_bench(&userspace_heap_mgr, &kernel_mem, tasks);
+#endif
+
     /* 
      * jump to root task (userspace stack) and we should never come back to _main
      * since nothing is allocated in main there is basically nothing left on the
      * kernel stack for this function
      */
-    if (create_task(&tasks, root, NULL)) {
+    if (create_task(tasks, root, NULL, SCHED_PRIO_IDLE, STACK_SIZE, 0)) {
         goto err_state;
     }
+    uart_out("[0.000000] SprinterOS scheduler starting, %d Hz tick", SCHED_TICK_HZ);
+    sched_start();
 
-    /* 
-     * right now since no userspace must go here. However once we jump to root task
-     * we should never be in this loop ever
-     */
+    /* sched_start never returns, we only end up here if bringup failed */
 err_state:
     while (1) {
         iwdg_reset();
@@ -9,21 +9,48 @@ BUILD_DIR  = build/obj
 INCLUDES   = -Iinc -Iinc/core -Iinc/drivers -Isrc -I../memmap -I../common
 
 DEFS := -DDEBUG -DSTM32 -DSTM32F7 -DSTM32F767ZITx
+
+# userspace heap allocator, buddy + slab by default or "make sprinter MEM_ALLOCATOR=tlsf"
+# (make clean when switching). MEM_TRACE=1 logs every allocation over uart for the replayer
+MEM_ALLOCATOR ?= buddy
+ifeq ($(MEM_ALLOCATOR),tlsf)
+DEFS += -DMEM_USE_TLSF
+MEM_SRCS := $(SOURCE_DIR)/core/mem_tlsf.c
+else
+MEM_SRCS := $(SOURCE_DIR)/core/mem.c $(SOURCE_DIR)/core/slab.c
+endif
+ifeq ($(MEM_TRACE),1)
+DEFS += -DMEM_TRACE
+endif
 CFLAGS := $(MCUFLAGS) $(DEFS) -O2 -g3 -ffunction-sections -fdata-sections -Wall -Wextra -Wpedantic \
 	      -Wconversion -Wshadow -Wdouble-promotion -Wformat=2
 
 # --- Sources ---
 C_SRCS := \
-$(SOURCE_DIR)/core/mem.c \
+$(MEM_SRCS) \
+$(SOURCE_DIR)/core/event.c \
+$(SOURCE_DIR)/core/kmem.c \
+$(SOURCE_DIR)/core/kobj.c \
+$(SOURCE_DIR)/core/ktimer.c \
+$(SOURCE_DIR)/core/mpu.c \
+$(SOURCE_DIR)/core/msgq.c \
+$(SOURCE_DIR)/core/mutex.c \
+$(SOURCE_DIR)/core/sched.c \
+$(SOURCE_DIR)/core/sem.c \
+$(SOURCE_DIR)/core/stack.c \
+$(SOURCE_DIR)/core/syscall.c \
 $(SOURCE_DIR)/core/tcb.c \
 $(SOURCE_DIR)/core/tcb_buf.c \
 $(SOURCE_DIR)/drivers/iwdg.c \
 $(SOURCE_DIR)/drivers/uart.c \
 $(SOURCE_DIR)/helpers/logo.c \
+$(SOURCE_DIR)/helpers/mem_dump.c \
 $(SOURCE_DIR)/main.c
 
 S_SRCS := \
-$(SOURCE_DIR)/startup/startup_sprinter.s
+$(SOURCE_DIR)/startup/startup_sprinter.s \
+$(SOURCE_DIR)/core/context_switch.s \
+$(SOURCE_DIR)/core/syscall_entry.s
 
 # --- Objects and deps in build/obj ---
 OBJS := \
@@ -24,19 +24,19 @@ g_pfnVectors:
   .word _estack
   .word Reset_Handler
   .word Default_Handler       /* NMI          */
-  .word Default_Handler       /* HardFault    */
-  .word Default_Handler       /* MemManage    */
+  .word HardFault_Handler     /* HardFault    */
+  .word MemManage_Handler     /* MemManage    */
   .word Default_Handler       /* BusFault     */
   .word Default_Handler       /* UsageFault   */
   .word 0
   .word 0
   .word 0
   .word 0
-  .word Default_Handler       /* SVCall       */
+  .word SVC_Handler           /* SVCall       */
   .word Default_Handler       /* DebugMon     */
   .word 0
-  .word Default_Handler       /* PendSV       */
-  .word Default_Handler       /* SysTick      */
+  .word PendSV_Handler        /* PendSV       */
+  .word SysTick_Handler       /* SysTick      */
   .size g_pfnVectors, .-g_pfnVectors
 
   .section .text.Reset_Handler
@@ -44,6 +44,16 @@ g_pfnVectors:
 Reset_Handler:
   ldr   sp, =_estack          /* bootloader already set MSP, do it again anyway */
 
+  /* fpu on (cp10/cp11 full access, CPACR) before any c code that might touch it */
+  ldr   r0, =0xE000ED88
+  ldr   r1, [r0]
+  orr   r1, r1, #(0xF << 20)
+  str   r1, [r0]
+  dsb
+  isb
+
+  bl    _early_init           /* weak, nothing by default. runs before .bss is zeroed */
+
   /* zero .bss */
   ldr   r0, =_sbss
   ldr   r1, =_ebss
@@ -61,6 +71,13 @@ hang:
   b     hang
   .size Reset_Handler, .-Reset_Handler
 
+  .section .text._early_init
+  .weak _early_init
+  .type _early_init, %function
+_early_init:
+  bx    lr
+  .size _early_init, .-_early_init
+
   .section .text.Default_Handler
   .type Default_Handler, %function
 Default_Handler:
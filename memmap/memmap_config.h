@@ -4,6 +4,6 @@
 #define DTCM_ORIGIN        0x20000000
 #define DTCM_SIZE_B        (128 * 1024)
 #define USERSPACE_ORIGIN   0x20020000
-#define USERSPACE_SIZE_B   (368 * 1024)
-#define KERNEL_IMG_ORIGIN  0x2007C000
-#define KERNEL_IMG_SIZE_B  (16 * 1024)
+#define USERSPACE_SIZE_B   (352 * 1024)
+#define KERNEL_IMG_ORIGIN  0x20078000     /* top 16 KB of SRAM1 and all of SRAM2, aligned to its size */
+#define KERNEL_IMG_SIZE_B  (32 * 1024)
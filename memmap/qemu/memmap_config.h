@@ -0,0 +1,14 @@
+/*
+ * memory map for qemu's mps2-an500 (cortex-m7), used instead of ../memmap_config.h by the
+ * qemu benchmark build (kernel/bench/qemu). the board has 4 MB of ssram at 0x00000000 and
+ * 0x20000000, so dtcm and userspace keep their stm32 addresses and the kernel image moves to
+ * 0x00000000 where the core fetches its vector table from at reset. there is no bootloader
+ */
+#define FLASH_ORIGIN       0x08000000     /* not used by the kernel */
+#define FLASH_SIZE_B       (2048 * 1024)
+#define DTCM_ORIGIN        0x20000000
+#define DTCM_SIZE_B        (128 * 1024)
+#define USERSPACE_ORIGIN   0x20020000
+#define USERSPACE_SIZE_B   (352 * 1024)
+#define KERNEL_IMG_ORIGIN  0x00000000
+#define KERNEL_IMG_SIZE_B  (64 * 1024)    /* room for the benchmark payload */